@@ -0,0 +1,503 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Airtime-based admission control for OnOff flows, per access class.
+//
+// Every PHY reports its state changes through the "State" trace of its
+// WifiPhyStateHelper.  AdmissionControl adds up the time each device spent
+// transmitting, receiving or sensing the medium busy, and at the end of
+// every Window takes the busiest device of each node as the node's channel
+// busy fraction.  The airtime a node can still offer is
+//
+//   available = MaxUtilization - busy - airtime admitted in the last Window
+//
+// where the last term covers flows admitted too recently to show up in the
+// measurement.  A flow needs rate / (8 x PacketSize) packets per second,
+// each costing the packet and HeaderBytes at PhyRate plus the overhead the
+// 802.11 standard puts around a unicast data frame of its class:
+//
+//   AIFS[AC] + CWmin[AC] / 2 x slot + PLCP preamble/header + SIFS + ACK
+//
+// with SIFS and slot taken from the MACs of the installed devices, AIFSN
+// and CWmin the EDCA defaults (802.11-2012 Table 8-105), the PLCP preamble
+// and header of the data and ACK modes given to SetModes (), and OFDM
+// service and tail bits.  The flow's packets get a QosTag with the class's
+// user priority, so the QoS MACs queue them in that EDCA access category
+// all along the path.  A flow is checked against both its source and its
+// destination, and the decision depends on the class:
+//
+//   AC_VO  admitted at the requested rate, or rejected;
+//   AC_VI  admitted, rate-limited down to VideoMinFraction of the request,
+//          or rejected;
+//   AC_BE,
+//   AC_BK  admitted, rate-limited down to ElasticMinFraction, or rejected.
+//
+// Classes other than voice may not use the last VoiceReserve of airtime.
+// Flows starting at the same time are decided in class priority order, one
+// millisecond before their start, by changing the OnOff attributes: a
+// rate-limited flow gets a lower DataRate, a rejected one an OffTime that
+// never ends.  Only the airtime around the end points is checked; relays of
+// multi-hop flows are not.
+//
+
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/applications-module.h"
+
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+class AdmissionControl : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  AdmissionControl ();
+
+  /**
+   * \brief Measure channel busy time on these devices.
+   * \param devices Wi-Fi devices; a node may have several
+   */
+  void Install (NetDeviceContainer devices);
+
+  /**
+   * \brief Derive the per-packet overhead for these modes.
+   * \param data mode of the flows' data frames
+   * \param ack mode of their ACKs
+   * \param streams spatial streams of the data frames (HT/VHT)
+   */
+  void SetModes (WifiMode data, WifiMode ack, uint8_t streams);
+
+  /**
+   * \brief Put an OnOff flow under admission control.
+   * \param app the OnOffApplication, installed but not yet started; its
+   *        packets are tagged with the user priority of ac
+   * \param ac access class of the flow
+   * \param source node sending the flow
+   * \param destination node receiving the flow
+   * \param start start time of the application
+   */
+  void AddFlow (Ptr<Application> app, AcIndex ac, Ptr<Node> source, Ptr<Node> destination, Time start);
+
+  /// Write the decisions per access class.
+  void Report (std::ostream &os) const;
+
+  /// \return airtime fraction a node can still offer
+  double GetAvailable (uint32_t node) const;
+
+private:
+  enum Decision
+  {
+    ADMITTED = 0,
+    LIMITED,
+    REJECTED,
+    N_DECISIONS
+  };
+
+  struct Flow
+  {
+    Ptr<Application> app;
+    AcIndex ac;
+    uint32_t source;
+    uint32_t destination;
+    Time start;
+    uint64_t requested; // bit/s
+    uint64_t admitted;  // bit/s
+  };
+
+  struct PerNode
+  {
+    PerNode () : busy (0) {}
+    std::map<uint32_t, Time> deviceBusy;  // by device index, current window
+    double busy;                          // fraction, last full window
+    std::vector<std::pair<Time, double> > pending; // admitted airtime
+  };
+
+  static void State (AdmissionControl *ac, uint32_t node, uint32_t device,
+                     Time start, Time duration, WifiPhy::State state);
+  static void Tag (uint8_t tid, Ptr<const Packet> packet);
+  static Time GetPlcpDuration (WifiMode mode, uint8_t streams);
+  static uint32_t GetTailBits (WifiMode mode);
+  void Sample (void);
+  void Decide (Time start);
+  double GetAirtime (uint64_t rate, uint32_t packetSize, AcIndex ac) const;
+  void Commit (uint32_t node, double airtime);
+  PerNode &GetNode (uint32_t node);
+
+  Time m_window;
+  double m_maxUtilization;
+  double m_voiceReserve;
+  double m_videoMinFraction;
+  double m_elasticMinFraction;
+  DataRate m_phyRate;
+  uint32_t m_headerBytes;
+  Time m_sifs;
+  Time m_slot;
+  Time m_dataPlcp;      // PLCP preamble and header of the data frames
+  uint32_t m_tailBits;  // service and tail bits of the data frames
+  Time m_ack;           // ACK frame
+  uint32_t m_cwMin;     // aCWmin of the PHY
+
+  std::vector<PerNode> m_nodes; // by node id
+  std::vector<Flow> m_flows;
+  bool m_sampling;
+  uint64_t m_decisions[4][N_DECISIONS]; // by AcIndex
+  uint64_t m_requested[4];
+  uint64_t m_admitted[4];
+};
+
+NS_OBJECT_ENSURE_REGISTERED (AdmissionControl);
+
+TypeId
+AdmissionControl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::AdmissionControl")
+    .SetParent<Object> ()
+    .AddConstructor<AdmissionControl> ()
+    .AddAttribute ("Window", "Busy time measurement period.",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&AdmissionControl::m_window),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxUtilization", "Busy fraction of the channel that flows may bring it to.",
+                   DoubleValue (0.9),
+                   MakeDoubleAccessor (&AdmissionControl::m_maxUtilization),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("VoiceReserve", "Airtime fraction only voice flows may use.",
+                   DoubleValue (0.2),
+                   MakeDoubleAccessor (&AdmissionControl::m_voiceReserve),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("VideoMinFraction", "Smallest share of its request a video flow is limited to.",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&AdmissionControl::m_videoMinFraction),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("ElasticMinFraction", "Smallest share of its request a best-effort or background flow is limited to.",
+                   DoubleValue (0.1),
+                   MakeDoubleAccessor (&AdmissionControl::m_elasticMinFraction),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("PhyRate", "Data rate of the flows' frames.",
+                   DataRateValue (DataRate ("1Mbps")),
+                   MakeDataRateAccessor (&AdmissionControl::m_phyRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("HeaderBytes", "UDP, IPv6, LLC/SNAP and 802.11 QoS data header and FCS bytes of every frame.",
+                   UintegerValue (8 + 40 + 8 + 30),
+                   MakeUintegerAccessor (&AdmissionControl::m_headerBytes),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+  return tid;
+}
+
+AdmissionControl::AdmissionControl ()
+  : m_window (Seconds (1)),
+    m_maxUtilization (0.9),
+    m_voiceReserve (0.2),
+    m_videoMinFraction (0.5),
+    m_elasticMinFraction (0.1),
+    m_phyRate (DataRate ("1Mbps")),
+    m_headerBytes (8 + 40 + 8 + 30),
+    m_sifs (MicroSeconds (10)),
+    m_slot (MicroSeconds (20)),
+    m_dataPlcp (MicroSeconds (192)),
+    m_tailBits (0),
+    m_ack (MicroSeconds (192 + 112)),
+    m_cwMin (31),
+    m_sampling (false)
+{
+  for (int ac = 0; ac < 4; ac++)
+    {
+      for (int d = 0; d < N_DECISIONS; d++)
+        {
+          m_decisions[ac][d] = 0;
+        }
+      m_requested[ac] = 0;
+      m_admitted[ac] = 0;
+    }
+}
+
+AdmissionControl::PerNode &
+AdmissionControl::GetNode (uint32_t node)
+{
+  if (node >= m_nodes.size ())
+    {
+      m_nodes.resize (node + 1);
+    }
+  return m_nodes[node];
+}
+
+void
+AdmissionControl::Install (NetDeviceContainer devices)
+{
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+    {
+      Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (*i);
+      NS_ABORT_MSG_IF (device == 0, "AdmissionControl needs Wi-Fi devices");
+      uint32_t node = device->GetNode ()->GetId ();
+      GetNode (node).deviceBusy[device->GetIfIndex ()] = Seconds (0);
+      // Every device runs the same standard
+      m_sifs = device->GetMac ()->GetSifs ();
+      m_slot = device->GetMac ()->GetSlot ();
+      PointerValue state;
+      device->GetPhy ()->GetAttribute ("State", state);
+      state.Get<WifiPhyStateHelper> ()->TraceConnectWithoutContext
+        ("State", MakeBoundCallback (&AdmissionControl::State, this, node, device->GetIfIndex ()));
+    }
+  if (!m_sampling)
+    {
+      m_sampling = true;
+      Simulator::Schedule (m_window, &AdmissionControl::Sample, this);
+    }
+}
+
+void
+AdmissionControl::State (AdmissionControl *ac, uint32_t node, uint32_t device,
+                         Time start, Time duration, WifiPhy::State state)
+{
+  if (state == WifiPhy::TX || state == WifiPhy::RX || state == WifiPhy::CCA_BUSY)
+    {
+      ac->m_nodes[node].deviceBusy[device] += duration;
+    }
+}
+
+void
+AdmissionControl::Sample (void)
+{
+  for (std::vector<PerNode>::iterator n = m_nodes.begin (); n != m_nodes.end (); n++)
+    {
+      Time busiest = Seconds (0);
+      for (std::map<uint32_t, Time>::iterator d = n->deviceBusy.begin (); d != n->deviceBusy.end (); d++)
+        {
+          busiest = std::max (busiest, d->second);
+          d->second = Seconds (0);
+        }
+      n->busy = std::min (1.0, busiest.GetSeconds () / m_window.GetSeconds ());
+    }
+  Simulator::Schedule (m_window, &AdmissionControl::Sample, this);
+}
+
+double
+AdmissionControl::GetAvailable (uint32_t node) const
+{
+  if (node >= m_nodes.size ())
+    {
+      return m_maxUtilization;
+    }
+  const PerNode &n = m_nodes[node];
+  double committed = 0;
+  for (size_t p = 0; p < n.pending.size (); p++)
+    {
+      if (Simulator::Now () - n.pending[p].first < m_window)
+        {
+          committed += n.pending[p].second;
+        }
+    }
+  return std::max (0.0, m_maxUtilization - n.busy - committed);
+}
+
+Time
+AdmissionControl::GetPlcpDuration (WifiMode mode, uint8_t streams)
+{
+  switch (mode.GetModulationClass ())
+    {
+    case WIFI_MOD_CLASS_DSSS:
+    case WIFI_MOD_CLASS_HR_DSSS:
+      // Long preamble and PLCP header
+      return MicroSeconds (192);
+    case WIFI_MOD_CLASS_HT:
+      // L-STF, L-LTF, L-SIG, HT-SIG, HT-STF and one HT-LTF per stream
+      return MicroSeconds (32 + 4 * streams);
+    case WIFI_MOD_CLASS_VHT:
+      // Legacy part, VHT-SIG-A, VHT-STF, VHT-LTFs and VHT-SIG-B
+      return MicroSeconds (36 + 4 * streams);
+    default:
+      // OFDM and ERP-OFDM: preamble and SIGNAL
+      return MicroSeconds (20);
+    }
+}
+
+uint32_t
+AdmissionControl::GetTailBits (WifiMode mode)
+{
+  WifiModulationClass modulation = mode.GetModulationClass ();
+  // 16 service and 6 tail bits in every OFDM PPDU
+  return modulation == WIFI_MOD_CLASS_DSSS || modulation == WIFI_MOD_CLASS_HR_DSSS ? 0 : 16 + 6;
+}
+
+void
+AdmissionControl::SetModes (WifiMode data, WifiMode ack, uint8_t streams)
+{
+  WifiModulationClass modulation = data.GetModulationClass ();
+  m_cwMin = modulation == WIFI_MOD_CLASS_DSSS || modulation == WIFI_MOD_CLASS_HR_DSSS ? 31 : 15;
+  m_dataPlcp = GetPlcpDuration (data, streams);
+  m_tailBits = GetTailBits (data);
+  // ACK: 14 bytes, non-HT, 20 MHz
+  m_ack = GetPlcpDuration (ack, 1)
+    + Seconds ((14 * 8 + GetTailBits (ack)) / double (ack.GetDataRate (20, false, 1)));
+}
+
+double
+AdmissionControl::GetAirtime (uint64_t rate, uint32_t packetSize, AcIndex ac) const
+{
+  // EDCA defaults: AIFSN and CWmin per access category
+  uint32_t aifsn = 3;
+  uint32_t cwMin = m_cwMin;
+  switch (ac)
+    {
+    case AC_VO:
+      aifsn = 2;
+      cwMin = (m_cwMin + 1) / 4 - 1;
+      break;
+    case AC_VI:
+      aifsn = 2;
+      cwMin = (m_cwMin + 1) / 2 - 1;
+      break;
+    case AC_BK:
+      aifsn = 7;
+      break;
+    default:
+      break;
+    }
+  // AIFS plus the mean backoff
+  double access = m_sifs.GetSeconds () + (aifsn + cwMin / 2.0) * m_slot.GetSeconds ();
+  double packetsPerSecond = rate / (8.0 * packetSize);
+  double perPacket = access + (m_dataPlcp + m_sifs + m_ack).GetSeconds ()
+    + ((packetSize + m_headerBytes) * 8.0 + m_tailBits) / m_phyRate.GetBitRate ();
+  return packetsPerSecond * perPacket;
+}
+
+void
+AdmissionControl::Tag (uint8_t tid, Ptr<const Packet> packet)
+{
+  packet->AddPacketTag (QosTag (tid));
+}
+
+void
+AdmissionControl::Commit (uint32_t node, double airtime)
+{
+  PerNode &n = GetNode (node);
+  n.pending.push_back (std::make_pair (Simulator::Now (), airtime));
+}
+
+void
+AdmissionControl::AddFlow (Ptr<Application> app, AcIndex ac, Ptr<Node> source, Ptr<Node> destination, Time start)
+{
+  Flow f;
+  f.app = app;
+  f.ac = ac;
+  f.source = source->GetId ();
+  f.destination = destination->GetId ();
+  f.start = start;
+  DataRateValue rate;
+  app->GetAttribute ("DataRate", rate);
+  f.requested = rate.Get ().GetBitRate ();
+  f.admitted = 0;
+  // User priorities 6, 5, 0 and 1 map to AC_VO, AC_VI, AC_BE and AC_BK
+  static const uint8_t priority[] = { 0, 1, 5, 6 };
+  app->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&AdmissionControl::Tag, priority[ac]));
+  for (size_t i = 0; i < m_flows.size (); i++)
+    {
+      if (m_flows[i].start == start)
+        {
+          m_flows.push_back (f);
+          return;
+        }
+    }
+  m_flows.push_back (f);
+  // Early enough for the OnOff attributes to be read at start
+  Simulator::Schedule (std::max (Seconds (0), start - MilliSeconds (1)), &AdmissionControl::Decide, this, start);
+}
+
+void
+AdmissionControl::Decide (Time start)
+{
+  std::vector<Flow *> flows;
+  for (size_t i = 0; i < m_flows.size (); i++)
+    {
+      if (m_flows[i].start == start)
+        {
+          flows.push_back (&m_flows[i]);
+        }
+    }
+  // AC_BE = 0, AC_BK = 1, AC_VI = 2, AC_VO = 3: highest priority first
+  static const AcIndex order[] = { AC_VO, AC_VI, AC_BE, AC_BK };
+  for (int o = 0; o < 4; o++)
+    {
+      for (size_t i = 0; i < flows.size (); i++)
+        {
+          Flow &f = *flows[i];
+          if (f.ac != order[o])
+            {
+              continue;
+            }
+          UintegerValue size;
+          f.app->GetAttribute ("PacketSize", size);
+          double available = std::min (GetAvailable (f.source), GetAvailable (f.destination));
+          double minFraction = 1;
+          if (f.ac != AC_VO)
+            {
+              available = std::max (0.0, available - m_voiceReserve);
+              minFraction = f.ac == AC_VI ? m_videoMinFraction : m_elasticMinFraction;
+            }
+          double needed = GetAirtime (f.requested, size.Get (), f.ac);
+          double fraction = needed > 0 ? std::min (1.0, available / needed) : 1;
+          Decision decision;
+          if (fraction >= 1)
+            {
+              decision = ADMITTED;
+              f.admitted = f.requested;
+            }
+          else if (f.ac != AC_VO && fraction >= minFraction)
+            {
+              decision = LIMITED;
+              f.admitted = static_cast<uint64_t> (f.requested * fraction);
+              f.app->SetAttribute ("DataRate", DataRateValue (DataRate (f.admitted)));
+            }
+          else
+            {
+              decision = REJECTED;
+              f.admitted = 0;
+              f.app->SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=1e9]"));
+            }
+          if (f.admitted > 0)
+            {
+              double airtime = GetAirtime (f.admitted, size.Get (), f.ac);
+              Commit (f.source, airtime);
+              if (f.destination != f.source)
+                {
+                  Commit (f.destination, airtime);
+                }
+            }
+          m_decisions[f.ac][decision]++;
+          m_requested[f.ac] += f.requested;
+          m_admitted[f.ac] += f.admitted;
+        }
+    }
+}
+
+void
+AdmissionControl::Report (std::ostream &os) const
+{
+  static const char *names[] = { "AC_BE", "AC_BK", "AC_VI", "AC_VO" };
+  static const AcIndex order[] = { AC_VO, AC_VI, AC_BE, AC_BK };
+  os << "# class\tadmitted\trate_limited\trejected\trequested_kbps\tadmitted_kbps" << std::endl;
+  for (int o = 0; o < 4; o++)
+    {
+      AcIndex ac = order[o];
+      os << names[ac]
+         << "\t" << m_decisions[ac][ADMITTED]
+         << "\t" << m_decisions[ac][LIMITED]
+         << "\t" << m_decisions[ac][REJECTED]
+         << "\t" << m_requested[ac] / 1e3
+         << "\t" << m_admitted[ac] / 1e3
+         << std::endl;
+    }
+}
+
+} // namespace ns3
+
+#endif /* ADMISSION_CONTROL_H */
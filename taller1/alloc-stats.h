@@ -0,0 +1,377 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Process-wide heap allocation counters and per-node/per-subsystem memory
+// accounting.
+//
+// The counters only move when the program is built with ALLOC_STATS
+// defined, e.g.
+//
+//   CXXFLAGS="-DALLOC_STATS" ./waf configure
+//
+// which makes this header replace the global operator new/delete; the
+// replacement must then be compiled into exactly one translation unit,
+// which is always the case for the single-file scenario scripts in this
+// directory.  Without ALLOC_STATS the program keeps the standard allocator,
+// so that including scenario-bench.h or profiling-scheduler.h does not add
+// a header to every allocation of the benchmarked runs, and
+// AllocStats::IsEnabled () is false.
+//
+// Every block carries a small header recording its size and the tag that
+// was current when it was allocated, so that freeing it later (possibly
+// from a different node's event) is charged back to the right bucket.  The
+// current tag is a (subsystem, node) pair set with AllocScope during setup
+// and by ProfilingScheduler (TagAllocations=true) while events run.
+//
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <stdint.h>
+
+namespace ns3 {
+
+struct AllocStats
+{
+  uint64_t allocations;
+  uint64_t bytes;
+  uint64_t liveBytes;
+  uint64_t peakLiveBytes;
+
+  static AllocStats &Get (void)
+  {
+    static AllocStats stats = { 0, 0, 0, 0 };
+    return stats;
+  }
+
+  /// \return whether operator new is counted (built with ALLOC_STATS)
+  static bool IsEnabled (void)
+  {
+#ifdef ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+  }
+};
+
+class AllocAccounting
+{
+public:
+  enum Subsystem
+  {
+    OTHER = 0,
+    WIFI_QOS,
+    WIFI_NQOS,
+    WIFI_PHY,
+    WIFI_MAC,
+    IPV6,
+    OLSR6,
+    MOBILITY,
+    APPLICATIONS,
+    TRACING,
+    ANIMATION,
+    N_SUBSYSTEMS
+  };
+
+  static const uint32_t NO_NODE = 0xffffffff;
+
+  static void SetTag (Subsystem subsystem, uint32_t node)
+  {
+    State &s = GetState ();
+    s.subsystem = subsystem;
+    s.node = node;
+  }
+  static Subsystem GetSubsystem (void)
+  {
+    return GetState ().subsystem;
+  }
+  static uint32_t GetNode (void)
+  {
+    return GetState ().node;
+  }
+
+  static const char *GetSubsystemName (Subsystem subsystem)
+  {
+    static const char *names[N_SUBSYSTEMS] = {
+      "other", "wifi-qos", "wifi-nqos", "wifi-phy", "wifi-mac", "ipv6",
+      "olsr6", "mobility", "apps", "tracing", "animation"
+    };
+    return names[subsystem];
+  }
+
+  /// \return live bytes charged to node (or NO_NODE) and subsystem
+  static uint64_t GetLiveBytes (uint32_t node, Subsystem subsystem)
+  {
+    State &s = GetState ();
+    uint32_t row = Row (node);
+    if (row >= s.rows)
+      {
+        return 0;
+      }
+    return s.table[row * N_SUBSYSTEMS + subsystem];
+  }
+
+  /**
+   * \brief Write live bytes per node and subsystem as a table.
+   * \param os output stream
+   * \param label first column of every row (e.g. the simulation time)
+   */
+  static void WriteReport (std::ostream &os, const char *label)
+  {
+    State &s = GetState ();
+    uint64_t totals[N_SUBSYSTEMS] = { 0 };
+    uint32_t nodes = 0;
+    os << "# time\tnode";
+    for (int j = 0; j < N_SUBSYSTEMS; j++)
+      {
+        os << "\t" << GetSubsystemName (Subsystem (j));
+      }
+    os << "\ttotal" << std::endl;
+    for (uint32_t row = 0; row < s.rows; row++)
+      {
+        uint64_t rowTotal = 0;
+        for (int j = 0; j < N_SUBSYSTEMS; j++)
+          {
+            rowTotal += s.table[row * N_SUBSYSTEMS + j];
+            totals[j] += s.table[row * N_SUBSYSTEMS + j];
+          }
+        if (rowTotal == 0)
+          {
+            continue;
+          }
+        if (row != 0)
+          {
+            nodes++;
+          }
+        os << label << "\t";
+        if (row == 0)
+          {
+            os << "shared";
+          }
+        else
+          {
+            os << row - 1;
+          }
+        for (int j = 0; j < N_SUBSYSTEMS; j++)
+          {
+            os << "\t" << s.table[row * N_SUBSYSTEMS + j];
+          }
+        os << "\t" << rowTotal << std::endl;
+      }
+    os << label << "\tper-node-avg";
+    uint64_t grand = 0;
+    for (int j = 0; j < N_SUBSYSTEMS; j++)
+      {
+        uint64_t perNode = nodes ? (totals[j] - s.table[j]) / nodes : 0;
+        os << "\t" << perNode;
+        grand += perNode;
+      }
+    os << "\t" << grand << std::endl;
+    os << "# live " << AllocStats::Get ().liveBytes
+       << " bytes, peak " << AllocStats::Get ().peakLiveBytes << " bytes" << std::endl;
+  }
+
+  struct Header
+  {
+    uint64_t size;
+    uint32_t node;
+    uint32_t subsystem;
+  };
+
+  static void Charge (Header *h)
+  {
+    State &s = GetState ();
+    h->node = s.node;
+    h->subsystem = s.subsystem;
+    uint64_t *cell = Cell (s.node, s.subsystem);
+    if (cell != 0)
+      {
+        *cell += h->size;
+      }
+  }
+
+  static void Release (const Header *h)
+  {
+    uint64_t *cell = Cell (h->node, h->subsystem);
+    if (cell != 0)
+      {
+        *cell -= h->size;
+      }
+  }
+
+private:
+  struct State
+  {
+    Subsystem subsystem;
+    uint32_t node;
+    uint64_t *table; // rows x N_SUBSYSTEMS, row 0 is NO_NODE
+    uint32_t rows;
+  };
+
+  static State &GetState (void)
+  {
+    static State state = { OTHER, NO_NODE, 0, 0 };
+    return state;
+  }
+
+  static uint32_t Row (uint32_t node)
+  {
+    return node == NO_NODE ? 0 : node + 1;
+  }
+
+  static uint64_t *Cell (uint32_t node, uint32_t subsystem)
+  {
+    State &s = GetState ();
+    uint32_t row = Row (node);
+    if (row >= s.rows)
+      {
+        // Grow with realloc so that the table never recurses into operator new.
+        uint32_t rows = s.rows ? s.rows : 64;
+        while (rows <= row)
+          {
+            rows *= 2;
+          }
+        uint64_t *table = static_cast<uint64_t *> (std::realloc (s.table, rows * N_SUBSYSTEMS * sizeof (uint64_t)));
+        if (table == 0)
+          {
+            return 0;
+          }
+        std::memset (table + s.rows * N_SUBSYSTEMS, 0, (rows - s.rows) * N_SUBSYSTEMS * sizeof (uint64_t));
+        s.table = table;
+        s.rows = rows;
+      }
+    return &s.table[row * N_SUBSYSTEMS + subsystem];
+  }
+};
+
+/**
+ * \brief Charge allocations made during its lifetime to a subsystem and node.
+ */
+class AllocScope
+{
+public:
+  AllocScope (AllocAccounting::Subsystem subsystem, uint32_t node = AllocAccounting::NO_NODE)
+    : m_subsystem (AllocAccounting::GetSubsystem ()),
+      m_node (AllocAccounting::GetNode ())
+  {
+    AllocAccounting::SetTag (subsystem, node);
+  }
+  ~AllocScope ()
+  {
+    AllocAccounting::SetTag (m_subsystem, m_node);
+  }
+
+private:
+  AllocAccounting::Subsystem m_subsystem;
+  uint32_t m_node;
+};
+
+} // namespace ns3
+
+#ifdef ALLOC_STATS
+
+inline void *
+AllocStatsMalloc (std::size_t size)
+{
+  ns3::AllocStats &stats = ns3::AllocStats::Get ();
+  stats.allocations++;
+  stats.bytes += size;
+  stats.liveBytes += size;
+  if (stats.liveBytes > stats.peakLiveBytes)
+    {
+      stats.peakLiveBytes = stats.liveBytes;
+    }
+  ns3::AllocAccounting::Header *h = static_cast<ns3::AllocAccounting::Header *>
+    (std::malloc (sizeof (ns3::AllocAccounting::Header) + size));
+  if (h == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  h->size = size;
+  ns3::AllocAccounting::Charge (h);
+  return h + 1;
+}
+
+inline void
+AllocStatsFree (void *p)
+{
+  if (p == 0)
+    {
+      return;
+    }
+  ns3::AllocAccounting::Header *h = static_cast<ns3::AllocAccounting::Header *> (p) - 1;
+  ns3::AllocStats::Get ().liveBytes -= h->size;
+  ns3::AllocAccounting::Release (h);
+  std::free (h);
+}
+
+void *
+operator new (std::size_t size)
+{
+  return AllocStatsMalloc (size);
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return AllocStatsMalloc (size);
+}
+
+void *
+operator new (std::size_t size, const std::nothrow_t &) throw ()
+{
+  try
+    {
+      return AllocStatsMalloc (size);
+    }
+  catch (...)
+    {
+      return 0;
+    }
+}
+
+void *
+operator new[] (std::size_t size, const std::nothrow_t &) throw ()
+{
+  try
+    {
+      return AllocStatsMalloc (size);
+    }
+  catch (...)
+    {
+      return 0;
+    }
+}
+
+void
+operator delete (void *p) throw ()
+{
+  AllocStatsFree (p);
+}
+
+void
+operator delete[] (void *p) throw ()
+{
+  AllocStatsFree (p);
+}
+
+void
+operator delete (void *p, const std::nothrow_t &) throw ()
+{
+  AllocStatsFree (p);
+}
+
+void
+operator delete[] (void *p, const std::nothrow_t &) throw ()
+{
+  AllocStatsFree (p);
+}
+
+#endif /* ALLOC_STATS */
+
+#endif /* ALLOC_STATS_H */
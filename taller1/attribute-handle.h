@@ -0,0 +1,132 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Typed handle to one attribute of a TypeId, resolved once.
+//
+// Config::SetDefault ("ns3::Type::Attribute", StringValue ("..")) splits
+// the path, looks the TypeId and the attribute up by name and parses the
+// string through the checker on every call; ObjectBase::SetAttribute and
+// GetAttribute look the attribute up by name on every call as well.
+// AttributeHandle<V> does the lookup once, checks at that point that the
+// attribute holds a V, and then sets defaults or per-object values through
+// the accessor directly:
+//
+//   AttributeHandle<UintegerValue> frag ("ns3::WifiRemoteStationManager::FragmentationThreshold");
+//   frag.SetDefault (UintegerValue (2200));
+//
+//   AttributeHandle<TimeValue> hello (olsr6::RoutingProtocol::GetTypeId (), "HelloInterval");
+//   hello.Set (agent, TimeValue (Seconds (1)));
+//
+// A misspelled name or a wrong value type aborts when the handle is built
+// instead of when (and if) the attribute is first used.  A value the
+// checker rejects, or that the accessor fails to set, aborts like a failed
+// Config::Set.
+//
+// Initial values live in the TypeId that declares the attribute.  A handle
+// built on a TypeId that inherits it (e.g. "ns3::AarfWifiManager::RtsCtsThreshold",
+// declared by WifiRemoteStationManager) therefore changes the default of
+// the parent and of every type derived from it, not only of the TypeId
+// named; Config::SetDefault refuses such paths instead.
+//
+
+#ifndef ATTRIBUTE_HANDLE_H
+#define ATTRIBUTE_HANDLE_H
+
+#include "ns3/core-module.h"
+
+#include <string>
+
+namespace ns3 {
+
+template <typename V>
+class AttributeHandle
+{
+public:
+  /**
+   * \param path "TypeName::AttributeName", as for Config::SetDefault
+   */
+  AttributeHandle (std::string path)
+  {
+    std::string::size_type separator = path.rfind ("::");
+    NS_ABORT_MSG_IF (separator == std::string::npos, "invalid attribute path " << path);
+    Resolve (TypeId::LookupByName (path.substr (0, separator)), path.substr (separator + 2));
+  }
+
+  /**
+   * \param tid type declaring or inheriting the attribute
+   * \param name attribute name
+   */
+  AttributeHandle (TypeId tid, std::string name)
+  {
+    Resolve (tid, name);
+  }
+
+  /**
+   * \brief Set the initial value of objects created from now on.
+   *
+   * For an inherited attribute this is the initial value of every type
+   * derived from the declaring one.
+   */
+  void SetDefault (const V &value) const
+  {
+    NS_ABORT_MSG_IF (!m_checker->Check (value), "invalid value for " << m_name);
+    TypeId owner = m_owner;
+    owner.SetAttributeInitialValue (m_index, Create<V> (value));
+  }
+
+  /// Set the attribute of one object.
+  template <typename T>
+  void Set (Ptr<T> object, const V &value) const
+  {
+    NS_ABORT_MSG_UNLESS (m_checker->Check (value), "invalid value for " << m_name);
+    NS_ABORT_MSG_UNLESS (m_accessor->Set (PeekPointer (object), value), "could not set " << m_name);
+  }
+
+  /// \return the attribute of one object
+  template <typename T>
+  V Get (Ptr<T> object) const
+  {
+    V value;
+    m_accessor->Get (PeekPointer (object), value);
+    return value;
+  }
+
+private:
+  void Resolve (TypeId tid, std::string name)
+  {
+    m_name = tid.GetName () + "::" + name;
+    for (TypeId t = tid;; t = t.GetParent ())
+      {
+        for (uint32_t i = 0; i < t.GetAttributeN (); i++)
+          {
+            struct TypeId::AttributeInformation info = t.GetAttribute (i);
+            if (info.name == name)
+              {
+                m_owner = t;
+                m_index = i;
+                m_accessor = info.accessor;
+                m_checker = info.checker;
+                Ptr<AttributeValue> probe = m_checker->Create ();
+                NS_ABORT_MSG_IF (dynamic_cast<V *> (PeekPointer (probe)) == 0,
+                                 m_name << " holds a " << m_checker->GetValueTypeName ()
+                                        << ", not the value type of the handle");
+                return;
+              }
+          }
+        if (t == t.GetParent ())
+          {
+            break;
+          }
+      }
+    NS_FATAL_ERROR ("no attribute " << m_name);
+  }
+
+  std::string m_name;
+  TypeId m_owner;
+  uint32_t m_index;
+  Ptr<const AttributeAccessor> m_accessor;
+  Ptr<const AttributeChecker> m_checker;
+};
+
+} // namespace ns3
+
+#endif /* ATTRIBUTE_HANDLE_H */
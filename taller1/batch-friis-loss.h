@@ -0,0 +1,276 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Friis propagation loss from one transmitter to many receivers at once.
+//
+// YansWifiChannel::Send () asks its loss model for the rx power of every
+// other PHY on the channel, one virtual CalcRxPower () at a time, and
+// FriisPropagationLossModel computes a distance and a log10 in each.  The
+// loss only depends on the squared distance:
+//
+//   loss = 10 log10 (16 pi^2 L / lambda^2) + 10 log10 (d^2)
+//
+// FriisBatch::Compute () evaluates it over structure-of-arrays positions,
+// four receivers per AVX2 instruction when the CPU has it (checked at run
+// time, so no special build flags are needed) and in a scalar loop
+// otherwise.  The AVX2 log10 splits d^2 into exponent and mantissa and
+// evaluates the mantissa's logarithm with an atanh series, within 1e-9 dB
+// of std::log10.
+//
+// BatchFriisPropagationLossModel puts it on the channel's send path: the
+// first CalcRxPower () of a transmission takes the positions of every node
+// from SegmentWaypointMobilityModel::GetPositions (), computes the rx power
+// at all of them in one batch and caches it, and the calls for the other
+// receivers of the same transmission are array lookups.  Nodes with other
+// mobility models fall back to the scalar Friis formula.
+//
+
+#ifndef BATCH_FRIIS_LOSS_H
+#define BATCH_FRIIS_LOSS_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+#include "segment-waypoint-mobility.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define FRIIS_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ns3 {
+
+class FriisBatch
+{
+public:
+  /**
+   * \brief Rx power at n receivers of a transmission.
+   * \param txPowerDbm transmission power
+   * \param tx position of the transmitter
+   * \param x,y,z receiver positions
+   * \param n number of receivers
+   * \param constantDb 10 log10 (16 pi^2 L / lambda^2)
+   * \param minLoss smallest loss returned (dB)
+   * \param rxDbm n rx powers
+   */
+  static void Compute (double txPowerDbm, const Vector &tx,
+                       const double *x, const double *y, const double *z, uint32_t n,
+                       double constantDb, double minLoss, double *rxDbm)
+  {
+#ifdef FRIIS_BATCH_X86
+    if (HaveAvx2 ())
+      {
+        ComputeAvx2 (txPowerDbm, tx, x, y, z, n, constantDb, minLoss, rxDbm);
+        return;
+      }
+#endif
+    ComputeScalar (txPowerDbm, tx, x, y, z, n, constantDb, minLoss, rxDbm);
+  }
+
+  static void ComputeScalar (double txPowerDbm, const Vector &tx,
+                             const double *x, const double *y, const double *z, uint32_t n,
+                             double constantDb, double minLoss, double *rxDbm)
+  {
+    for (uint32_t i = 0; i < n; i++)
+      {
+        double dx = x[i] - tx.x;
+        double dy = y[i] - tx.y;
+        double dz = z[i] - tx.z;
+        double lossDb = constantDb + 10 * std::log10 (dx * dx + dy * dy + dz * dz);
+        rxDbm[i] = txPowerDbm - std::max (lossDb, minLoss);
+      }
+  }
+
+  /// \return whether ComputeAvx2 () can run on this CPU
+  static bool HaveAvx2 (void)
+  {
+#ifdef FRIIS_BATCH_X86
+    static bool avx2 = __builtin_cpu_supports ("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+  }
+
+#ifdef FRIIS_BATCH_X86
+  __attribute__ ((target ("avx2")))
+  static void ComputeAvx2 (double txPowerDbm, const Vector &tx,
+                           const double *x, const double *y, const double *z, uint32_t n,
+                           double constantDb, double minLoss, double *rxDbm)
+  {
+    const __m256d txX = _mm256_set1_pd (tx.x);
+    const __m256d txY = _mm256_set1_pd (tx.y);
+    const __m256d txZ = _mm256_set1_pd (tx.z);
+    const __m256d power = _mm256_set1_pd (txPowerDbm);
+    const __m256d constant = _mm256_set1_pd (constantDb);
+    const __m256d lossFloor = _mm256_set1_pd (minLoss);
+    const __m256i magic = _mm256_set1_epi64x (0x4330000000000000LL);
+    const __m256d bias = _mm256_set1_pd (4503599627370496.0 + 1023);
+    const __m256i mantissa = _mm256_set1_epi64x (0x000FFFFFFFFFFFFFLL);
+    const __m256i exponentOne = _mm256_set1_epi64x (0x3FF0000000000000LL);
+    const __m256d sqrt2 = _mm256_set1_pd (1.4142135623730951);
+    const __m256d half = _mm256_set1_pd (0.5);
+    const __m256d one = _mm256_set1_pd (1);
+    const __m256d ln2 = _mm256_set1_pd (0.69314718055994531);
+    const __m256d tenOverLn10 = _mm256_set1_pd (4.3429448190325182);
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+      {
+        __m256d dx = _mm256_sub_pd (_mm256_loadu_pd (x + i), txX);
+        __m256d dy = _mm256_sub_pd (_mm256_loadu_pd (y + i), txY);
+        __m256d dz = _mm256_sub_pd (_mm256_loadu_pd (z + i), txZ);
+        __m256d d2 = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (dx, dx), _mm256_mul_pd (dy, dy)),
+                                    _mm256_mul_pd (dz, dz));
+        // log10 (d2): d2 = 2^e m, ln m = 2 atanh (s), s = (m - 1) / (m + 1).
+        // Exponent as a double: 2^52 + biased exponent, minus 2^52 + 1023
+        __m256i bits = _mm256_castpd_si256 (d2);
+        __m256d e = _mm256_sub_pd (_mm256_castsi256_pd (_mm256_or_si256 (_mm256_srli_epi64 (bits, 52), magic)),
+                                   bias);
+        // Mantissa in [1, 2), folded into [sqrt(1/2), sqrt(2)) so that |s| < 0.172
+        __m256d m = _mm256_castsi256_pd (_mm256_or_si256 (_mm256_and_si256 (bits, mantissa), exponentOne));
+        __m256d big = _mm256_cmp_pd (m, sqrt2, _CMP_GT_OQ);
+        m = _mm256_blendv_pd (m, _mm256_mul_pd (m, half), big);
+        e = _mm256_add_pd (e, _mm256_and_pd (big, one));
+        __m256d s = _mm256_div_pd (_mm256_sub_pd (m, one), _mm256_add_pd (m, one));
+        __m256d s2 = _mm256_mul_pd (s, s);
+        __m256d p = _mm256_set1_pd (1.0 / 13);
+        p = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (1.0 / 11));
+        p = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (1.0 / 9));
+        p = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (1.0 / 7));
+        p = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (1.0 / 5));
+        p = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (1.0 / 3));
+        p = _mm256_add_pd (_mm256_mul_pd (p, s2), one);
+        __m256d ln = _mm256_add_pd (_mm256_mul_pd (e, ln2), _mm256_mul_pd (_mm256_add_pd (s, s), p));
+        __m256d lossDb = _mm256_add_pd (constant, _mm256_mul_pd (tenOverLn10, ln));
+        _mm256_storeu_pd (rxDbm + i, _mm256_sub_pd (power, _mm256_max_pd (lossDb, lossFloor)));
+      }
+    ComputeScalar (txPowerDbm, tx, x + i, y + i, z + i, n - i, constantDb, minLoss, rxDbm + i);
+  }
+#endif
+};
+
+class BatchFriisPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  BatchFriisPropagationLossModel ();
+
+  /// \return 10 log10 (16 pi^2 L / lambda^2), the loss at 1 m
+  double GetConstantDb (void) const;
+
+  /// \return smallest loss returned (dB)
+  double GetMinLoss (void) const;
+
+private:
+  virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  double m_frequency;
+  double m_systemLoss;
+  double m_minLoss;
+
+  // Rx powers of the last batch, by SegmentWaypointMobilityModel index
+  mutable PositionBatch m_positions;
+  mutable std::vector<double> m_rxDbm;
+  mutable Time m_time;
+  mutable uint32_t m_sender;
+  mutable double m_txPowerDbm;
+  mutable uint64_t m_version;
+  mutable bool m_valid;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (BatchFriisPropagationLossModel);
+
+TypeId
+BatchFriisPropagationLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BatchFriisPropagationLossModel")
+    .SetParent<PropagationLossModel> ()
+    .AddConstructor<BatchFriisPropagationLossModel> ()
+    .AddAttribute ("Frequency", "Carrier frequency (Hz), as in FriisPropagationLossModel.",
+                   DoubleValue (5.150e9),
+                   MakeDoubleAccessor (&BatchFriisPropagationLossModel::m_frequency),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("SystemLoss", "System loss L (dimensionless).",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&BatchFriisPropagationLossModel::m_systemLoss),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("MinLoss", "Smallest loss returned (dB).",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&BatchFriisPropagationLossModel::m_minLoss),
+                   MakeDoubleChecker<double> ())
+  ;
+  return tid;
+}
+
+BatchFriisPropagationLossModel::BatchFriisPropagationLossModel ()
+  : m_frequency (5.150e9),
+    m_systemLoss (1.0),
+    m_minLoss (0.0),
+    m_sender (0),
+    m_txPowerDbm (0),
+    m_version (0),
+    m_valid (false)
+{
+}
+
+double
+BatchFriisPropagationLossModel::GetConstantDb (void) const
+{
+  double lambda = 299792458.0 / m_frequency;
+  return 10 * std::log10 (16 * M_PI * M_PI * m_systemLoss / (lambda * lambda));
+}
+
+double
+BatchFriisPropagationLossModel::GetMinLoss (void) const
+{
+  return m_minLoss;
+}
+
+double
+BatchFriisPropagationLossModel::DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+  Ptr<SegmentWaypointMobilityModel> sender = DynamicCast<SegmentWaypointMobilityModel> (a);
+  Ptr<SegmentWaypointMobilityModel> receiver = DynamicCast<SegmentWaypointMobilityModel> (b);
+  if (sender == 0 || receiver == 0)
+    {
+      double distance = a->GetDistanceFrom (b);
+      double lossDb = GetConstantDb () + 20 * std::log10 (distance);
+      return txPowerDbm - std::max (lossDb, m_minLoss);
+    }
+  // One batch per transmission: same sender, time, power and positions
+  if (!m_valid || m_time != Simulator::Now () || m_sender != sender->GetIndex ()
+      || m_txPowerDbm != txPowerDbm || m_version != SegmentTable::Get ().version)
+    {
+      SegmentWaypointMobilityModel::GetPositions (m_positions);
+      uint32_t n = m_positions.x.size ();
+      m_rxDbm.resize (n);
+      uint32_t s = sender->GetIndex ();
+      Vector tx (m_positions.x[s], m_positions.y[s], m_positions.z[s]);
+      if (n > 0)
+        {
+          FriisBatch::Compute (txPowerDbm, tx, &m_positions.x[0], &m_positions.y[0], &m_positions.z[0], n,
+                               GetConstantDb (), m_minLoss, &m_rxDbm[0]);
+        }
+      m_valid = true;
+      m_time = Simulator::Now ();
+      m_sender = s;
+      m_txPowerDbm = txPowerDbm;
+      m_version = SegmentTable::Get ().version;
+    }
+  return m_rxDbm[receiver->GetIndex ()];
+}
+
+int64_t
+BatchFriisPropagationLossModel::DoAssignStreams (int64_t stream)
+{
+  return 0;
+}
+
+} // namespace ns3
+
+#endif /* BATCH_FRIIS_LOSS_H */
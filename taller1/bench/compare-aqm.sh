@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# Runs taller1_olsripv6_servicios overloaded (four services at the default
+# 11 Mbps on the 1 Mbps channel) without AQM, with CoDel and with FQ-CoDel
+# over the same seeds, and prints the voice delay percentiles, the voice
+# share of its offered load, and the queue disc and MAC sojourn times.
+#
+# Usage:
+#   NS3_DIR=~/ns-3.26 ./bench/compare-aqm.sh
+#
+# Environment:
+#   NS3_DIR     ns-3 tree whose scratch/ directory receives the scripts
+#   RUNS        RngRun values to average over (default "1 2 3 4 5")
+#   AQMS        queue discs to compare (default "none codel fqcodel")
+#   SERVICE     service whose delay is reported (default voice)
+#   ARGS        extra scenario arguments (default: services to the sink)
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HERE")
+RUNS=${RUNS:-"1 2 3 4 5"}
+AQMS=${AQMS:-"none codel fqcodel"}
+SERVICE=${SERVICE:-voice}
+ARGS=${ARGS:-"--remoteServices=1"}
+
+if [ -z "$NS3_DIR" ]; then
+  echo "NS3_DIR must point to an ns-3 tree" >&2
+  exit 2
+fi
+
+cp "$SRC"/*.cc "$SRC"/*.h "$NS3_DIR/scratch/"
+(cd "$NS3_DIR" && ./waf build >/dev/null)
+
+DELAYS=$(mktemp)
+QUEUES=$(mktemp)
+RUN=$(mktemp)
+trap 'rm -f "$DELAYS" "$QUEUES" "$RUN"' EXIT
+
+for aqm in $AQMS; do
+  for run in $RUNS; do
+    echo "running $aqm, run $run" >&2
+    LOG=$(cd "$NS3_DIR" && ./waf --run "taller1_olsripv6_servicios --tracing=0 --flows=1 --queueStats=1 \
+       --aqm=$aqm --RngRun=$run $ARGS" 2>/dev/null)
+    # aqm packets p50 p90 p95 p99 achieved_pct
+    echo "$LOG" | awk -v a="$aqm" -v s="$SERVICE" '
+      /^# service\tflows/ { section = "load"; next }
+      /^# service\tpackets/ { section = "delay"; next }
+      /^# queue/ { section = "queue"; next }
+      /^#/ { section = ""; next }
+      section == "load" && $1 == s { pct = $5 }
+      section == "delay" && $1 == s { line = $2 " " $3 " " $4 " " $5 " " $6 }
+      section == "queue" { print "Q", a, $0 }
+      END { if (line != "") print "D", a, line, pct }
+    ' > "$RUN"
+    grep '^D ' "$RUN" | cut -d' ' -f2- >> "$DELAYS"
+    grep '^Q ' "$RUN" | cut -d' ' -f2- >> "$QUEUES"
+  done
+done
+
+echo "== $SERVICE delay (ms, averaged over runs)"
+awk '
+  { n[$1]++; p50[$1] += $3; p90[$1] += $4; p95[$1] += $5; p99[$1] += $6; pct[$1] += $7 }
+  END {
+    printf "%-8s %10s %10s %10s %10s %12s\n", "aqm", "p50", "p90", "p95", "p99", "achieved_pct"
+    for (a in n)
+      printf "%-8s %10.1f %10.1f %10.1f %10.1f %12.1f\n", a, p50[a] / n[a], p90[a] / n[a], p95[a] / n[a], p99[a] / n[a], pct[a] / n[a]
+  }
+' "$DELAYS"
+
+echo "== sojourn time per queue (ms, averaged over runs)"
+awk '
+  # aqm queue aqm packets drops mean p50 p95 p99 max
+  { key = $1 " " $2; n[key]++; drops[key] += $5; mean[key] += $6; p95[key] += $8; p99[key] += $9 }
+  END {
+    printf "%-8s %-12s %10s %10s %10s %10s\n", "aqm", "queue", "drops", "mean", "p95", "p99"
+    for (key in n) {
+      split(key, k, " ")
+      printf "%-8s %-12s %10.0f %10.1f %10.1f %10.1f\n", k[1], k[2], drops[key] / n[key], mean[key] / n[key], p95[key] / n[key], p99[key] / n[key]
+    }
+  }
+' "$QUEUES" | sort
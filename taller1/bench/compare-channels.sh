@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+# Runs taller1_olsripv6_servicios with both radios of every node on one
+# channel and on two orthogonal channels, over the same seeds, and prints
+# the aggregate achieved load of the services, the capacity gained and
+# the simulation wall time of each configuration.  It then runs taller1
+# with its four station BSSs sharing the backbone channel and spread over
+# one and two more channels, each BSS client saturating its AP, and prints
+# the aggregate BSS goodput of each.
+#
+# Usage:
+#   NS3_DIR=~/ns-3.26 ./bench/compare-channels.sh
+#
+# Environment:
+#   NS3_DIR     ns-3 tree whose scratch/ directory receives the scripts
+#   RUNS        RngRun values to average over (default "1 2 3 4 5")
+#   ARGS        extra scenario arguments (default: services to the sink)
+#   BSS_LOAD    UDP load (Mbps) each taller1 BSS client offers (default 2)
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HERE")
+RUNS=${RUNS:-"1 2 3 4 5"}
+ARGS=${ARGS:-"--remoteServices=1 --serviceRate=2Mbps"}
+BSS_LOAD=${BSS_LOAD:-2}
+
+if [ -z "$NS3_DIR" ]; then
+  echo "NS3_DIR must point to an ns-3 tree" >&2
+  exit 2
+fi
+
+cp "$SRC"/*.cc "$SRC"/*.h "$NS3_DIR/scratch/"
+(cd "$NS3_DIR" && ./waf build >/dev/null)
+
+RESULTS=$(mktemp)
+trap 'rm -f "$RESULTS"' EXIT
+
+for channels in 1 2; do
+  for run in $RUNS; do
+    echo "running $channels channel(s), run $run" >&2
+    LOG=$(cd "$NS3_DIR" && ./waf --run "taller1_olsripv6_servicios --tracing=0 --flows=1 --bench=1 \
+       --numChannels=$channels --RngRun=$run $ARGS" 2>/dev/null)
+    # channels run achieved_kbps run_s
+    echo "$LOG" | awk -v c="$channels" -v r="$run" '
+      /^# service\tflows/ { on = 1; next }
+      /^#/ { on = 0; next }
+      /^BENCH / { for (i = 2; i <= NF; i++) { split($i, kv, "="); if (kv[1] == "run_s") wall = kv[2] } next }
+      on && NF == 5 && $1 != "-" && $1 != "sink" { achieved += $4 }
+      END { print c, r, achieved, wall }
+    ' >> "$RESULTS"
+  done
+done
+
+awk '
+  { n[$1]++; achieved[$1] += $3; wall[$1] += $4 }
+  END {
+    printf "%-9s %14s %10s %10s\n", "channels", "achieved_kbps", "gain_pct", "run_s"
+    for (c = 1; c <= 2; c++) {
+      if (!(c in n)) continue
+      a = achieved[c] / n[c]
+      base = achieved[1] / n[1]
+      printf "%-9d %14.1f %10.1f %10.2f\n", c, a, base > 0 ? 100 * (a - base) / base : 0, wall[c] / n[c]
+    }
+  }
+' "$RESULTS"
+
+: > "$RESULTS"
+for channels in 1 2 3; do
+  for run in $RUNS; do
+    echo "running taller1 with $channels channel(s), run $run" >&2
+    LOG=$(cd "$NS3_DIR" && ./waf --run "taller1 --tracing=0 --bench=1 --bssLoad=$BSS_LOAD \
+       --numChannels=$channels --RngRun=$run" 2>/dev/null)
+    # channels run goodput_mbps run_s
+    echo "$LOG" | awk -v c="$channels" -v r="$run" '
+      /^BSS channels=/ { split($3, kv, "="); goodput = kv[2]; next }
+      /^BENCH / { for (i = 2; i <= NF; i++) { split($i, kv, "="); if (kv[1] == "run_s") wall = kv[2] } next }
+      END { print c, r, goodput, wall }
+    ' >> "$RESULTS"
+  done
+done
+
+echo
+awk '
+  { n[$1]++; goodput[$1] += $3; wall[$1] += $4 }
+  END {
+    printf "%-9s %14s %10s %10s\n", "channels", "bss_mbps", "gain_pct", "run_s"
+    for (c = 1; c <= 3; c++) {
+      if (!(c in n)) continue
+      g = goodput[c] / n[c]
+      base = goodput[1] / n[1]
+      printf "%-9d %14.3f %10.1f %10.2f\n", c, g, base > 0 ? 100 * (g - base) / base : 0, wall[c] / n[c]
+    }
+  }
+' "$RESULTS"
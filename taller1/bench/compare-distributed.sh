@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# Checks that a distributed run of taller1_olsripv6_servicios gives the
+# results of the sequential run with the same seed: together, the packet
+# traces (taller1-rank<N>.tr) and routing table dumps (taller1-rank<N>.routes)
+# of the ranks must hold the lines of taller1.tr and taller1.routes, in any
+# order.  Both runs keep the nodes still (--mobility=0), which
+# --distributed requires.
+#
+# Usage:
+#   NS3_DIR=~/ns-3.26 ./bench/compare-distributed.sh
+#
+# Environment:
+#   NS3_DIR     ns-3 tree configured with --enable-mpi
+#   RANKS       MPI processes of the distributed run (default 2)
+#   RUN         RngRun of both runs (default 1)
+#   ARGS        extra scenario arguments (default "--numNodes=25")
+#
+# Exit status is 1 when the outputs differ.
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HERE")
+RANKS=${RANKS:-2}
+RUN=${RUN:-1}
+ARGS=${ARGS:-"--numNodes=25"}
+
+if [ -z "$NS3_DIR" ]; then
+  echo "NS3_DIR must point to an ns-3 tree" >&2
+  exit 2
+fi
+
+cp "$SRC"/*.cc "$SRC"/*.h "$NS3_DIR/scratch/"
+(cd "$NS3_DIR" && ./waf build >/dev/null)
+
+SEQUENTIAL=$(mktemp -d)
+DISTRIBUTED=$(mktemp -d)
+trap 'rm -rf "$SEQUENTIAL" "$DISTRIBUTED"' EXIT
+
+SCENARIO="taller1_olsripv6_servicios --tracing=1 --mobility=0 --RngRun=$RUN $ARGS"
+
+echo "running sequentially" >&2
+(cd "$NS3_DIR" && rm -f taller1.tr taller1.routes taller1-rank*.tr taller1-rank*.routes \
+   && ./waf --run "$SCENARIO" >/dev/null)
+for f in tr routes; do
+  sort "$NS3_DIR/taller1.$f" > "$SEQUENTIAL/$f"
+done
+
+echo "running on $RANKS ranks" >&2
+(cd "$NS3_DIR" && ./waf --run "$SCENARIO --distributed=1" \
+   --command-template="mpirun -np $RANKS %s" >/dev/null)
+for f in tr routes; do
+  cat "$NS3_DIR"/taller1-rank*.$f | sort > "$DISTRIBUTED/$f"
+done
+
+status=0
+for f in tr routes; do
+  lines=$(wc -l < "$SEQUENTIAL/$f")
+  if cmp -s "$SEQUENTIAL/$f" "$DISTRIBUTED/$f"; then
+    echo "$f: identical ($lines lines)"
+  else
+    echo "$f: DIFFERENT ($lines lines sequential, $(wc -l < "$DISTRIBUTED/$f") distributed)"
+    diff "$SEQUENTIAL/$f" "$DISTRIBUTED/$f" | head -20
+    status=1
+  fi
+done
+exit $status
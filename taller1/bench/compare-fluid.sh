@@ -0,0 +1,94 @@
+#!/bin/sh
+#
+# Runs taller1_olsripv6_servicios with the best-effort and background
+# services as packets and as fluid load (--fluidBackground) over the same
+# seeds, and prints how far the foreground services (voice and video) move:
+# share of their offered load achieved and delay percentiles per mode, the
+# fluid minus packet difference, and the run time and events each mode took.
+#
+# Usage:
+#   NS3_DIR=~/ns-3.26 ./bench/compare-fluid.sh
+#
+# Environment:
+#   NS3_DIR     ns-3 tree whose scratch/ directory receives the scripts
+#   RUNS        RngRun values to average over (default "1 2 3 4 5")
+#   ARGS        extra scenario arguments (default: services to the sink)
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HERE")
+RUNS=${RUNS:-"1 2 3 4 5"}
+ARGS=${ARGS:-"--remoteServices=1"}
+
+if [ -z "$NS3_DIR" ]; then
+  echo "NS3_DIR must point to an ns-3 tree" >&2
+  exit 2
+fi
+
+cp "$SRC"/*.cc "$SRC"/*.h "$NS3_DIR/scratch/"
+(cd "$NS3_DIR" && ./waf build >/dev/null)
+
+RESULTS=$(mktemp)
+trap 'rm -f "$RESULTS"' EXIT
+
+for fluid in 0 1; do
+  mode=$([ $fluid = 1 ] && echo fluid || echo packets)
+  for run in $RUNS; do
+    echo "running $mode, run $run" >&2
+    LOG=$(cd "$NS3_DIR" && ./waf --run "taller1_olsripv6_servicios --tracing=0 --flows=1 --bench=1 \
+       --fluidBackground=$fluid --RngRun=$run $ARGS" 2>/dev/null)
+    # mode service achieved_pct p50 p95 p99, then mode run_s events
+    echo "$LOG" | awk -v m="$mode" '
+      /^# service\tflows/ { section = "load"; next }
+      /^# service\tpackets/ { section = "delay"; next }
+      /^#/ { section = ""; next }
+      section == "load" && ($1 == "voice" || $1 == "video") { pct[$1] = $5 }
+      section == "delay" && ($1 == "voice" || $1 == "video") { delay[$1] = $3 " " $5 " " $6 }
+      /^BENCH / {
+        for (i = 2; i <= NF; i++) {
+          split($i, kv, "=")
+          if (kv[1] == "run_s") runs = kv[2]
+          if (kv[1] == "events") events = kv[2]
+        }
+      }
+      END {
+        for (s in delay) print "S", m, s, pct[s], delay[s]
+        print "B", m, runs, events
+      }
+    ' >> "$RESULTS"
+  done
+done
+
+echo "== foreground services (averaged over runs)"
+grep '^S ' "$RESULTS" | cut -d' ' -f2- | awk '
+  # mode service achieved_pct p50 p95 p99
+  {
+    key = $2 " " $1; n[key]++; pct[key] += $3; p50[key] += $4; p95[key] += $5; p99[key] += $6
+    services[$2] = 1
+  }
+  END {
+    printf "%-8s %-8s %12s %10s %10s %10s\n", "service", "mode", "achieved_pct", "p50_ms", "p95_ms", "p99_ms"
+    for (s in services) {
+      for (m = 0; m < 2; m++) {
+        mode = m ? "fluid" : "packets"
+        key = s " " mode
+        if (n[key])
+          printf "%-8s %-8s %12.1f %10.1f %10.1f %10.1f\n", s, mode, pct[key] / n[key], p50[key] / n[key], p95[key] / n[key], p99[key] / n[key]
+      }
+      f = s " fluid"; p = s " packets"
+      if (n[f] && n[p])
+        printf "%-8s %-8s %+12.1f %+10.1f %+10.1f %+10.1f\n", s, "diff", pct[f] / n[f] - pct[p] / n[p], p50[f] / n[f] - p50[p] / n[p], p95[f] / n[f] - p95[p] / n[p], p99[f] / n[f] - p99[p] / n[p]
+    }
+  }
+'
+
+echo "== cost (averaged over runs)"
+grep '^B ' "$RESULTS" | cut -d' ' -f2- | awk '
+  { n[$1]++; runs[$1] += $2; events[$1] += $3 }
+  END {
+    printf "%-8s %10s %12s\n", "mode", "run_s", "events"
+    for (m in n)
+      printf "%-8s %10.2f %12.0f\n", m, runs[m] / n[m], events[m] / n[m]
+  }
+'
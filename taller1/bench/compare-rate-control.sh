@@ -0,0 +1,92 @@
+#!/bin/sh
+#
+# Runs taller1_olsripv6_servicios under the Constant, AARF, Minstrel and
+# Ideal rate managers over the same seeds and prints, per manager, goodput
+# and delay per service, retries and drops, and the share of data frames
+# sent at each rate.  The per-link histograms of every run are kept in
+# OUT/rates-<manager>.txt (columns: run node peer mode frames).
+#
+# Usage:
+#   NS3_DIR=~/ns-3.26 ./bench/compare-rate-control.sh
+#
+# Environment:
+#   NS3_DIR     ns-3 tree whose scratch/ directory receives the scripts
+#   RUNS        RngRun values to average over (default "1 2 3 4 5")
+#   MANAGERS    managers to compare (default "constant aarf minstrel ideal")
+#   ARGS        extra scenario arguments (default: services to the sink)
+#   OUT         directory for the histograms (default ./rate-control)
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HERE")
+RUNS=${RUNS:-"1 2 3 4 5"}
+MANAGERS=${MANAGERS:-"constant aarf minstrel ideal"}
+ARGS=${ARGS:-"--remoteServices=1 --serviceRate=1Mbps --numPackets=200 --interval=0.01"}
+OUT=${OUT:-rate-control}
+
+if [ -z "$NS3_DIR" ]; then
+  echo "NS3_DIR must point to an ns-3 tree" >&2
+  exit 2
+fi
+
+cp "$SRC"/*.cc "$SRC"/*.h "$NS3_DIR/scratch/"
+(cd "$NS3_DIR" && ./waf build >/dev/null)
+
+mkdir -p "$OUT"
+SERVICES=$(mktemp)
+DELAYS=$(mktemp)
+TOTALS=$(mktemp)
+trap 'rm -f "$SERVICES" "$DELAYS" "$TOTALS"' EXIT
+
+for manager in $MANAGERS; do
+  : > "$OUT/rates-$manager.txt"
+  for run in $RUNS; do
+    echo "running $manager, run $run" >&2
+    LOG=$(cd "$NS3_DIR" && ./waf --run "taller1_olsripv6_servicios --tracing=0 --flows=1 --rateStats=1 \
+       --manager=$manager --RngRun=$run $ARGS" 2>/dev/null)
+    # service flows offered achieved pct
+    echo "$LOG" | awk -v m="$manager" '/^# service\tflows/ { on = 1; next } /^#/ { on = 0; next } on && NF == 5 { print m, $0 }' >> "$SERVICES"
+    echo "$LOG" | grep '^RATES ' >> "$TOTALS"
+    # flow service source destination tx rx loss offered goodput delay jitter
+    grep -v '^#' "$NS3_DIR/taller1.flows" | awk -v m="$manager" '{ print m, $2, $10 }' >> "$DELAYS"
+    grep -v '^#' "$NS3_DIR/taller1.rates" | sed "s/^/$run /" >> "$OUT/rates-$manager.txt"
+  done
+done
+
+echo "== goodput and delay per service"
+awk '
+  FILENAME == ARGV[1] { key = $1 " " $2; n[key]++; achieved[key] += $5; pct[key] += $6; next }
+  { key = $1 " " $2; dn[key]++; delay[key] += $3 }
+  END {
+    printf "%-10s %-12s %14s %12s %10s\n", "manager", "service", "achieved_kbps", "achieved_pct", "delay_ms"
+    for (key in n) {
+      split(key, k, " ")
+      printf "%-10s %-12s %14.1f %12.1f %10.2f\n", k[1], k[2], achieved[key] / n[key], pct[key] / n[key],
+             (key in dn) ? delay[key] / dn[key] : 0
+    }
+  }
+' "$SERVICES" "$DELAYS" | sort -k1,1 -k2,2
+
+echo "== retries per manager (averaged over runs)"
+awk '
+  {
+    for (i = 2; i <= NF; i++) { split($i, kv, "="); v[kv[1]] = kv[2] }
+    m = v["manager"]; n[m]++
+    frames[m] += v["data_frames"]; retries[m] += v["data_retries"]; drops[m] += v["data_drops"]
+  }
+  END {
+    printf "%-10s %12s %12s %10s %16s\n", "manager", "data_frames", "retries", "drops", "retries_per_frame"
+    for (m in n)
+      printf "%-10s %12.0f %12.0f %10.0f %16.3f\n", m, frames[m] / n[m], retries[m] / n[m], drops[m] / n[m],
+             frames[m] ? retries[m] / frames[m] : 0
+  }
+' "$TOTALS"
+
+echo "== share of data frames per rate (all links)"
+for manager in $MANAGERS; do
+  awk -v m="$manager" '
+    { frames[$4] += $5; total += $5 }
+    END { for (mode in frames) printf "%-10s %-22s %6.1f%%\n", m, mode, total ? 100 * frames[mode] / total : 0 }
+  ' "$OUT/rates-$manager.txt" | sort
+done
@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Runs taller1_olsripv6_servicios with hop-count (OLSR6) and ETX routing
+# over the same seeds and prints goodput, loss and delay per service.
+#
+# The ETX routes are an oracle bound, not a protocol: Olsr6Etx computes them
+# from the link state of every node at once, with no dissemination delay or
+# loss, so the etx rows are what ETX could reach at best.
+#
+# Usage:
+#   NS3_DIR=~/ns-3.26 ./bench/compare-routing.sh
+#
+# Environment:
+#   NS3_DIR     ns-3 tree whose scratch/ directory receives the scripts
+#   RUNS        RngRun values to average over (default "1 2 3 4 5")
+#   ARGS        extra scenario arguments (default: 200 packets source->sink)
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HERE")
+RUNS=${RUNS:-"1 2 3 4 5"}
+ARGS=${ARGS:-"--numPackets=200 --interval=0.01"}
+
+if [ -z "$NS3_DIR" ]; then
+  echo "NS3_DIR must point to an ns-3 tree" >&2
+  exit 2
+fi
+
+cp "$SRC"/*.cc "$SRC"/*.h "$NS3_DIR/scratch/"
+(cd "$NS3_DIR" && ./waf build >/dev/null)
+
+RESULTS=$(mktemp)
+trap 'rm -f "$RESULTS"' EXIT
+
+for routing in olsr etx; do
+  for run in $RUNS; do
+    echo "running $routing, run $run" >&2
+    (cd "$NS3_DIR" && ./waf --run "taller1_olsripv6_servicios --tracing=0 --flows=1 --routing=$routing \
+       --RngRun=$run $ARGS" >/dev/null 2>&1)
+    grep -v '^#' "$NS3_DIR/taller1.flows" | sed "s/^/$routing /" >> "$RESULTS"
+  done
+done
+
+# Columns after the routing name: flow service source destination tx rx
+# loss offered goodput delay jitter
+awk '
+  {
+    key = $3 " " $1
+    services[$3] = 1
+    n[key]++; loss[key] += $8; goodput[key] += $10; delay[key] += $11
+  }
+  END {
+    printf "%-12s %-10s %10s %14s %10s\n", "service", "route", "loss_pct", "goodput_kbps", "delay_ms"
+    for (s in services) {
+      for (r = 1; r <= 2; r++) {
+        routing = r == 1 ? "olsr" : "etx"
+        key = s " " routing
+        if (!(key in n)) continue
+        printf "%-12s %-10s %10.1f %14.1f %10.2f\n", s, r == 1 ? routing : "etx-oracle", loss[key] / n[key], goodput[key] / n[key], delay[key] / n[key]
+      }
+    }
+    print "# etx-oracle: ETX routes from global, instantaneous link state (upper bound, not a protocol)"
+  }
+' "$RESULTS"
@@ -0,0 +1,152 @@
+#!/bin/sh
+#
+# Runs every scenario headless (--tracing=0 --bench=1) at several scales and
+# compares wall time, events/s, peak RSS and allocations against the
+# checked-in baselines.
+#
+# Usage:
+#   NS3_DIR=~/ns-3.26 ./bench/run-benchmarks.sh            # compare
+#   NS3_DIR=~/ns-3.26 ./bench/run-benchmarks.sh --update   # rewrite baselines
+#
+# Environment:
+#   NS3_DIR     ns-3 tree whose scratch/ directory receives the scripts
+#   TOLERANCE   allowed relative regression in percent (default 10)
+#   SCALES      node counts for the scalable scenarios (default "25 250 2500")
+#   LOG         stderr of every run (default $NS3_DIR/run-benchmarks.log)
+#
+# allocs stays 0, and is not compared, unless the ns-3 tree was configured
+# with CXXFLAGS="-DALLOC_STATS"; the other metrics, peak RSS in particular,
+# are meant to be measured without it.
+#
+# While baselines.txt holds no measurements the first run writes them, as
+# --update does, so the gate compares from the second run on.
+#
+# Exit status is 1 when at least one metric regressed beyond TOLERANCE, or
+# when a scenario (or a scale with a baseline) printed no BENCH line, e.g.
+# because it crashed or aborted; its stderr is in LOG.
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC=$(dirname "$HERE")
+BASELINES="$HERE/baselines.txt"
+TOLERANCE=${TOLERANCE:-10}
+SCALES=${SCALES:-"25 250 2500"}
+LOG=${LOG:-"$NS3_DIR/run-benchmarks.log"}
+UPDATE=0
+if [ "$1" = "--update" ]; then
+  UPDATE=1
+fi
+
+if [ -z "$NS3_DIR" ]; then
+  echo "NS3_DIR must point to an ns-3 tree" >&2
+  exit 2
+fi
+
+# A comparison against an empty baseline file would pass whatever happens:
+# record the first baselines instead.
+if [ $UPDATE -eq 0 ] && ! grep -qv '^#' "$BASELINES"; then
+  echo "$BASELINES has no measurements; this run records them" >&2
+  UPDATE=1
+fi
+
+# Scenarios that take --numNodes; the others have a fixed topology.
+SCALABLE="taller1 wifi-simple-adhoc wifi-simple-adhoc2 wifi-simple-adhoc3 taller1_olsripv6 taller1_olsripv6_servicios"
+FIXED="taller2-3 wifi-blockack"
+
+cp "$SRC"/*.cc "$SRC"/*.h "$NS3_DIR/scratch/"
+(cd "$NS3_DIR" && ./waf build >/dev/null)
+
+RESULTS=$(mktemp)
+OUTPUT=$(mktemp)
+trap 'rm -f "$RESULTS" "$OUTPUT"' EXIT
+: > "$LOG"
+MISSING=0
+
+run ()
+{
+  # $1 scenario, $2 extra arguments
+  echo "=== $1 $2" >> "$LOG"
+  status=0
+  (cd "$NS3_DIR" && ./waf --run "$1 --tracing=0 --bench=1 $2") > "$OUTPUT" 2>> "$LOG" || status=$?
+  if grep -q '^BENCH ' "$OUTPUT"; then
+    grep '^BENCH ' "$OUTPUT" | sed 's/^BENCH //' >> "$RESULTS"
+  else
+    echo "$1 $2: no BENCH line (exit status $status), see $LOG" >&2
+    MISSING=$((MISSING + 1))
+  fi
+}
+
+for s in $SCALABLE; do
+  for n in $SCALES; do
+    echo "running $s with $n nodes" >&2
+    run "$s" "--numNodes=$n"
+  done
+done
+for s in $FIXED; do
+  echo "running $s" >&2
+  run "$s" ""
+done
+
+if [ $UPDATE -eq 1 ]; then
+  if [ $MISSING -gt 0 ]; then
+    echo "$MISSING runs failed; baselines not written" >&2
+    exit 1
+  fi
+  {
+    echo "# scenario nodes setup_s run_s events events_per_s peak_rss_kb allocs"
+    echo "# generated by bench/run-benchmarks.sh --update on $(uname -n)"
+    awk '{
+      for (i = 1; i <= NF; i++) { split ($i, kv, "="); v[kv[1]] = kv[2] }
+      print v["scenario"], v["nodes"], v["setup_s"], v["run_s"], v["events"], v["events_per_s"], v["peak_rss_kb"], v["allocs"]
+    }' "$RESULTS"
+  } > "$BASELINES"
+  echo "baselines written to $BASELINES" >&2
+  exit 0
+fi
+
+# Lower is better for everything except events_per_s.
+status=0
+awk -v tol="$TOLERANCE" '
+  FNR == NR {
+    if ($0 ~ /^#/ || NF < 8) next
+    key = $1 " " $2
+    base[key, "setup_s"] = $3; base[key, "run_s"] = $4; base[key, "events"] = $5
+    base[key, "events_per_s"] = $6; base[key, "peak_rss_kb"] = $7; base[key, "allocs"] = $8
+    known[key] = 1
+    next
+  }
+  {
+    for (i = 1; i <= NF; i++) { split ($i, kv, "="); v[kv[1]] = kv[2] }
+    key = v["scenario"] " " v["nodes"]
+    seen[key] = 1
+    if (!(key in known)) {
+      printf "%-30s %6s  no baseline\n", v["scenario"], v["nodes"]
+      next
+    }
+    n = split ("setup_s run_s events events_per_s peak_rss_kb allocs", metrics, " ")
+    for (m = 1; m <= n; m++) {
+      name = metrics[m]
+      b = base[key, name]; c = v[name]
+      if (b == 0 || c == 0) continue
+      delta = 100 * (c - b) / b
+      if (name == "events_per_s") delta = -delta
+      flag = delta > tol ? "REGRESSION" : "ok"
+      if (delta > tol) failed = 1
+      printf "%-30s %6s  %-13s %14s -> %14s  %+7.1f%%  %s\n", v["scenario"], v["nodes"], name, b, c, delta, flag
+    }
+  }
+  END {
+    for (key in known) {
+      if (key in seen) continue
+      split (key, k, " ")
+      printf "%-30s %6s  no result\n", k[1], k[2]
+      failed = 1
+    }
+    exit failed
+  }
+' "$BASELINES" "$RESULTS" || status=1
+if [ $MISSING -gt 0 ]; then
+  status=1
+fi
+exit $status
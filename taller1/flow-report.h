@@ -0,0 +1,217 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Per-flow goodput, loss and delay from FlowMonitor, with the flows named
+// after the service they carry.
+//
+// Flows are matched to services by destination port or, failing that,
+// destination address; unnamed flows (e.g. traffic towards a node without
+// a service) are reported as "-".  Offered load is transmitted bits over
+// the time between the first and the last transmission of the flow,
+// goodput is received bits over the time between the first transmission
+// and the last reception.  FlowMonitor counts whole IP packets, so both
+// include the IPv6 and UDP headers (48 bytes per packet), not only the
+// application payload.  WriteServices () sums both over the flows of
+// each service; WriteDelays () merges their delay histograms (bins of
+// FlowMonitor::DelayBinWidth) and prints percentiles, each the upper edge
+// of the bin it falls in.
+//
+
+#ifndef FLOW_REPORT_H
+#define FLOW_REPORT_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv6-flow-classifier.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace ns3 {
+
+class FlowReport
+{
+public:
+  /**
+   * \brief Install FlowMonitor on the nodes.
+   * \param nodes nodes sending or receiving the flows
+   */
+  void Install (NodeContainer nodes)
+  {
+    m_monitor = m_helper.Install (nodes);
+  }
+
+  /**
+   * \brief Name the flows towards an address.
+   * \param destination destination address of the flows
+   * \param service name printed in the report
+   */
+  void SetName (Ipv6Address destination, std::string service)
+  {
+    m_names[destination] = service;
+  }
+
+  /**
+   * \brief Name the flows towards a port; takes precedence over addresses.
+   * \param port destination port of the flows
+   * \param service name printed in the report
+   */
+  void SetName (uint16_t port, std::string service)
+  {
+    m_ports[port] = service;
+  }
+
+  /// Write one line per flow.
+  void Write (std::ostream &os)
+  {
+    m_monitor->CheckForLostPackets ();
+    Ptr<Ipv6FlowClassifier> classifier = DynamicCast<Ipv6FlowClassifier> (m_helper.GetClassifier6 ());
+    FlowMonitor::FlowStatsContainer stats = m_monitor->GetFlowStats ();
+    os << "# flow\tservice\tsource\tdestination\ttx_packets\trx_packets\tloss_pct"
+       << "\toffered_kbps\tgoodput_kbps\tdelay_ms\tjitter_ms" << std::endl;
+    for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); i++)
+      {
+        Ipv6FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+        const FlowMonitor::FlowStats &s = i->second;
+        os << i->first
+           << "\t" << GetName (t)
+           << "\t" << t.sourceAddress
+           << "\t" << t.destinationAddress
+           << "\t" << s.txPackets
+           << "\t" << s.rxPackets
+           << "\t" << (s.txPackets ? 100.0 * (s.txPackets - s.rxPackets) / s.txPackets : 0)
+           << "\t" << Offered (s)
+           << "\t" << Goodput (s)
+           << "\t" << (s.rxPackets ? s.delaySum.GetSeconds () / s.rxPackets * 1e3 : 0)
+           << "\t" << (s.rxPackets > 1 ? s.jitterSum.GetSeconds () / (s.rxPackets - 1) * 1e3 : 0)
+           << std::endl;
+      }
+  }
+
+  /// Write offered and achieved load summed over the flows of each service.
+  void WriteServices (std::ostream &os)
+  {
+    m_monitor->CheckForLostPackets ();
+    Ptr<Ipv6FlowClassifier> classifier = DynamicCast<Ipv6FlowClassifier> (m_helper.GetClassifier6 ());
+    FlowMonitor::FlowStatsContainer stats = m_monitor->GetFlowStats ();
+    std::map<std::string, Load> services;
+    for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); i++)
+      {
+        Load &load = services[GetName (classifier->FindFlow (i->first))];
+        load.flows++;
+        load.offered += Offered (i->second);
+        load.achieved += Goodput (i->second);
+      }
+    os << "# service\tflows\toffered_kbps\tachieved_kbps\tachieved_pct" << std::endl;
+    for (std::map<std::string, Load>::const_iterator i = services.begin (); i != services.end (); i++)
+      {
+        os << i->first
+           << "\t" << i->second.flows
+           << "\t" << i->second.offered
+           << "\t" << i->second.achieved
+           << "\t" << (i->second.offered > 0 ? 100 * i->second.achieved / i->second.offered : 0)
+           << std::endl;
+      }
+  }
+
+  /// Write delay percentiles over the packets of each service.
+  void WriteDelays (std::ostream &os)
+  {
+    Ptr<Ipv6FlowClassifier> classifier = DynamicCast<Ipv6FlowClassifier> (m_helper.GetClassifier6 ());
+    FlowMonitor::FlowStatsContainer stats = m_monitor->GetFlowStats ();
+    // service -> bin upper edge (s) -> packets
+    std::map<std::string, std::map<double, uint64_t> > histograms;
+    for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); i++)
+      {
+        std::map<double, uint64_t> &bins = histograms[GetName (classifier->FindFlow (i->first))];
+        const Histogram &h = i->second.delayHistogram;
+        for (uint32_t b = 0; b < h.GetNBins (); b++)
+          {
+            if (h.GetBinCount (b) > 0)
+              {
+                bins[h.GetBinEnd (b)] += h.GetBinCount (b);
+              }
+          }
+      }
+    os << "# service\tpackets\tp50_ms\tp90_ms\tp95_ms\tp99_ms" << std::endl;
+    for (std::map<std::string, std::map<double, uint64_t> >::const_iterator s = histograms.begin ();
+         s != histograms.end (); s++)
+      {
+        uint64_t packets = 0;
+        for (std::map<double, uint64_t>::const_iterator b = s->second.begin (); b != s->second.end (); b++)
+          {
+            packets += b->second;
+          }
+        os << s->first
+           << "\t" << packets
+           << "\t" << Percentile (s->second, packets, 0.50) * 1e3
+           << "\t" << Percentile (s->second, packets, 0.90) * 1e3
+           << "\t" << Percentile (s->second, packets, 0.95) * 1e3
+           << "\t" << Percentile (s->second, packets, 0.99) * 1e3
+           << std::endl;
+      }
+  }
+
+  /// \return the monitor, for histograms and probes
+  Ptr<FlowMonitor> GetMonitor (void) const
+  {
+    return m_monitor;
+  }
+
+private:
+  struct Load
+  {
+    Load () : flows (0), offered (0), achieved (0) {}
+    uint32_t flows;
+    double offered;  // kbps
+    double achieved; // kbps
+  };
+
+  std::string GetName (const Ipv6FlowClassifier::FiveTuple &t) const
+  {
+    std::map<uint16_t, std::string>::const_iterator port = m_ports.find (t.destinationPort);
+    if (port != m_ports.end ())
+      {
+        return port->second;
+      }
+    std::map<Ipv6Address, std::string>::const_iterator name = m_names.find (t.destinationAddress);
+    return name != m_names.end () ? name->second : "-";
+  }
+
+  static double Offered (const FlowMonitor::FlowStats &s)
+  {
+    double duration = (s.timeLastTxPacket - s.timeFirstTxPacket).GetSeconds ();
+    return duration > 0 ? s.txBytes * 8 / duration / 1e3 : 0;
+  }
+
+  static double Goodput (const FlowMonitor::FlowStats &s)
+  {
+    double duration = (s.timeLastRxPacket - s.timeFirstTxPacket).GetSeconds ();
+    return duration > 0 ? s.rxBytes * 8 / duration / 1e3 : 0;
+  }
+
+  static double Percentile (const std::map<double, uint64_t> &bins, uint64_t packets, double p)
+  {
+    uint64_t seen = 0;
+    for (std::map<double, uint64_t>::const_iterator b = bins.begin (); b != bins.end (); b++)
+      {
+        seen += b->second;
+        if (seen >= p * packets)
+          {
+            return b->first;
+          }
+      }
+    return 0;
+  }
+
+  FlowMonitorHelper m_helper;
+  Ptr<FlowMonitor> m_monitor;
+  std::map<Ipv6Address, std::string> m_names;
+  std::map<uint16_t, std::string> m_ports;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_REPORT_H */
@@ -0,0 +1,497 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Fluid background traffic: the airtime and queue occupancy of a bulk
+// OnOff flow, without its packets.
+//
+// A packet-level 11 Mbps OnOff source generates thousands of packets per
+// second, each going through the socket, IPv6, the MAC queue, DCF backoff
+// and a PHY reception at every node in range.  When the flow only exists
+// to load the network, the same effect on the foreground flows can be had
+// from a rate process:
+//
+//  - while On, the source fills a fluid backlog at DataRate.  The backlog
+//    stands for PacketSize packets waiting in the device's MAC queue: it
+//    takes the room the foreground packets leave there, the excess is
+//    counted as dropped, and the queue's MaxSize is lowered by the packets
+//    it holds, so that foreground packets meet the queue as full as they
+//    would behind real ones;
+//  - when its own PHY is idle, the source serves up to BurstDuration of
+//    airtime from the backlog.  Every bit costs 1/PhyRate, plus its share
+//    of the headers and per-frame overhead (preamble, SIFS, ACK, DIFS) of
+//    PacketSize frames;
+//  - the burst is applied to the channel by putting the source's PHY and
+//    every PHY that receives it above its CcaMode1Threshold in CCA_BUSY for
+//    the burst, so their DCFs defer exactly as they would to real frames.
+//    The received power is the one YansWifiChannel computes: TxPowerStart
+//    and TxGain of the source, the channel's propagation loss model and the
+//    RxGain of the receiver;
+//  - between bursts the source leaves a DIFS and a mean backoff idle, and
+//    when its PHY is busy it waits until it is idle again, so foreground
+//    stations still win the medium in between;
+//  - the burst then crosses the path the routing gives toward the
+//    destination (RouteOutput () of every node in turn, as a packet would
+//    be forwarded): each relay, once its PHY is idle, occupies its own
+//    neighborhood for the same airtime, a gap after the previous hop.  A
+//    source without a route drops the burst, as its socket would.
+//
+// Events scale with the number of bursts and hops instead of the number of
+// packets and receivers.  Foreground frames overlapping a burst are
+// deferred but not corrupted, and only the source's MAC queue holds the
+// backlog: relays forward it without queueing.  bench/compare-fluid.sh
+// measures how far the foreground results move from the packet-level run.
+//
+
+#ifndef FLUID_BACKGROUND_H
+#define FLUID_BACKGROUND_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/wifi-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+class FluidBackgroundSource : public Application
+{
+public:
+  static TypeId GetTypeId (void);
+
+  FluidBackgroundSource ();
+
+  /// Use this device's PHY, MAC queue and channel (defaults to the first Wi-Fi device).
+  void SetDevice (Ptr<WifiNetDevice> device);
+
+  /// Route the bursts toward this address, as the packets would be.
+  void SetDestination (Ipv6Address destination);
+
+  /// Write offered, served and dropped load on one line.
+  void Report (std::ostream &os) const;
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  typedef std::vector<Ptr<WifiNetDevice> > Path;
+
+  void Fill (void);
+  void Charge (void);
+  void Toggle (void);
+  void Serve (void);
+  void Forward (Path path, uint32_t hop, Time airtime);
+  void Occupy (Ptr<WifiNetDevice> sender, Time airtime);
+  /// \return the transmitting devices from the source to the destination, empty without a route
+  Path GetPath (void) const;
+  Ptr<WifiNetDevice> GetChannelDevice (Ptr<Node> node) const;
+  double GetAirtimePerBit (void) const;
+
+  DataRate m_rate;
+  uint32_t m_packetSize;
+  DataRate m_phyRate;
+  Time m_overhead;
+  uint32_t m_headerBytes;
+  Time m_burst;
+  Time m_gap;
+  uint32_t m_maxHops;
+  Ptr<RandomVariableStream> m_onTime;
+  Ptr<RandomVariableStream> m_offTime;
+
+  Ptr<WifiNetDevice> m_device;
+  Ipv6Address m_destination;
+  std::map<Ipv6Address, Ptr<Node> > m_owner; // node of every address
+  Ptr<WifiMacQueue> m_queue;
+  uint32_t m_queueLimit; // MaxSize of m_queue before the backlog
+  bool m_on;
+  double m_backlog;  // bits
+  Time m_filled;     // backlog accounted up to here
+  Time m_started;
+  Time m_stopped;
+  EventId m_toggleEvent;
+  EventId m_serveEvent;
+
+  double m_offered;  // bits
+  double m_served;   // bits
+  double m_dropped;  // bits
+  Time m_busy;
+  Time m_relayed;
+  uint64_t m_hops;   // relays crossed, summed over bursts
+  uint64_t m_bursts;
+  uint64_t m_deferrals;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (FluidBackgroundSource);
+
+TypeId
+FluidBackgroundSource::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FluidBackgroundSource")
+    .SetParent<Application> ()
+    .AddConstructor<FluidBackgroundSource> ()
+    .AddAttribute ("DataRate", "Rate of the fluid while On.",
+                   DataRateValue (DataRate ("500kb/s")),
+                   MakeDataRateAccessor (&FluidBackgroundSource::m_rate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("PacketSize", "Payload of the frames the fluid stands for.",
+                   UintegerValue (512),
+                   MakeUintegerAccessor (&FluidBackgroundSource::m_packetSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("OnTime", "Duration of the On periods, as in OnOffApplication.",
+                   StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"),
+                   MakePointerAccessor (&FluidBackgroundSource::m_onTime),
+                   MakePointerChecker <RandomVariableStream> ())
+    .AddAttribute ("OffTime", "Duration of the Off periods, as in OnOffApplication.",
+                   StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"),
+                   MakePointerAccessor (&FluidBackgroundSource::m_offTime),
+                   MakePointerChecker <RandomVariableStream> ())
+    .AddAttribute ("PhyRate", "Data rate of the frames on the air.",
+                   DataRateValue (DataRate ("1Mbps")),
+                   MakeDataRateAccessor (&FluidBackgroundSource::m_phyRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("PerPacketOverhead", "Preamble, SIFS, ACK and DIFS of every frame.",
+                   TimeValue (MicroSeconds (192 + 10 + 304 + 50)),
+                   MakeTimeAccessor (&FluidBackgroundSource::m_overhead),
+                   MakeTimeChecker ())
+    .AddAttribute ("HeaderBytes", "UDP, IPv6, LLC/SNAP and 802.11 header bytes of every frame.",
+                   UintegerValue (8 + 40 + 8 + 28),
+                   MakeUintegerAccessor (&FluidBackgroundSource::m_headerBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("BurstDuration", "Longest airtime served at once.",
+                   TimeValue (MilliSeconds (5)),
+                   MakeTimeAccessor (&FluidBackgroundSource::m_burst),
+                   MakeTimeChecker ())
+    .AddAttribute ("Gap", "Idle time left after a burst (DIFS and mean backoff).",
+                   TimeValue (MicroSeconds (50 + 310)),
+                   MakeTimeAccessor (&FluidBackgroundSource::m_gap),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxHops", "Longest path followed toward the destination.",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&FluidBackgroundSource::m_maxHops),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+FluidBackgroundSource::FluidBackgroundSource ()
+  : m_rate (DataRate ("500kb/s")),
+    m_packetSize (512),
+    m_phyRate (DataRate ("1Mbps")),
+    m_overhead (MicroSeconds (192 + 10 + 304 + 50)),
+    m_headerBytes (8 + 40 + 8 + 28),
+    m_burst (MilliSeconds (5)),
+    m_gap (MicroSeconds (50 + 310)),
+    m_maxHops (16),
+    m_queueLimit (0),
+    m_on (false),
+    m_backlog (0),
+    m_offered (0),
+    m_served (0),
+    m_dropped (0),
+    m_busy (Seconds (0)),
+    m_relayed (Seconds (0)),
+    m_hops (0),
+    m_bursts (0),
+    m_deferrals (0)
+{
+}
+
+void
+FluidBackgroundSource::SetDevice (Ptr<WifiNetDevice> device)
+{
+  m_device = device;
+}
+
+void
+FluidBackgroundSource::SetDestination (Ipv6Address destination)
+{
+  m_destination = destination;
+}
+
+void
+FluidBackgroundSource::StartApplication (void)
+{
+  if (m_device == 0)
+    {
+      for (uint32_t i = 0; i < GetNode ()->GetNDevices () && m_device == 0; i++)
+        {
+          m_device = DynamicCast<WifiNetDevice> (GetNode ()->GetDevice (i));
+        }
+      NS_ABORT_MSG_IF (m_device == 0, "FluidBackgroundSource needs a Wi-Fi device");
+    }
+  NS_ABORT_MSG_IF (m_destination.IsAny (), "FluidBackgroundSource needs a destination");
+  m_owner.clear ();
+  for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); n++)
+    {
+      Ptr<Ipv6> ipv6 = (*n)->GetObject<Ipv6> ();
+      for (uint32_t i = 0; ipv6 != 0 && i < ipv6->GetNInterfaces (); i++)
+        {
+          for (uint32_t j = 0; j < ipv6->GetNAddresses (i); j++)
+            {
+              m_owner[ipv6->GetAddress (i, j).GetAddress ()] = *n;
+            }
+        }
+    }
+  // The queue AdhocWifiMac puts untagged packets in
+  BooleanValue qos;
+  m_device->GetMac ()->GetAttribute ("QosSupported", qos);
+  PointerValue txop;
+  m_device->GetMac ()->GetAttribute (qos.Get () ? "BE_EdcaTxopN" : "DcaTxop", txop);
+  PointerValue queue;
+  txop.Get<Object> ()->GetAttribute ("Queue", queue);
+  m_queue = queue.Get<WifiMacQueue> ();
+  m_queueLimit = m_queue->GetMaxSize ();
+  m_filled = Simulator::Now ();
+  m_started = Simulator::Now ();
+  m_stopped = Seconds (0);
+  // Starts Off, like OnOffApplication
+  m_on = false;
+  m_toggleEvent = Simulator::Schedule (Seconds (m_offTime->GetValue ()), &FluidBackgroundSource::Toggle, this);
+}
+
+void
+FluidBackgroundSource::StopApplication (void)
+{
+  Fill ();
+  m_on = false;
+  m_stopped = Simulator::Now ();
+  Simulator::Cancel (m_toggleEvent);
+  Simulator::Cancel (m_serveEvent);
+  // Bursts still crossing relays finish; the queue gets its room back
+  m_queue->SetMaxSize (m_queueLimit);
+}
+
+void
+FluidBackgroundSource::Fill (void)
+{
+  if (m_on)
+    {
+      double bits = m_rate.GetBitRate () * (Simulator::Now () - m_filled).GetSeconds ();
+      m_offered += bits;
+      m_backlog += bits;
+      // The room the foreground packets leave in the MAC queue
+      uint32_t foreground = std::min (m_queue->GetSize (), m_queueLimit);
+      double capacity = (m_queueLimit - foreground) * m_packetSize * 8.0;
+      if (m_backlog > capacity)
+        {
+          m_dropped += m_backlog - capacity;
+          m_backlog = capacity;
+        }
+    }
+  m_filled = Simulator::Now ();
+  Charge ();
+}
+
+void
+FluidBackgroundSource::Charge (void)
+{
+  uint32_t packets = static_cast<uint32_t> (std::ceil (m_backlog / (m_packetSize * 8.0)));
+  uint32_t room = m_queueLimit > packets ? m_queueLimit - packets : 0;
+  // WifiMacQueue only drops when its size equals MaxSize, so MaxSize
+  // never goes below the packets already queued
+  m_queue->SetMaxSize (std::max (room, m_queue->GetSize ()));
+}
+
+void
+FluidBackgroundSource::Toggle (void)
+{
+  Fill ();
+  m_on = !m_on;
+  Time next = Seconds ((m_on ? m_onTime : m_offTime)->GetValue ());
+  m_toggleEvent = Simulator::Schedule (next, &FluidBackgroundSource::Toggle, this);
+  if (m_on && !m_serveEvent.IsRunning ())
+    {
+      m_serveEvent = Simulator::ScheduleNow (&FluidBackgroundSource::Serve, this);
+    }
+}
+
+double
+FluidBackgroundSource::GetAirtimePerBit (void) const
+{
+  double payloadBits = m_packetSize * 8.0;
+  double frameBits = (m_packetSize + m_headerBytes) * 8.0;
+  return (frameBits / m_phyRate.GetBitRate () + m_overhead.GetSeconds ()) / payloadBits;
+}
+
+void
+FluidBackgroundSource::Serve (void)
+{
+  Fill ();
+  PointerValue state;
+  m_device->GetPhy ()->GetAttribute ("State", state);
+  Ptr<WifiPhyStateHelper> phyState = state.Get<WifiPhyStateHelper> ();
+  if (!phyState->IsStateIdle ())
+    {
+      // Defer to the frame (or burst) on the air, then contend again
+      m_deferrals++;
+      m_serveEvent = Simulator::Schedule (phyState->GetDelayUntilIdle () + m_gap, &FluidBackgroundSource::Serve, this);
+      return;
+    }
+  if (m_backlog <= 0)
+    {
+      if (m_on)
+        {
+          m_serveEvent = Simulator::Schedule (m_burst, &FluidBackgroundSource::Serve, this);
+        }
+      return;
+    }
+  double perBit = GetAirtimePerBit ();
+  double bits = std::min (m_backlog, m_burst.GetSeconds () / perBit);
+  Time airtime = Seconds (bits * perBit);
+  m_backlog -= bits;
+  Charge ();
+  Path path = GetPath ();
+  if (path.empty ())
+    {
+      // No route: the socket would have refused the packets
+      m_dropped += bits;
+      m_serveEvent = Simulator::Schedule (m_burst, &FluidBackgroundSource::Serve, this);
+      return;
+    }
+  m_served += bits;
+  m_bursts++;
+  m_busy += airtime;
+  Occupy (m_device, airtime);
+  if (path.size () > 1)
+    {
+      m_hops += path.size () - 1;
+      Simulator::Schedule (airtime + m_gap, &FluidBackgroundSource::Forward, this, path, 1, airtime);
+    }
+  m_serveEvent = Simulator::Schedule (airtime + m_gap, &FluidBackgroundSource::Serve, this);
+}
+
+void
+FluidBackgroundSource::Forward (Path path, uint32_t hop, Time airtime)
+{
+  PointerValue state;
+  path[hop]->GetPhy ()->GetAttribute ("State", state);
+  Ptr<WifiPhyStateHelper> phyState = state.Get<WifiPhyStateHelper> ();
+  if (!phyState->IsStateIdle ())
+    {
+      m_deferrals++;
+      Simulator::Schedule (phyState->GetDelayUntilIdle () + m_gap, &FluidBackgroundSource::Forward, this,
+                           path, hop, airtime);
+      return;
+    }
+  m_relayed += airtime;
+  Occupy (path[hop], airtime);
+  if (hop + 1 < path.size ())
+    {
+      Simulator::Schedule (airtime + m_gap, &FluidBackgroundSource::Forward, this, path, hop + 1, airtime);
+    }
+}
+
+FluidBackgroundSource::Path
+FluidBackgroundSource::GetPath (void) const
+{
+  Path path;
+  std::map<Ipv6Address, Ptr<Node> >::const_iterator owner = m_owner.find (m_destination);
+  Ptr<Node> destination = owner == m_owner.end () ? 0 : owner->second;
+  Ptr<Node> node = GetNode ();
+  Ptr<WifiNetDevice> device = m_device;
+  while (path.size () < m_maxHops)
+    {
+      Ipv6Header header;
+      header.SetDestinationAddress (m_destination);
+      Socket::SocketErrno err;
+      Ptr<Ipv6Route> route = node->GetObject<Ipv6> ()->GetRoutingProtocol ()->RouteOutput (Create<Packet> (), header,
+                                                                                           0, err);
+      if (route == 0)
+        {
+          // At the source the socket refuses the packets; at a relay IPv6
+          // drops them after the hops so far carried them
+          return path;
+        }
+      path.push_back (device);
+      Ipv6Address gateway = route->GetGateway ();
+      owner = m_owner.find (gateway);
+      if (gateway.IsAny () || owner == m_owner.end () || owner->second == destination)
+        {
+          break;
+        }
+      node = owner->second;
+      device = GetChannelDevice (node);
+      if (device == 0)
+        {
+          break;
+        }
+    }
+  return path;
+}
+
+Ptr<WifiNetDevice>
+FluidBackgroundSource::GetChannelDevice (Ptr<Node> node) const
+{
+  Ptr<Channel> channel = m_device->GetChannel ();
+  for (uint32_t i = 0; i < channel->GetNDevices (); i++)
+    {
+      Ptr<NetDevice> device = channel->GetDevice (i);
+      if (device->GetNode () == node)
+        {
+          return DynamicCast<WifiNetDevice> (device);
+        }
+    }
+  return 0;
+}
+
+void
+FluidBackgroundSource::Occupy (Ptr<WifiNetDevice> sender, Time airtime)
+{
+  Ptr<YansWifiChannel> channel = DynamicCast<YansWifiChannel> (sender->GetPhy ()->GetChannel ());
+  Ptr<MobilityModel> source = sender->GetNode ()->GetObject<MobilityModel> ();
+  PointerValue lossValue;
+  channel->GetAttribute ("PropagationLossModel", lossValue);
+  Ptr<PropagationLossModel> loss = lossValue.Get<PropagationLossModel> ();
+  DoubleValue txPower, txGain;
+  sender->GetPhy ()->GetAttribute ("TxPowerStart", txPower);
+  sender->GetPhy ()->GetAttribute ("TxGain", txGain);
+  double txPowerDbm = txPower.Get () + txGain.Get ();
+  for (uint32_t i = 0; i < channel->GetNDevices (); i++)
+    {
+      Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (channel->GetDevice (i));
+      if (device == 0)
+        {
+          continue;
+        }
+      if (device != sender)
+        {
+          Ptr<MobilityModel> receiver = device->GetNode ()->GetObject<MobilityModel> ();
+          DoubleValue rxGain, ccaThreshold;
+          device->GetPhy ()->GetAttribute ("RxGain", rxGain);
+          device->GetPhy ()->GetAttribute ("CcaMode1Threshold", ccaThreshold);
+          if (loss->CalcRxPower (txPowerDbm, source, receiver) + rxGain.Get () < ccaThreshold.Get ())
+            {
+              continue;
+            }
+        }
+      PointerValue state;
+      device->GetPhy ()->GetAttribute ("State", state);
+      state.Get<WifiPhyStateHelper> ()->SwitchMaybeToCcaBusy (airtime);
+    }
+}
+
+void
+FluidBackgroundSource::Report (std::ostream &os) const
+{
+  double seconds = ((m_stopped > m_started ? m_stopped : Simulator::Now ()) - m_started).GetSeconds ();
+  os << "FLUID node=" << GetNode ()->GetId ()
+     << " offered_kbps=" << (seconds > 0 ? m_offered / seconds / 1e3 : 0)
+     << " served_kbps=" << (seconds > 0 ? m_served / seconds / 1e3 : 0)
+     << " dropped_kb=" << m_dropped / 1e3
+     << " backlog_kb=" << m_backlog / 1e3
+     << " airtime_s=" << m_busy.GetSeconds ()
+     << " relayed_airtime_s=" << m_relayed.GetSeconds ()
+     << " bursts=" << m_bursts
+     << " mean_relays=" << (m_bursts > 0 ? double (m_hops) / m_bursts : 0)
+     << " deferrals=" << m_deferrals
+     << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* FLUID_BACKGROUND_H */
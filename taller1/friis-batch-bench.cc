@@ -0,0 +1,157 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Friis microbenchmark: rx power of one transmission at every receiver,
+// FriisPropagationLossModel one receiver at a time against the batch
+// kernels of batch-friis-loss.h.
+//
+// For every receiver count the nodes get random positions in the area of
+// the scenarios, and each transmission is sent by the next node in turn.
+// Four ways of computing the rx powers are timed, in nanoseconds per
+// receiver:
+//
+//   friis   FriisPropagationLossModel::CalcRxPower () per receiver
+//   scalar  FriisBatch::ComputeScalar () over the position arrays
+//   avx2    FriisBatch::ComputeAvx2 () (0 when the CPU lacks AVX2)
+//   model   BatchFriisPropagationLossModel::CalcRxPower () per receiver,
+//           as YansWifiChannel calls it, on SegmentWaypointMobilityModel
+//           nodes: one batch per transmission plus the lookups
+//
+// speedup is friis over model, the gain a YansWifiChannel transmission
+// sees, and the largest difference to FriisPropagationLossModel is printed.
+//
+// ./waf --run "friis-batch-bench --sizes=100,1000,10000"
+//
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+#include "batch-friis-loss.h"
+#include "scenario-bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("FriisBatchBench");
+
+int main (int argc, char *argv[])
+{
+  std::string sizes ("100,1000,10000");
+  uint64_t evaluations = 20000000; // receivers evaluated per size and method
+  double txPowerDbm = 16.0206;
+
+  CommandLine cmd;
+  cmd.AddValue ("sizes", "comma separated receiver counts", sizes);
+  cmd.AddValue ("evaluations", "rx powers computed per size and method", evaluations);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  Ptr<FriisPropagationLossModel> friis = CreateObject<FriisPropagationLossModel> ();
+  Ptr<BatchFriisPropagationLossModel> batch = CreateObject<BatchFriisPropagationLossModel> ();
+
+  std::cout << "receivers\ttransmissions\tfriis_ns\tscalar_ns\tavx2_ns\tmodel_ns\tspeedup\tmax_err_db" << std::endl;
+  std::istringstream list (sizes);
+  std::string item;
+  while (std::getline (list, item, ','))
+    {
+      uint32_t n = atoi (item.c_str ());
+      uint32_t transmissions = std::max<uint64_t> (1, evaluations / n);
+
+      std::vector<Ptr<MobilityModel> > fixed;
+      std::vector<Ptr<MobilityModel> > segments;
+      std::vector<double> x (n), y (n), z (n, 0);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          Vector p (rng->GetValue (20, 1400), rng->GetValue (20, 1400), 0);
+          x[i] = p.x;
+          y[i] = p.y;
+          fixed.push_back (CreateObject<ConstantPositionMobilityModel> ());
+          fixed.back ()->SetPosition (p);
+          segments.push_back (CreateObject<SegmentWaypointMobilityModel> ());
+          segments.back ()->SetPosition (p);
+        }
+
+      std::vector<double> reference (n), rx (n);
+      double start = ScenarioBench::NowSeconds ();
+      for (uint32_t t = 0; t < transmissions; t++)
+        {
+          Ptr<MobilityModel> sender = fixed[t % n];
+          for (uint32_t i = 0; i < n; i++)
+            {
+              reference[i] = friis->CalcRxPower (txPowerDbm, sender, fixed[i]);
+            }
+        }
+      double friisTime = ScenarioBench::NowSeconds () - start;
+
+      start = ScenarioBench::NowSeconds ();
+      for (uint32_t t = 0; t < transmissions; t++)
+        {
+          uint32_t s = t % n;
+          FriisBatch::ComputeScalar (txPowerDbm, Vector (x[s], y[s], z[s]), &x[0], &y[0], &z[0], n,
+                                     batch->GetConstantDb (), batch->GetMinLoss (), &rx[0]);
+        }
+      double scalarTime = ScenarioBench::NowSeconds () - start;
+
+      double maxError = 0;
+      // The last transmission of every method is the same one
+      for (uint32_t i = 0; i < n; i++)
+        {
+          maxError = std::max (maxError, std::fabs (rx[i] - reference[i]));
+        }
+
+      double avx2Time = 0;
+      if (FriisBatch::HaveAvx2 ())
+        {
+          start = ScenarioBench::NowSeconds ();
+          for (uint32_t t = 0; t < transmissions; t++)
+            {
+              uint32_t s = t % n;
+              FriisBatch::ComputeAvx2 (txPowerDbm, Vector (x[s], y[s], z[s]), &x[0], &y[0], &z[0], n,
+                                       batch->GetConstantDb (), batch->GetMinLoss (), &rx[0]);
+            }
+          avx2Time = ScenarioBench::NowSeconds () - start;
+          for (uint32_t i = 0; i < n; i++)
+            {
+              maxError = std::max (maxError, std::fabs (rx[i] - reference[i]));
+            }
+        }
+
+      start = ScenarioBench::NowSeconds ();
+      for (uint32_t t = 0; t < transmissions; t++)
+        {
+          Ptr<MobilityModel> sender = segments[t % n];
+          for (uint32_t i = 0; i < n; i++)
+            {
+              rx[i] = batch->CalcRxPower (txPowerDbm, sender, segments[i]);
+            }
+        }
+      double modelTime = ScenarioBench::NowSeconds () - start;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          maxError = std::max (maxError, std::fabs (rx[i] - reference[i]));
+        }
+
+      double perRx = 1e9 / (double (transmissions) * n);
+      std::cout << n
+                << "\t" << transmissions
+                << "\t" << friisTime * perRx
+                << "\t" << scalarTime * perRx
+                << "\t" << avx2Time * perRx
+                << "\t" << modelTime * perRx
+                << "\t" << (modelTime > 0 ? friisTime / modelTime : 0)
+                << "\t" << maxError
+                << std::endl;
+
+      for (uint32_t i = 0; i < n; i++)
+        {
+          segments[i]->Dispose ();
+        }
+    }
+  Simulator::Destroy ();
+  return 0;
+}
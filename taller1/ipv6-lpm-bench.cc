@@ -0,0 +1,267 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Longest-prefix-match microbenchmark: Ipv6StaticRouting::RouteOutput ()
+// against Ipv6TrieStaticRouting::RouteOutput () over the same routing
+// table.
+//
+// For every table size two nodes get the same random /40 to /64 network
+// routes (as a gateway announcing HNA prefixes would install them), plus
+// the on-link routes of their interface; one node routes with
+// Ipv6StaticRouting, the other with Ipv6TrieStaticRouting.  Every eighth
+// route repeats the prefix of the one before with another gateway, at the
+// same metric or one higher, so that ties are exercised.  Random
+// destinations, half of them inside announced prefixes, are then resolved
+// on both nodes and every answer must select the same gateway.
+//
+// Before that, a fixed table pins the tie rule both must follow: among the
+// routes of the longest matching prefix the lowest metric wins, and among
+// equal metrics the route added last.
+//
+// The exit status is 1 if any answer differs.
+//
+// ./waf --run "ipv6-lpm-bench --lookups=100000"
+//
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ipv6-trie-routing.h"
+#include "scenario-bench.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("Ipv6LpmBench");
+
+static Ipv6Address RandomAddress (Ptr<UniformRandomVariable> rng, const std::vector<Ipv6Address> &prefixes)
+{
+  uint8_t bytes[16];
+  if (!prefixes.empty () && rng->GetInteger (0, 1) == 0)
+    {
+      // Inside an announced prefix, random host part
+      prefixes[rng->GetInteger (0, prefixes.size () - 1)].GetBytes (bytes);
+      for (int i = 8; i < 16; i++)
+        {
+          bytes[i] = rng->GetInteger (0, 255);
+        }
+    }
+  else
+    {
+      bytes[0] = 0x20;
+      bytes[1] = 0x01;
+      bytes[2] = 0x0d;
+      bytes[3] = 0xb8;
+      for (int i = 4; i < 16; i++)
+        {
+          bytes[i] = rng->GetInteger (0, 255);
+        }
+    }
+  return Ipv6Address (bytes);
+}
+
+/**
+ * Creates a node with one interface in 2001:0:1::/64.
+ * \param node container receiving the node
+ * \param routing IPv6 routing of the node
+ * \return the interface index
+ */
+static uint32_t MakeNode (NodeContainer &node, const Ipv6RoutingHelper &routing)
+{
+  node.Create (1);
+  Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+  device->SetAddress (Mac48Address::Allocate ());
+  node.Get (0)->AddDevice (device);
+  InternetStackHelper internet;
+  internet.SetIpv4StackInstall (false);
+  internet.SetRoutingHelper (routing);
+  internet.Install (node);
+  Ipv6AddressHelper ipv6;
+  ipv6.SetBase ("2001:0:1::", Ipv6Prefix (64));
+  return ipv6.Assign (NetDeviceContainer (device)).GetInterfaceIndex (0);
+}
+
+static Ipv6Address Gateway (Ptr<Ipv6RoutingProtocol> routing, Ipv6Address destination)
+{
+  Ipv6Header header;
+  header.SetDestinationAddress (destination);
+  Socket::SocketErrno err;
+  Ptr<Ipv6Route> route = routing->RouteOutput (0, header, 0, err);
+  return route ? route->GetGateway () : Ipv6Address::GetAny ();
+}
+
+/**
+ * Adds the same routes to an Ipv6StaticRouting and an
+ * Ipv6TrieStaticRouting and checks that both select the expected gateway.
+ * \return true if they do
+ */
+static bool CheckTies (void)
+{
+  NodeContainer staticNode;
+  NodeContainer trieNode;
+  uint32_t staticIf = MakeNode (staticNode, Ipv6StaticRoutingHelper ());
+  uint32_t trieIf = MakeNode (trieNode, Ipv6TrieStaticRoutingHelper ());
+  Ipv6StaticRoutingHelper helper;
+  Ptr<Ipv6StaticRouting> linear = helper.GetStaticRouting (staticNode.Get (0)->GetObject<Ipv6> ());
+  Ptr<Ipv6TrieStaticRouting> trie = DynamicCast<Ipv6TrieStaticRouting> (
+      helper.GetStaticRouting (trieNode.Get (0)->GetObject<Ipv6> ()));
+
+  // prefix, gateway, metric
+  const char *routes[][3] = {
+    { "2001:db8:1::", "2001:0:1::a", "0" }, // tie at metric 0: the later b wins
+    { "2001:db8:1::", "2001:0:1::b", "0" },
+    { "2001:db8:2::", "2001:0:1::c", "1" }, // the higher metric d loses
+    { "2001:db8:2::", "2001:0:1::d", "2" },
+    { "2001:db8:3::", "2001:0:1::e", "2" }, // the lower metric f wins
+    { "2001:db8:3::", "2001:0:1::f", "1" },
+  };
+  const char *expected[][2] = {
+    { "2001:db8:1::1", "2001:0:1::b" },
+    { "2001:db8:2::1", "2001:0:1::c" },
+    { "2001:db8:3::1", "2001:0:1::f" },
+  };
+  for (uint32_t i = 0; i < sizeof (routes) / sizeof (routes[0]); i++)
+    {
+      uint32_t metric = atoi (routes[i][2]);
+      linear->AddNetworkRouteTo (Ipv6Address (routes[i][0]), Ipv6Prefix (48), Ipv6Address (routes[i][1]),
+                                 staticIf, metric);
+      trie->AddNetworkRouteTo (Ipv6Address (routes[i][0]), Ipv6Prefix (48), Ipv6Address (routes[i][1]),
+                               trieIf, metric);
+    }
+  bool ok = true;
+  for (uint32_t i = 0; i < sizeof (expected) / sizeof (expected[0]); i++)
+    {
+      Ipv6Address destination (expected[i][0]);
+      Ipv6Address want (expected[i][1]);
+      Ipv6Address fromStatic = Gateway (linear, destination);
+      Ipv6Address fromTrie = Gateway (trie, destination);
+      if (fromStatic != want || fromTrie != want)
+        {
+          NS_LOG_UNCOND ("tie for " << destination << ": expected " << want << ", static "
+                                    << fromStatic << ", trie " << fromTrie);
+          ok = false;
+        }
+    }
+  Simulator::Destroy ();
+  return ok;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string sizes ("100,1000,10000,100000");
+  uint32_t lookups = 100000;
+  uint64_t linearBudget = 200000000; // route visits allowed per size
+
+  CommandLine cmd;
+  cmd.AddValue ("sizes", "comma separated routing table sizes", sizes);
+  cmd.AddValue ("lookups", "trie lookups per table size", lookups);
+  cmd.AddValue ("linearBudget", "caps linear lookups to this many route visits", linearBudget);
+  cmd.Parse (argc, argv);
+
+  bool ok = CheckTies ();
+  std::cout << "ties\t" << (ok ? "yes" : "NO") << std::endl;
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  std::cout << "routes\tlinear_lookups\tlinear_ns\ttrie_lookups\ttrie_ns\tspeedup\tbuild_ms\tagree" << std::endl;
+  std::istringstream list (sizes);
+  std::string item;
+  while (std::getline (list, item, ','))
+    {
+      uint32_t routes = atoi (item.c_str ());
+
+      NodeContainer staticNode;
+      NodeContainer trieNode;
+      uint32_t staticIf = MakeNode (staticNode, Ipv6StaticRoutingHelper ());
+      uint32_t trieIf = MakeNode (trieNode, Ipv6TrieStaticRoutingHelper ());
+      Ipv6StaticRoutingHelper helper;
+      Ptr<Ipv6StaticRouting> linear = helper.GetStaticRouting (staticNode.Get (0)->GetObject<Ipv6> ());
+      Ptr<Ipv6TrieStaticRouting> trie = DynamicCast<Ipv6TrieStaticRouting> (
+          helper.GetStaticRouting (trieNode.Get (0)->GetObject<Ipv6> ()));
+
+      std::vector<Ipv6Address> prefixes;
+      uint8_t bytes[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+      uint8_t length = 64;
+      for (uint32_t r = 0; r < routes; r++)
+        {
+          uint32_t metric = 0;
+          if (r % 8 == 7)
+            {
+              // Same prefix as the previous route, tied or worse
+              metric = rng->GetInteger (0, 1);
+            }
+          else
+            {
+              for (int i = 4; i < 8; i++)
+                {
+                  bytes[i] = rng->GetInteger (0, 255);
+                }
+              length = rng->GetInteger (40, 64);
+              prefixes.push_back (Ipv6Address (bytes));
+            }
+          std::ostringstream gateway;
+          gateway << "2001:0:1::" << std::hex << (r % 0xfffe + 1);
+          Ipv6Address next (gateway.str ().c_str ());
+          linear->AddNetworkRouteTo (Ipv6Address (bytes), Ipv6Prefix (length), next, staticIf, metric);
+          trie->AddNetworkRouteTo (Ipv6Address (bytes), Ipv6Prefix (length), next, trieIf, metric);
+        }
+
+      std::vector<Ipv6Address> destinations;
+      destinations.reserve (lookups);
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          destinations.push_back (RandomAddress (rng, prefixes));
+        }
+      uint32_t linearLookups = std::min<uint64_t> (lookups, std::max<uint64_t> (100, linearBudget / (routes + 1)));
+
+      std::vector<Ipv6Address> linearGateways (linearLookups);
+      double start = ScenarioBench::NowSeconds ();
+      for (uint32_t i = 0; i < linearLookups; i++)
+        {
+          linearGateways[i] = Gateway (linear, destinations[i]);
+        }
+      double linearTime = ScenarioBench::NowSeconds () - start;
+
+      // The first lookup builds the trie
+      start = ScenarioBench::NowSeconds ();
+      Gateway (trie, destinations[0]);
+      double build = ScenarioBench::NowSeconds () - start;
+
+      std::vector<Ipv6Address> trieGateways (lookups);
+      start = ScenarioBench::NowSeconds ();
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          trieGateways[i] = Gateway (trie, destinations[i]);
+        }
+      double trieTime = ScenarioBench::NowSeconds () - start;
+
+      bool agree = true;
+      for (uint32_t i = 0; i < linearLookups; i++)
+        {
+          if (trieGateways[i] != linearGateways[i])
+            {
+              NS_LOG_UNCOND ("mismatch for " << destinations[i] << ": static " << linearGateways[i]
+                                             << ", trie " << trieGateways[i]);
+              agree = false;
+            }
+        }
+      ok = ok && agree;
+
+      double linearNs = linearTime / linearLookups * 1e9;
+      double trieNs = trieTime / lookups * 1e9;
+      std::cout << linear->GetNRoutes ()
+                << "\t" << linearLookups
+                << "\t" << linearNs
+                << "\t" << lookups
+                << "\t" << trieNs
+                << "\t" << (trieNs > 0 ? linearNs / trieNs : 0)
+                << "\t" << build * 1e3
+                << "\t" << (agree ? "yes" : "NO")
+                << std::endl;
+      Simulator::Destroy ();
+    }
+  return ok ? 0 : 1;
+}
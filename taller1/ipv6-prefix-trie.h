@@ -0,0 +1,355 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Longest-prefix-match table for IPv6 prefixes.
+//
+// Ipv6StaticRouting looks routes up by walking its route list and keeping
+// the longest matching mask, so every forwarded packet costs O(routes).
+// Gateways announcing hundreds of HNA prefixes (taller2-3.cc) make that the
+// dominant per-packet cost.  This is a path-compressed binary trie
+// (PATRICIA): every node stores a prefix and its length, internal nodes
+// exist only where two prefixes diverge, so a lookup visits at most
+// min(128, 2 x prefixes) nodes and in practice one per distinct prefix
+// length on the path.  Nodes live in a vector and link by index to keep
+// them contiguous.
+//
+// T is the value stored per prefix (e.g. an index into a route list).
+// Ipv6TrieStaticRouting (ipv6-trie-routing.h) uses it for the route
+// lookups of Ipv6StaticRouting; taller2-3.cc installs it on every node.
+//
+
+#ifndef IPV6_PREFIX_TRIE_H
+#define IPV6_PREFIX_TRIE_H
+
+#include "ns3/ipv6-address.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+template <typename T>
+class Ipv6PrefixTrie
+{
+public:
+  Ipv6PrefixTrie ()
+    : m_root (NONE),
+      m_size (0)
+  {
+  }
+
+  /**
+   * \brief Add or replace the value of a prefix.
+   * \param network prefix address (bits beyond length are ignored)
+   * \param length prefix length in bits
+   * \param value value to store
+   */
+  void Insert (Ipv6Address network, uint8_t length, const T &value)
+  {
+    Key key;
+    Load (network, length, key);
+    uint32_t parent = NONE;
+    int side = 0;
+    uint32_t current = m_root;
+    while (true)
+      {
+        if (current == NONE)
+          {
+            Link (parent, side, NewNode (key, length, true, value));
+            m_size++;
+            return;
+          }
+        uint8_t common = CommonLength (m_nodes[current].key, key, std::min (m_nodes[current].length, length));
+        if (common == m_nodes[current].length && common == length)
+          {
+            if (!m_nodes[current].hasValue)
+              {
+                m_size++;
+              }
+            m_nodes[current].hasValue = true;
+            m_nodes[current].value = value;
+            return;
+          }
+        if (common == m_nodes[current].length)
+          {
+            parent = current;
+            side = Bit (key, common);
+            current = m_nodes[current].child[side];
+            continue;
+          }
+        // The new prefix and the current node diverge at bit common
+        if (common == length)
+          {
+            uint32_t n = NewNode (key, length, true, value);
+            Attach (n, Bit (m_nodes[current].key, length), current);
+            Link (parent, side, n);
+          }
+        else
+          {
+            uint32_t fork = NewNode (key, common, false, T ());
+            uint32_t leaf = NewNode (key, length, true, value);
+            Attach (fork, Bit (m_nodes[current].key, common), current);
+            Attach (fork, Bit (key, common), leaf);
+            Link (parent, side, fork);
+          }
+        m_size++;
+        return;
+      }
+  }
+
+  /**
+   * \brief Remove a prefix.
+   * \param network prefix address
+   * \param length prefix length in bits
+   * \return true if the prefix was present
+   */
+  bool Remove (Ipv6Address network, uint8_t length)
+  {
+    Key key;
+    Load (network, length, key);
+    uint32_t current = m_root;
+    while (current != NONE)
+      {
+        Node &n = m_nodes[current];
+        uint8_t common = CommonLength (n.key, key, std::min (n.length, length));
+        if (common < n.length)
+          {
+            return false;
+          }
+        if (n.length == length)
+          {
+            if (!n.hasValue)
+              {
+                return false;
+              }
+            n.hasValue = false;
+            n.value = T ();
+            m_size--;
+            Compact (current);
+            return true;
+          }
+        current = n.child[Bit (key, n.length)];
+      }
+    return false;
+  }
+
+  /**
+   * \brief Longest prefix containing an address.
+   * \param address address to look up
+   * \param value receives the value of the longest match
+   * \return true if some prefix matched
+   */
+  bool Lookup (Ipv6Address address, T &value) const
+  {
+    Key key;
+    Load (address, 128, key);
+    const Node *best = 0;
+    uint32_t current = m_root;
+    while (current != NONE)
+      {
+        const Node &n = m_nodes[current];
+        if (!Matches (n.key, key, n.length))
+          {
+            break;
+          }
+        if (n.hasValue)
+          {
+            best = &n;
+          }
+        if (n.length == 128)
+          {
+            break;
+          }
+        current = n.child[Bit (key, n.length)];
+      }
+    if (best == 0)
+      {
+        return false;
+      }
+    value = best->value;
+    return true;
+  }
+
+  /// \return number of prefixes stored
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  /// Remove every prefix.
+  void Clear (void)
+  {
+    m_nodes.clear ();
+    m_free.clear ();
+    m_root = NONE;
+    m_size = 0;
+  }
+
+private:
+  static const uint32_t NONE = 0xffffffff;
+
+  struct Key
+  {
+    uint8_t bytes[16];
+  };
+
+  struct Node
+  {
+    Key key;
+    uint8_t length;
+    bool hasValue;
+    uint32_t parent;
+    uint32_t child[2];
+    T value;
+  };
+
+  static void Load (Ipv6Address address, uint8_t length, Key &key)
+  {
+    address.GetBytes (key.bytes);
+    Mask (key, length);
+  }
+
+  /// Clear the host bits so that equal prefixes compare equal.
+  static void Mask (Key &key, uint8_t length)
+  {
+    for (int i = 0; i < 16; i++)
+      {
+        int bits = length - i * 8;
+        if (bits <= 0)
+          {
+            key.bytes[i] = 0;
+          }
+        else if (bits < 8)
+          {
+            key.bytes[i] &= static_cast<uint8_t> (0xff << (8 - bits));
+          }
+      }
+  }
+
+  static int Bit (const Key &key, uint8_t position)
+  {
+    return (key.bytes[position / 8] >> (7 - position % 8)) & 1;
+  }
+
+  /// \return number of leading bits (at most limit) shared by a and b
+  static uint8_t CommonLength (const Key &a, const Key &b, uint8_t limit)
+  {
+    uint8_t length = 0;
+    for (int i = 0; i < 16 && length < limit; i++)
+      {
+        uint8_t diff = a.bytes[i] ^ b.bytes[i];
+        if (diff == 0)
+          {
+            length += 8;
+            continue;
+          }
+        while (!(diff & 0x80))
+          {
+            diff <<= 1;
+            length++;
+          }
+        break;
+      }
+    return std::min (length, limit);
+  }
+
+  static bool Matches (const Key &prefix, const Key &key, uint8_t length)
+  {
+    uint8_t whole = length / 8;
+    if (std::memcmp (prefix.bytes, key.bytes, whole) != 0)
+      {
+        return false;
+      }
+    uint8_t bits = length % 8;
+    if (bits == 0)
+      {
+        return true;
+      }
+    uint8_t mask = static_cast<uint8_t> (0xff << (8 - bits));
+    return (prefix.bytes[whole] & mask) == (key.bytes[whole] & mask);
+  }
+
+  uint32_t NewNode (const Key &key, uint8_t length, bool hasValue, const T &value)
+  {
+    uint32_t index;
+    if (!m_free.empty ())
+      {
+        index = m_free.back ();
+        m_free.pop_back ();
+      }
+    else
+      {
+        index = m_nodes.size ();
+        m_nodes.push_back (Node ());
+      }
+    Node &n = m_nodes[index];
+    n.key = key;
+    Mask (n.key, length);
+    n.length = length;
+    n.hasValue = hasValue;
+    n.parent = NONE;
+    n.child[0] = NONE;
+    n.child[1] = NONE;
+    n.value = value;
+    return index;
+  }
+
+  void Attach (uint32_t parent, int side, uint32_t child)
+  {
+    m_nodes[parent].child[side] = child;
+    m_nodes[child].parent = parent;
+  }
+
+  void Link (uint32_t parent, int side, uint32_t child)
+  {
+    if (parent == NONE)
+      {
+        m_root = child;
+        m_nodes[child].parent = NONE;
+      }
+    else
+      {
+        Attach (parent, side, child);
+      }
+  }
+
+  /// Splice out valueless nodes with fewer than two children, upwards.
+  void Compact (uint32_t index)
+  {
+    while (index != NONE)
+      {
+        Node &n = m_nodes[index];
+        if (n.hasValue || (n.child[0] != NONE && n.child[1] != NONE))
+          {
+            return;
+          }
+        uint32_t child = n.child[0] != NONE ? n.child[0] : n.child[1];
+        uint32_t parent = n.parent;
+        if (parent == NONE)
+          {
+            m_root = child;
+          }
+        else
+          {
+            Node &p = m_nodes[parent];
+            p.child[p.child[0] == index ? 0 : 1] = child;
+          }
+        if (child != NONE)
+          {
+            m_nodes[child].parent = parent;
+          }
+        m_free.push_back (index);
+        index = parent;
+      }
+  }
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_free;
+  uint32_t m_root;
+  uint32_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* IPV6_PREFIX_TRIE_H */
@@ -0,0 +1,466 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Ipv6StaticRouting with longest-prefix-match lookups through an
+// Ipv6PrefixTrie.
+//
+// Ipv6TrieStaticRouting keeps the route list of Ipv6StaticRouting
+// (GetRoute () and PrintRoutingTable () are the base class ones) and
+// overrides RouteOutput () and RouteInput (): unicast, non link-local
+// destinations are resolved in the trie, which maps every prefix to a copy
+// of its route (destination, gateway, interface, metric).  Like
+// LookupStatic, which replaces its candidate with every later route of the
+// same length and no higher metric, the trie keeps the lowest metric and,
+// among equal ones, the route added last.  Multicast and link-local
+// destinations, lookups restricted to an output device, routes over a down
+// interface and trie misses go to Ipv6StaticRouting, so the answers are
+// the ones of the route list walk.
+//
+// Ipv6StaticRouting keeps its routes in a std::list that GetRoute (i)
+// walks from the start, so this class keeps its own copy of the list.  The
+// Add and Remove methods of Ipv6StaticRouting are not virtual: the ones
+// here hide them and also update the copy, and an added route goes
+// straight into the trie.  Routes changed through a Ptr<Ipv6StaticRouting>,
+// and the on-link routes that interface and address notifications add,
+// are noticed by the route count and re-read with GetRoute (), which costs
+// O(routes^2); code that replaces a route that way (a RemoveRoute ()
+// followed by an Add between two lookups) calls Invalidate ().
+//
+// Ipv6TrieStaticRoutingHelper creates it where Ipv6StaticRoutingHelper
+// would; Ipv6StaticRoutingHelper::GetStaticRouting () finds it too.
+//
+
+#ifndef IPV6_TRIE_ROUTING_H
+#define IPV6_TRIE_ROUTING_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv6-static-routing.h"
+#include "ns3/ipv6-static-routing-helper.h"
+#include "ipv6-prefix-trie.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+class Ipv6TrieStaticRouting : public Ipv6StaticRouting
+{
+public:
+  static TypeId GetTypeId (void);
+
+  Ipv6TrieStaticRouting ();
+
+  // The Ipv6StaticRouting methods that change the route list, hidden to
+  // keep the copy and the trie up to date
+  void AddHostRouteTo (Ipv6Address dest, Ipv6Address nextHop, uint32_t interface,
+                       Ipv6Address prefixToUse = Ipv6Address ("::"), uint32_t metric = 0);
+  void AddHostRouteTo (Ipv6Address dest, uint32_t interface, uint32_t metric = 0);
+  void AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, Ipv6Address nextHop,
+                          uint32_t interface, uint32_t metric = 0);
+  void AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, Ipv6Address nextHop,
+                          uint32_t interface, Ipv6Address prefixToUse, uint32_t metric = 0);
+  void AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, uint32_t interface,
+                          uint32_t metric = 0);
+  void SetDefaultRoute (Ipv6Address nextHop, uint32_t interface,
+                        Ipv6Address prefixToUse = Ipv6Address ("::"), uint32_t metric = 0);
+  void RemoveRoute (uint32_t i);
+  void RemoveRoute (Ipv6Address network, Ipv6Prefix prefix, uint32_t ifIndex, Ipv6Address prefixToUse);
+
+  virtual Ptr<Ipv6Route> RouteOutput (Ptr<Packet> p, const Ipv6Header &header, Ptr<NetDevice> oif,
+                                      Socket::SocketErrno &sockerr);
+  virtual bool RouteInput (Ptr<const Packet> p, const Ipv6Header &header, Ptr<const NetDevice> idev,
+                           UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                           LocalDeliverCallback lcb, ErrorCallback ecb);
+
+  virtual void NotifyInterfaceUp (uint32_t interface);
+  virtual void NotifyInterfaceDown (uint32_t interface);
+  virtual void NotifyAddAddress (uint32_t interface, Ipv6InterfaceAddress address);
+  virtual void NotifyRemoveAddress (uint32_t interface, Ipv6InterfaceAddress address);
+  virtual void SetIpv6 (Ptr<Ipv6> ipv6);
+
+  /// Re-read the route list and rebuild the trie before the next lookup.
+  void Invalidate (void);
+
+  /// \return lookups answered by the trie
+  uint64_t GetTrieLookups (void) const;
+
+  /// \return lookups passed to Ipv6StaticRouting
+  uint64_t GetFallbacks (void) const;
+
+  /// \return times the trie was rebuilt
+  uint32_t GetRebuilds (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct Route
+  {
+    Route () : metric (0) {}
+    Ipv6RoutingTableEntry entry;
+    uint32_t metric;
+  };
+
+  typedef std::pair<Ipv6Address, uint8_t> Prefix;
+
+  /// \return the route toward dst from the trie, or 0
+  Ptr<Ipv6Route> Lookup (Ipv6Address dst);
+  /// Copy the route list if it changed behind this class
+  void Sync (void);
+  /// Record the route an Add method of Ipv6StaticRouting just appended
+  void Added (const Ipv6RoutingTableEntry &entry, uint32_t metric);
+  void Index (void);
+  void Insert (const Route &route);
+  static Prefix PrefixOf (const Ipv6RoutingTableEntry &entry);
+
+  Ptr<Ipv6> m_ipv6;
+  std::vector<Route> m_routes; // copy of the route list, in its order
+  bool m_synced;
+  Ipv6PrefixTrie<Route> m_trie;
+  std::map<Prefix, uint32_t> m_metrics; // metric of the route in the trie
+  bool m_valid;
+  uint64_t m_trieLookups;
+  uint64_t m_fallbacks;
+  uint32_t m_rebuilds;
+};
+
+class Ipv6TrieStaticRoutingHelper : public Ipv6StaticRoutingHelper
+{
+public:
+  virtual Ipv6TrieStaticRoutingHelper *Copy (void) const
+  {
+    return new Ipv6TrieStaticRoutingHelper (*this);
+  }
+
+  virtual Ptr<Ipv6RoutingProtocol> Create (Ptr<Node> node) const
+  {
+    return CreateObject<Ipv6TrieStaticRouting> ();
+  }
+};
+
+NS_OBJECT_ENSURE_REGISTERED (Ipv6TrieStaticRouting);
+
+TypeId
+Ipv6TrieStaticRouting::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::Ipv6TrieStaticRouting")
+    .SetParent<Ipv6StaticRouting> ()
+    .AddConstructor<Ipv6TrieStaticRouting> ()
+  ;
+  return tid;
+}
+
+Ipv6TrieStaticRouting::Ipv6TrieStaticRouting ()
+  : m_synced (false),
+    m_valid (false),
+    m_trieLookups (0),
+    m_fallbacks (0),
+    m_rebuilds (0)
+{
+}
+
+void
+Ipv6TrieStaticRouting::DoDispose (void)
+{
+  m_ipv6 = 0;
+  m_routes.clear ();
+  m_trie.Clear ();
+  m_metrics.clear ();
+  Ipv6StaticRouting::DoDispose ();
+}
+
+void
+Ipv6TrieStaticRouting::SetIpv6 (Ptr<Ipv6> ipv6)
+{
+  m_ipv6 = ipv6;
+  Ipv6StaticRouting::SetIpv6 (ipv6);
+  m_synced = false;
+}
+
+void
+Ipv6TrieStaticRouting::NotifyInterfaceUp (uint32_t interface)
+{
+  Ipv6StaticRouting::NotifyInterfaceUp (interface);
+  m_synced = false;
+}
+
+void
+Ipv6TrieStaticRouting::NotifyInterfaceDown (uint32_t interface)
+{
+  Ipv6StaticRouting::NotifyInterfaceDown (interface);
+  m_synced = false;
+}
+
+void
+Ipv6TrieStaticRouting::NotifyAddAddress (uint32_t interface, Ipv6InterfaceAddress address)
+{
+  Ipv6StaticRouting::NotifyAddAddress (interface, address);
+  m_synced = false;
+}
+
+void
+Ipv6TrieStaticRouting::NotifyRemoveAddress (uint32_t interface, Ipv6InterfaceAddress address)
+{
+  Ipv6StaticRouting::NotifyRemoveAddress (interface, address);
+  m_synced = false;
+}
+
+void
+Ipv6TrieStaticRouting::Invalidate (void)
+{
+  m_synced = false;
+}
+
+uint64_t
+Ipv6TrieStaticRouting::GetTrieLookups (void) const
+{
+  return m_trieLookups;
+}
+
+uint64_t
+Ipv6TrieStaticRouting::GetFallbacks (void) const
+{
+  return m_fallbacks;
+}
+
+uint32_t
+Ipv6TrieStaticRouting::GetRebuilds (void) const
+{
+  return m_rebuilds;
+}
+
+void
+Ipv6TrieStaticRouting::AddHostRouteTo (Ipv6Address dest, Ipv6Address nextHop, uint32_t interface,
+                                       Ipv6Address prefixToUse, uint32_t metric)
+{
+  Sync ();
+  Ipv6StaticRouting::AddHostRouteTo (dest, nextHop, interface, prefixToUse, metric);
+  Added (Ipv6RoutingTableEntry::CreateNetworkRouteTo (dest, Ipv6Prefix::GetOnes (), nextHop, interface, prefixToUse),
+         metric);
+}
+
+void
+Ipv6TrieStaticRouting::AddHostRouteTo (Ipv6Address dest, uint32_t interface, uint32_t metric)
+{
+  Sync ();
+  Ipv6StaticRouting::AddHostRouteTo (dest, interface, metric);
+  Added (Ipv6RoutingTableEntry::CreateNetworkRouteTo (dest, Ipv6Prefix::GetOnes (), interface), metric);
+}
+
+void
+Ipv6TrieStaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, Ipv6Address nextHop,
+                                          uint32_t interface, uint32_t metric)
+{
+  Sync ();
+  Ipv6StaticRouting::AddNetworkRouteTo (network, networkPrefix, nextHop, interface, metric);
+  Added (Ipv6RoutingTableEntry::CreateNetworkRouteTo (network, networkPrefix, nextHop, interface), metric);
+}
+
+void
+Ipv6TrieStaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, Ipv6Address nextHop,
+                                          uint32_t interface, Ipv6Address prefixToUse, uint32_t metric)
+{
+  Sync ();
+  Ipv6StaticRouting::AddNetworkRouteTo (network, networkPrefix, nextHop, interface, prefixToUse, metric);
+  Added (Ipv6RoutingTableEntry::CreateNetworkRouteTo (network, networkPrefix, nextHop, interface, prefixToUse),
+         metric);
+}
+
+void
+Ipv6TrieStaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, uint32_t interface,
+                                          uint32_t metric)
+{
+  Sync ();
+  Ipv6StaticRouting::AddNetworkRouteTo (network, networkPrefix, interface, metric);
+  Added (Ipv6RoutingTableEntry::CreateNetworkRouteTo (network, networkPrefix, interface), metric);
+}
+
+void
+Ipv6TrieStaticRouting::SetDefaultRoute (Ipv6Address nextHop, uint32_t interface,
+                                        Ipv6Address prefixToUse, uint32_t metric)
+{
+  Sync ();
+  Ipv6StaticRouting::SetDefaultRoute (nextHop, interface, prefixToUse, metric);
+  Added (Ipv6RoutingTableEntry::CreateNetworkRouteTo (Ipv6Address ("::"), Ipv6Prefix::GetZero (), nextHop,
+                                                      interface, prefixToUse),
+         metric);
+}
+
+void
+Ipv6TrieStaticRouting::RemoveRoute (uint32_t i)
+{
+  Sync ();
+  Ipv6StaticRouting::RemoveRoute (i);
+  if (i < m_routes.size ())
+    {
+      m_routes.erase (m_routes.begin () + i);
+      m_valid = false;
+    }
+}
+
+void
+Ipv6TrieStaticRouting::RemoveRoute (Ipv6Address network, Ipv6Prefix prefix, uint32_t ifIndex, Ipv6Address prefixToUse)
+{
+  Ipv6StaticRouting::RemoveRoute (network, prefix, ifIndex, prefixToUse);
+  m_synced = false;
+}
+
+Ipv6TrieStaticRouting::Prefix
+Ipv6TrieStaticRouting::PrefixOf (const Ipv6RoutingTableEntry &entry)
+{
+  if (entry.IsHost ())
+    {
+      return Prefix (entry.GetDest (), 128);
+    }
+  return Prefix (entry.GetDestNetwork (), entry.GetDestNetworkPrefix ().GetPrefixLength ());
+}
+
+void
+Ipv6TrieStaticRouting::Sync (void)
+{
+  if (m_synced && GetNRoutes () == m_routes.size ())
+    {
+      return;
+    }
+  uint32_t n = GetNRoutes ();
+  m_routes.resize (n);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      m_routes[i].entry = GetRoute (i);
+      m_routes[i].metric = GetMetric (i);
+    }
+  m_synced = true;
+  m_valid = false;
+}
+
+void
+Ipv6TrieStaticRouting::Added (const Ipv6RoutingTableEntry &entry, uint32_t metric)
+{
+  if (GetNRoutes () == m_routes.size ())
+    {
+      return; // Ipv6StaticRouting already had it
+    }
+  if (GetNRoutes () != m_routes.size () + 1)
+    {
+      m_synced = false;
+      return;
+    }
+  Route route;
+  route.entry = entry;
+  route.metric = metric;
+  m_routes.push_back (route);
+  if (m_valid)
+    {
+      Insert (route);
+    }
+}
+
+void
+Ipv6TrieStaticRouting::Insert (const Route &route)
+{
+  // A later route replaces one of the same prefix unless its metric is
+  // higher, as in LookupStatic
+  Prefix prefix = PrefixOf (route.entry);
+  std::map<Prefix, uint32_t>::iterator known = m_metrics.find (prefix);
+  if (known != m_metrics.end () && route.metric > known->second)
+    {
+      return;
+    }
+  m_metrics[prefix] = route.metric;
+  m_trie.Insert (prefix.first, prefix.second, route);
+}
+
+void
+Ipv6TrieStaticRouting::Index (void)
+{
+  m_trie.Clear ();
+  m_metrics.clear ();
+  for (std::vector<Route>::const_iterator r = m_routes.begin (); r != m_routes.end (); r++)
+    {
+      Insert (*r);
+    }
+  m_valid = true;
+  m_rebuilds++;
+}
+
+Ptr<Ipv6Route>
+Ipv6TrieStaticRouting::Lookup (Ipv6Address dst)
+{
+  Sync ();
+  if (!m_valid)
+    {
+      Index ();
+    }
+  Route found;
+  if (!m_trie.Lookup (dst, found))
+    {
+      return 0;
+    }
+  const Ipv6RoutingTableEntry &entry = found.entry;
+  uint32_t interface = entry.GetInterface ();
+  if (!m_ipv6->IsUp (interface))
+    {
+      return 0;
+    }
+
+  // Same source selection as Ipv6StaticRouting::LookupStatic ()
+  Ptr<Ipv6Route> route = Create<Ipv6Route> ();
+  if (!entry.GetGateway ().IsAny () && entry.GetDest ().IsAny ())
+    {
+      // Default route
+      route->SetSource (m_ipv6->SourceAddressSelection (interface, entry.GetPrefixToUse ().IsAny () ? dst : entry.GetPrefixToUse ()));
+    }
+  else
+    {
+      route->SetSource (m_ipv6->SourceAddressSelection (interface, entry.GetDest ()));
+    }
+  route->SetDestination (entry.GetDest ());
+  route->SetGateway (entry.GetGateway ());
+  route->SetOutputDevice (m_ipv6->GetNetDevice (interface));
+  return route;
+}
+
+Ptr<Ipv6Route>
+Ipv6TrieStaticRouting::RouteOutput (Ptr<Packet> p, const Ipv6Header &header, Ptr<NetDevice> oif,
+                                    Socket::SocketErrno &sockerr)
+{
+  Ipv6Address dst = header.GetDestinationAddress ();
+  if (oif == 0 && !dst.IsMulticast () && !dst.IsLinkLocal ())
+    {
+      Ptr<Ipv6Route> route = Lookup (dst);
+      if (route != 0)
+        {
+          m_trieLookups++;
+          sockerr = Socket::ERROR_NOTERROR;
+          return route;
+        }
+    }
+  m_fallbacks++;
+  return Ipv6StaticRouting::RouteOutput (p, header, oif, sockerr);
+}
+
+bool
+Ipv6TrieStaticRouting::RouteInput (Ptr<const Packet> p, const Ipv6Header &header, Ptr<const NetDevice> idev,
+                                   UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                                   LocalDeliverCallback lcb, ErrorCallback ecb)
+{
+  Ipv6Address dst = header.GetDestinationAddress ();
+  if (!dst.IsMulticast () && !dst.IsLinkLocal ()
+      && m_ipv6->IsForwarding (m_ipv6->GetInterfaceForDevice (idev)))
+    {
+      Ptr<Ipv6Route> route = Lookup (dst);
+      if (route != 0)
+        {
+          m_trieLookups++;
+          ucb (idev, route, p, header);
+          return true;
+        }
+    }
+  m_fallbacks++;
+  return Ipv6StaticRouting::RouteInput (p, header, idev, ucb, mcb, lcb, ecb);
+}
+
+} // namespace ns3
+
+#endif /* IPV6_TRIE_ROUTING_H */
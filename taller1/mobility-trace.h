@@ -0,0 +1,319 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Binary mobility traces: record the trajectories of a run, replay them in
+// later runs.
+//
+// MobilityTraceRecorder follows the CourseChange trace of every node and
+// writes one waypoint per change: time, node, position and velocity.
+// Between two waypoints a node moves in a straight line at the recorded
+// velocity, which is exactly what RandomWaypoint, RandomWalk2d and the
+// other piecewise-linear models do, so the waypoints are the whole
+// trajectory.  SegmentWaypointMobilityModel draws a walk and the pause
+// after it in one course change; its segment is written as two waypoints,
+// start of the walk and arrival.  Close (), after Simulator::Run (), brings
+// every model up to the stop time and writes where each node stands then,
+// so the trace covers the whole run.
+//
+// MobilityTraceReplay loads a file and gives every node a
+// TraceReplayMobilityModel with its waypoints.  Replay uses no random
+// variables and schedules no events: a position query finds the waypoint
+// in force (the cursor only moves forward as time does) and extrapolates
+// from it.  Runs that replay the same file see the same mobility whatever
+// their seed or configuration, and do not pay for drawing it.
+//
+// File layout, native byte order:
+//
+//   "MTR1", uint32 0x01020304 (byte order check)
+//   records of 60 bytes: int64 time (ns), uint32 node,
+//                        double x, y, z, vx, vy, vz
+//
+
+#ifndef MOBILITY_TRACE_H
+#define MOBILITY_TRACE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "segment-waypoint-mobility.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/// A point of a recorded trajectory: from time on, move at velocity.
+struct MobilityWaypoint
+{
+  Time time;
+  Vector position;
+  Vector velocity;
+};
+
+class TraceReplayMobilityModel : public MobilityModel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  TraceReplayMobilityModel ();
+
+  /// \param waypoints trajectory of the node, in time order
+  void SetWaypoints (const std::vector<MobilityWaypoint> &waypoints);
+
+private:
+  virtual Vector DoGetPosition (void) const;
+  virtual void DoSetPosition (const Vector &position);
+  virtual Vector DoGetVelocity (void) const;
+
+  /// \return the last waypoint at or before now
+  const MobilityWaypoint &Current (void) const;
+
+  std::vector<MobilityWaypoint> m_waypoints;
+  mutable size_t m_cursor;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (TraceReplayMobilityModel);
+
+TypeId
+TraceReplayMobilityModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TraceReplayMobilityModel")
+    .SetParent<MobilityModel> ()
+    .AddConstructor<TraceReplayMobilityModel> ()
+  ;
+  return tid;
+}
+
+TraceReplayMobilityModel::TraceReplayMobilityModel ()
+  : m_cursor (0)
+{
+  MobilityWaypoint origin;
+  origin.time = Seconds (0);
+  m_waypoints.push_back (origin);
+}
+
+void
+TraceReplayMobilityModel::SetWaypoints (const std::vector<MobilityWaypoint> &waypoints)
+{
+  NS_ABORT_MSG_IF (waypoints.empty (), "a replayed trajectory needs at least one waypoint");
+  m_waypoints = waypoints;
+  m_cursor = 0;
+  NotifyCourseChange ();
+}
+
+const MobilityWaypoint &
+TraceReplayMobilityModel::Current (void) const
+{
+  Time now = Simulator::Now ();
+  if (now < m_waypoints[m_cursor].time)
+    {
+      m_cursor = 0;
+    }
+  while (m_cursor + 1 < m_waypoints.size () && m_waypoints[m_cursor + 1].time <= now)
+    {
+      m_cursor++;
+    }
+  return m_waypoints[m_cursor];
+}
+
+Vector
+TraceReplayMobilityModel::DoGetPosition (void) const
+{
+  const MobilityWaypoint &w = Current ();
+  double dt = std::max (0.0, (Simulator::Now () - w.time).GetSeconds ());
+  return Vector (w.position.x + w.velocity.x * dt,
+                 w.position.y + w.velocity.y * dt,
+                 w.position.z + w.velocity.z * dt);
+}
+
+void
+TraceReplayMobilityModel::DoSetPosition (const Vector &position)
+{
+  // Stay there: the rest of the trajectory is dropped
+  MobilityWaypoint w;
+  w.time = Simulator::Now ();
+  w.position = position;
+  Current ();
+  m_waypoints.erase (m_waypoints.begin () + m_cursor + 1, m_waypoints.end ());
+  m_waypoints.push_back (w);
+  m_cursor = m_waypoints.size () - 1;
+  NotifyCourseChange ();
+}
+
+Vector
+TraceReplayMobilityModel::DoGetVelocity (void) const
+{
+  return Current ().velocity;
+}
+
+class MobilityTraceRecorder
+{
+public:
+  /// \param filename binary trace to write
+  MobilityTraceRecorder (std::string filename)
+    : m_out (filename.c_str (), std::ios::out | std::ios::binary),
+      m_records (0)
+  {
+    NS_ABORT_MSG_IF (!m_out, "cannot write " << filename);
+    uint32_t order = 0x01020304;
+    m_out.write ("MTR1", 4);
+    m_out.write (reinterpret_cast<const char *> (&order), sizeof (order));
+  }
+
+  /**
+   * \brief Record the trajectories of nodes.
+   *
+   * Writes their current position and velocity, then every course change.
+   * \param nodes nodes with a MobilityModel installed
+   */
+  void Install (NodeContainer nodes)
+  {
+    for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); i++)
+      {
+        Ptr<MobilityModel> model = (*i)->GetObject<MobilityModel> ();
+        NS_ABORT_MSG_IF (model == 0, "node " << (*i)->GetId () << " has no mobility model");
+        Write (Simulator::Now (), (*i)->GetId (), model->GetPosition (), model->GetVelocity ());
+        m_models.push_back (std::make_pair ((*i)->GetId (), model));
+        model->TraceConnectWithoutContext ("CourseChange",
+                                           MakeBoundCallback (&MobilityTraceRecorder::CourseChange, this, (*i)->GetId ()));
+      }
+  }
+
+  /**
+   * \brief Finish the trace at the current time.
+   *
+   * Call after Simulator::Run () and before Simulator::Destroy (): the
+   * position query advances models evaluated on demand to the stop time,
+   * and a last waypoint per node marks the end of the recording.
+   */
+  void Close (void)
+  {
+    for (std::vector<std::pair<uint32_t, Ptr<MobilityModel> > >::const_iterator i = m_models.begin ();
+         i != m_models.end (); i++)
+      {
+        Vector position = i->second->GetPosition ();
+        Write (Simulator::Now (), i->first, position, i->second->GetVelocity ());
+      }
+    m_models.clear ();
+    m_out.close ();
+  }
+
+  /// \return waypoints written so far
+  uint64_t GetNRecords (void) const
+  {
+    return m_records;
+  }
+
+private:
+  static void CourseChange (MobilityTraceRecorder *recorder, uint32_t node, Ptr<const MobilityModel> model)
+  {
+    Ptr<const SegmentWaypointMobilityModel> segment = DynamicCast<const SegmentWaypointMobilityModel> (model);
+    if (segment == 0)
+      {
+        recorder->Write (Simulator::Now (), node, model->GetPosition (), model->GetVelocity ());
+        return;
+      }
+    // The segment drawn, at the time it starts
+    const SegmentTable &t = SegmentTable::Get ();
+    uint32_t i = segment->GetIndex ();
+    double walk = t.arrival[i] - t.t0[i];
+    recorder->Write (Seconds (t.t0[i]), node, Vector (t.x0[i], t.y0[i], t.z0[i]), Vector (t.vx[i], t.vy[i], t.vz[i]));
+    recorder->Write (Seconds (t.arrival[i]), node,
+                     Vector (t.x0[i] + t.vx[i] * walk, t.y0[i] + t.vy[i] * walk, t.z0[i] + t.vz[i] * walk),
+                     Vector (0, 0, 0));
+  }
+
+  void Write (Time time, uint32_t node, const Vector &position, const Vector &velocity)
+  {
+    int64_t ns = time.GetNanoSeconds ();
+    double values[6] = { position.x, position.y, position.z, velocity.x, velocity.y, velocity.z };
+    m_out.write (reinterpret_cast<const char *> (&ns), sizeof (ns));
+    m_out.write (reinterpret_cast<const char *> (&node), sizeof (node));
+    m_out.write (reinterpret_cast<const char *> (values), sizeof (values));
+    m_records++;
+  }
+
+  std::ofstream m_out;
+  uint64_t m_records;
+  std::vector<std::pair<uint32_t, Ptr<MobilityModel> > > m_models; // node id, model
+};
+
+class MobilityTraceReplay
+{
+public:
+  /// Record size in the file
+  static const size_t RECORD_SIZE = 8 + 4 + 6 * 8;
+
+  /// \param filename binary trace written by MobilityTraceRecorder
+  MobilityTraceReplay (std::string filename)
+  {
+    std::ifstream in (filename.c_str (), std::ios::in | std::ios::binary);
+    NS_ABORT_MSG_IF (!in, "cannot read " << filename);
+    std::vector<char> data ((std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+    uint32_t order = 0;
+    if (data.size () >= 8)
+      {
+        std::memcpy (&order, &data[4], sizeof (order));
+      }
+    NS_ABORT_MSG_IF (data.size () < 8 || std::memcmp (&data[0], "MTR1", 4) != 0, filename << " is not a mobility trace");
+    NS_ABORT_MSG_IF (order != 0x01020304, filename << " was written with another byte order");
+    NS_ABORT_MSG_IF ((data.size () - 8) % RECORD_SIZE != 0, filename << " is truncated");
+    for (size_t offset = 8; offset < data.size (); offset += RECORD_SIZE)
+      {
+        int64_t ns;
+        uint32_t node;
+        double values[6];
+        std::memcpy (&ns, &data[offset], sizeof (ns));
+        std::memcpy (&node, &data[offset + 8], sizeof (node));
+        std::memcpy (values, &data[offset + 12], sizeof (values));
+        MobilityWaypoint w;
+        w.time = NanoSeconds (ns);
+        w.position = Vector (values[0], values[1], values[2]);
+        w.velocity = Vector (values[3], values[4], values[5]);
+        m_nodes[node].push_back (w);
+      }
+    for (std::map<uint32_t, std::vector<MobilityWaypoint> >::iterator n = m_nodes.begin (); n != m_nodes.end (); n++)
+      {
+        std::stable_sort (n->second.begin (), n->second.end (), Earlier);
+      }
+  }
+
+  /// \return number of nodes in the trace
+  uint32_t GetNNodes (void) const
+  {
+    return m_nodes.size ();
+  }
+
+  /**
+   * \brief Give nodes their recorded trajectories.
+   * \param nodes nodes without a mobility model, recorded under the same ids
+   */
+  void Install (NodeContainer nodes) const
+  {
+    for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); i++)
+      {
+        std::map<uint32_t, std::vector<MobilityWaypoint> >::const_iterator n = m_nodes.find ((*i)->GetId ());
+        NS_ABORT_MSG_IF (n == m_nodes.end (), "node " << (*i)->GetId () << " is not in the mobility trace");
+        Ptr<TraceReplayMobilityModel> model = CreateObject<TraceReplayMobilityModel> ();
+        model->SetWaypoints (n->second);
+        (*i)->AggregateObject (model);
+      }
+  }
+
+private:
+  static bool Earlier (const MobilityWaypoint &a, const MobilityWaypoint &b)
+  {
+    return a.time < b.time;
+  }
+
+  std::map<uint32_t, std::vector<MobilityWaypoint> > m_nodes; // by node id
+};
+
+} // namespace ns3
+
+#endif /* MOBILITY_TRACE_H */
@@ -0,0 +1,96 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// A set of orthogonal Wi-Fi channels for scenarios with several radios per
+// node or several BSSs.
+//
+// Every channel is its own YansWifiChannel built from the same helper (same
+// propagation models), so a transmission is only delivered to, and only
+// collides with, the PHYs attached to that channel: each channel is a
+// separate collision domain, and the per-transmission fan-out shrinks with
+// the number of PHYs per channel.  The PHYs attached to channel i are also
+// tuned to the i-th non-overlapping 2.4 GHz channel number (1, 6, 11), so
+// that frequency-dependent loss models and pcap headers agree; 5 GHz
+// standards keep their default channel number.
+//
+//   MultiChannel channels (wifiChannel, 2);
+//   channels.Attach (wifiPhy, 1);                 // before wifi.Install ()
+//   channels.Tune (devices, 1, WIFI_PHY_STANDARD_80211b); // after it
+//
+
+#ifndef MULTI_CHANNEL_H
+#define MULTI_CHANNEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include "attribute-handle.h"
+
+#include <vector>
+
+namespace ns3 {
+
+class MultiChannel
+{
+public:
+  /// Non-overlapping 2.4 GHz channels
+  static const uint32_t MAX_CHANNELS = 3;
+
+  /**
+   * \param helper channel helper with the propagation models configured
+   * \param n number of channels, 1 to MAX_CHANNELS
+   */
+  MultiChannel (YansWifiChannelHelper &helper, uint32_t n)
+  {
+    NS_ABORT_MSG_IF (n < 1 || n > MAX_CHANNELS, "between 1 and " << MAX_CHANNELS << " channels");
+    for (uint32_t i = 0; i < n; i++)
+      {
+        m_channels.push_back (helper.Create ());
+      }
+  }
+
+  /// \return number of channels
+  uint32_t GetN (void) const
+  {
+    return m_channels.size ();
+  }
+
+  /// \return channel i
+  Ptr<YansWifiChannel> Get (uint32_t i) const
+  {
+    return m_channels[i % m_channels.size ()];
+  }
+
+  /// Make the PHYs installed next with the helper use channel i.
+  void Attach (YansWifiPhyHelper &phy, uint32_t i) const
+  {
+    phy.SetChannel (Get (i));
+  }
+
+  /**
+   * \brief Set the channel number of installed PHYs attached to channel i.
+   *
+   * Done after installation because WifiHelper::Install () configures the
+   * standard's default channel afterwards.
+   */
+  void Tune (NetDeviceContainer devices, uint32_t i, WifiPhyStandard standard) const
+  {
+    static const uint16_t numbers[MAX_CHANNELS] = { 1, 6, 11 };
+    if (standard != WIFI_PHY_STANDARD_80211b && standard != WIFI_PHY_STANDARD_80211g
+        && standard != WIFI_PHY_STANDARD_80211n_2_4GHZ)
+      {
+        return;
+      }
+    AttributeHandle<UintegerValue> number (WifiPhy::GetTypeId (), "ChannelNumber");
+    for (NetDeviceContainer::Iterator d = devices.Begin (); d != devices.End (); d++)
+      {
+        number.Set (DynamicCast<WifiNetDevice> (*d)->GetPhy (), UintegerValue (numbers[i % m_channels.size ()]));
+      }
+  }
+
+private:
+  std::vector<Ptr<YansWifiChannel> > m_channels;
+};
+
+} // namespace ns3
+
+#endif /* MULTI_CHANNEL_H */
@@ -0,0 +1,338 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// IPv6 neighbor discovery shortcuts for large ad hoc scenarios.
+//
+// Ipv6AddressHelper::Assign () adds every address with Duplicate Address
+// Detection, so each interface multicasts a Neighbor Solicitation per
+// address on the shared channel, and the first packet to every neighbor
+// waits for an NS/NA exchange.  Addresses handed out by the helper are
+// unique by construction, so both are avoidable:
+//
+//  - DisableDad () turns DAD off (Icmpv6L4Protocol::DAD) for stacks
+//    installed afterwards;
+//  - Add () puts interfaces on a named segment (the set of interfaces that
+//    share a channel) and writes every address of every interface of the
+//    segment into the neighbor cache of every other one, as REACHABLE.
+//    Entries added this way have no reachable timer running, so they never
+//    age to STALE and never trigger unicast probes.
+//
+// Segments grow incrementally: interfaces added later are written into
+// the caches of the existing members and learn all of them, and Update ()
+// picks up addresses assigned to members after they joined.  Watch () adds
+// a routing protocol that routes nothing to the list routing of the nodes
+// installed afterwards; Ipv6L3Protocol::AddAddress () notifies it of every
+// new address and it calls Update ().  With mobile
+// nodes any member may become a neighbor, so the whole segment is loaded
+// rather than the current radio neighborhood; NDP then stays off the data
+// path whatever routes OLSR6 picks.
+//
+// CountNdp () follows the MacTx trace of every Wi-Fi device and counts the
+// NS/NA/RS/RA messages handed to the MAC.  That is below every NDP sender:
+// Ipv6L3Protocol's Tx trace misses the DAD solicitations and the
+// advertisements answering NS, which Icmpv6L4Protocol sends through
+// Ipv6Interface::Send () directly.  The frames avoided are the difference
+// with a run without the shortcuts.
+//
+
+#ifndef NDISC_PRELOADER_H
+#define NDISC_PRELOADER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/llc-snap-header.h"
+#include "ns3/ipv6-l3-protocol.h"
+#include "ns3/ipv6-interface.h"
+#include "ns3/ndisc-cache.h"
+#include "ns3/icmpv6-header.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Lowest priority entry of an Ipv6ListRouting that only passes address
+ * additions on to a callback.
+ */
+class NdiscAddressWatcher : public Ipv6RoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::NdiscAddressWatcher")
+      .SetParent<Ipv6RoutingProtocol> ()
+    ;
+    return tid;
+  }
+
+  void SetCallback (Callback<void> added)
+  {
+    m_added = added;
+  }
+
+  virtual Ptr<Ipv6Route> RouteOutput (Ptr<Packet> p, const Ipv6Header &header, Ptr<NetDevice> oif,
+                                      Socket::SocketErrno &sockerr)
+  {
+    sockerr = Socket::ERROR_NOROUTETOHOST;
+    return 0;
+  }
+  virtual bool RouteInput (Ptr<const Packet> p, const Ipv6Header &header, Ptr<const NetDevice> idev,
+                           UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                           LocalDeliverCallback lcb, ErrorCallback ecb)
+  {
+    return false;
+  }
+  virtual void NotifyInterfaceUp (uint32_t interface)
+  {
+  }
+  virtual void NotifyInterfaceDown (uint32_t interface)
+  {
+  }
+  virtual void NotifyAddAddress (uint32_t interface, Ipv6InterfaceAddress address)
+  {
+    if (!m_added.IsNull ())
+      {
+        m_added ();
+      }
+  }
+  virtual void NotifyRemoveAddress (uint32_t interface, Ipv6InterfaceAddress address)
+  {
+  }
+  virtual void NotifyAddRoute (Ipv6Address dst, Ipv6Prefix mask, Ipv6Address nextHop, uint32_t interface,
+                               Ipv6Address prefixToUse = Ipv6Address::GetZero ())
+  {
+  }
+  virtual void NotifyRemoveRoute (Ipv6Address dst, Ipv6Prefix mask, Ipv6Address nextHop, uint32_t interface,
+                                  Ipv6Address prefixToUse = Ipv6Address::GetZero ())
+  {
+  }
+  virtual void SetIpv6 (Ptr<Ipv6> ipv6)
+  {
+  }
+  virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream) const
+  {
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_added = Callback<void> ();
+    Ipv6RoutingProtocol::DoDispose ();
+  }
+
+private:
+  Callback<void> m_added;
+};
+
+class NdiscAddressWatcherHelper : public Ipv6RoutingHelper
+{
+public:
+  NdiscAddressWatcherHelper (Callback<void> added)
+    : m_added (added)
+  {
+  }
+
+  virtual NdiscAddressWatcherHelper *Copy (void) const
+  {
+    return new NdiscAddressWatcherHelper (*this);
+  }
+
+  virtual Ptr<Ipv6RoutingProtocol> Create (Ptr<Node> node) const
+  {
+    Ptr<NdiscAddressWatcher> watcher = CreateObject<NdiscAddressWatcher> ();
+    watcher->SetCallback (m_added);
+    return watcher;
+  }
+
+private:
+  Callback<void> m_added;
+};
+
+class NdiscPreloader
+{
+public:
+  NdiscPreloader ()
+    : m_entries (0),
+      m_ns (0),
+      m_na (0),
+      m_router (0)
+  {
+  }
+
+  /// Install IPv6 stacks without Duplicate Address Detection from now on.
+  static void DisableDad (void)
+  {
+    Config::SetDefault ("ns3::Icmpv6L4Protocol::DAD", BooleanValue (false));
+  }
+
+  /**
+   * \brief Add interfaces to a segment and preload the segment's caches.
+   * \param segment name of the segment (e.g. the channel)
+   * \param interfaces interfaces attached to it
+   */
+  void Add (std::string segment, Ipv6InterfaceContainer interfaces)
+  {
+    std::vector<Member> &members = m_segments[segment];
+    size_t existing = members.size ();
+    for (Ipv6InterfaceContainer::Iterator i = interfaces.Begin (); i != interfaces.End (); i++)
+      {
+        Member m;
+        m.interface = i->first->GetObject<Ipv6L3Protocol> ()->GetInterface (i->second);
+        m.mac = m.interface->GetDevice ()->GetAddress ();
+        members.push_back (m);
+      }
+    // New members learn the old ones...
+    for (size_t to = existing; to < members.size (); to++)
+      {
+        for (size_t from = 0; from < existing; from++)
+          {
+            Load (members[to], members[from], 0);
+          }
+      }
+    // ...and every member learns the addresses not yet loaded, which
+    // covers the new members (and addresses added since the last call)
+    Update (members);
+  }
+
+  /**
+   * \brief Call Update () whenever an address is added to a node installed
+   * with this list routing from now on.
+   * \param list list routing helper of the nodes
+   */
+  void Watch (Ipv6ListRoutingHelper &list)
+  {
+    void (NdiscPreloader::*update) (void) = &NdiscPreloader::Update;
+    list.Add (NdiscAddressWatcherHelper (MakeCallback (update, this)), -100);
+  }
+
+  /// Preload addresses assigned to segment members since they were added.
+  void Update (void)
+  {
+    for (std::map<std::string, std::vector<Member> >::iterator s = m_segments.begin (); s != m_segments.end (); s++)
+      {
+        Update (s->second);
+      }
+  }
+
+  /**
+   * \brief Count neighbor discovery messages sent on Wi-Fi devices.
+   * \param devices WifiNetDevices
+   */
+  void CountNdp (NetDeviceContainer devices)
+  {
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+      {
+        Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice> (*i);
+        NS_ABORT_MSG_IF (wifi == 0, "NdiscPreloader::CountNdp () expects WifiNetDevices");
+        wifi->GetMac ()->TraceConnectWithoutContext
+          ("MacTx", MakeBoundCallback (&NdiscPreloader::MacTx, this));
+      }
+  }
+
+  /// Write the counters on one line.
+  void Report (std::ostream &os) const
+  {
+    os << "NDP preloaded_entries=" << m_entries
+       << " ns_sent=" << m_ns
+       << " na_sent=" << m_na
+       << " rs_ra_sent=" << m_router
+       << std::endl;
+  }
+
+private:
+  struct Member
+  {
+    Ptr<Ipv6Interface> interface;
+    Address mac;
+    std::vector<Ipv6Address> addresses; // already written to the segment
+  };
+
+  /// Write from's addresses, starting at index first, into to's cache.
+  void Load (Member &to, const Member &from, size_t first)
+  {
+    Ptr<NdiscCache> cache = to.interface->GetNdiscCache ();
+    for (size_t a = first; a < from.addresses.size (); a++)
+      {
+        NdiscCache::Entry *entry = cache->Lookup (from.addresses[a]);
+        if (entry == 0)
+          {
+            entry = cache->Add (from.addresses[a]);
+          }
+        entry->MarkReachable (from.mac);
+        m_entries++;
+      }
+  }
+
+  void Update (std::vector<Member> &members)
+  {
+    for (size_t from = 0; from < members.size (); from++)
+      {
+        Member &m = members[from];
+        size_t known = m.addresses.size ();
+        for (uint32_t a = known; a < m.interface->GetNAddresses (); a++)
+          {
+            m.addresses.push_back (m.interface->GetAddress (a).GetAddress ());
+          }
+        if (m.addresses.size () == known)
+          {
+            continue;
+          }
+        for (size_t to = 0; to < members.size (); to++)
+          {
+            if (to != from)
+              {
+                Load (members[to], m, known);
+              }
+          }
+      }
+  }
+
+  static void MacTx (NdiscPreloader *preloader, Ptr<const Packet> packet)
+  {
+    // WifiNetDevice::Send () puts an LLC/SNAP header before the IP packet
+    Ptr<Packet> copy = packet->Copy ();
+    LlcSnapHeader llc;
+    copy->RemoveHeader (llc);
+    if (llc.GetType () != Ipv6L3Protocol::PROT_NUMBER)
+      {
+        return;
+      }
+    Ipv6Header ip;
+    copy->RemoveHeader (ip);
+    if (ip.GetNextHeader () != Icmpv6L4Protocol::PROT_NUMBER)
+      {
+        return;
+      }
+    Icmpv6Header icmp;
+    copy->PeekHeader (icmp);
+    switch (icmp.GetType ())
+      {
+      case Icmpv6Header::ICMPV6_ND_NEIGHBOR_SOLICITATION:
+        preloader->m_ns++;
+        break;
+      case Icmpv6Header::ICMPV6_ND_NEIGHBOR_ADVERTISEMENT:
+        preloader->m_na++;
+        break;
+      case Icmpv6Header::ICMPV6_ND_ROUTER_SOLICITATION:
+      case Icmpv6Header::ICMPV6_ND_ROUTER_ADVERTISEMENT:
+        preloader->m_router++;
+        break;
+      default:
+        break;
+      }
+  }
+
+  std::map<std::string, std::vector<Member> > m_segments;
+  uint64_t m_entries;
+  uint64_t m_ns;
+  uint64_t m_na;
+  uint64_t m_router;
+};
+
+} // namespace ns3
+
+#endif /* NDISC_PRELOADER_H */
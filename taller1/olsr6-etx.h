@@ -0,0 +1,420 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Expected transmission count (ETX) routing layered over OLSR6.
+//
+// OLSR6 selects minimum-hop routes, which with Friis loss and RxGain=-10
+// prefers long, lossy hops.  The link metric cannot be changed inside the
+// olsr6 module (its sources are not part of this tree), so this class
+// measures link quality from the HELLOs each agent receives (its "Rx"
+// trace) and installs the resulting routes in an Ipv6StaticRouting that
+// sits above OLSR6 in the node's Ipv6ListRouting:
+//
+//  - d(j->i) is the fraction of the HELLOs j sent in the last Window that
+//    reached i (j sends one every HelloInterval, a copy on each olsr
+//    interface; the copies share a message sequence number, and whichever
+//    radios of i hear them, each HELLO counts once);
+//  - ETX(i,j) = 1 / (d(i->j) d(j->i)); links below MinDelivery in either
+//    direction are unusable;
+//  - every UpdateInterval shortest ETX paths are computed from every node
+//    and written as host routes for every address of the registered
+//    interface containers.  Destinations without an ETX path are left to
+//    OLSR6.
+//
+// All stations use the same PHY rate, so ETT (ETX x packet size / rate)
+// would select the same paths.  Link state is taken from every node at
+// once instead of being flooded in TC messages: route quality is that of
+// ETX with perfect topology dissemination.
+//
+
+#ifndef OLSR6_ETX_H
+#define OLSR6_ETX_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/olsr6-routing-protocol.h"
+#include "ns3/olsr6-header.h"
+#include "attribute-handle.h"
+
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+#include <vector>
+#include <unordered_map>
+
+namespace ns3 {
+
+class Olsr6Etx : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  Olsr6Etx ();
+
+  /**
+   * \brief Follow the HELLOs received by the OLSR6 agent of every node.
+   * \param nodes nodes with OLSR6 and, above it in their Ipv6ListRouting,
+   *        an Ipv6StaticRouting reserved for ETX routes
+   */
+  void Install (NodeContainer nodes);
+
+  /**
+   * \brief Route the addresses of these interfaces over ETX paths.
+   * \param interfaces one interface per node, all on the same channel
+   */
+  void AddInterfaces (Ipv6InterfaceContainer interfaces);
+
+  /**
+   * \brief Start updating routes, logging a summary of each update.
+   * \param stream output
+   */
+  void Start (Ptr<OutputStreamWrapper> stream);
+
+  /// \return ETX of the link between two nodes (infinity if unusable)
+  double GetEtx (uint32_t a, uint32_t b) const;
+
+private:
+  struct Link
+  {
+    Link () : received (0), sequence (0) {}
+    uint32_t received;              // HELLOs heard in the current update
+    uint16_t sequence;              // message sequence number of the last one
+    std::deque<uint32_t> history;   // HELLOs heard per update, last Window
+  };
+
+  struct PerNode
+  {
+    Ptr<Node> node;
+    Ptr<olsr6::RoutingProtocol> agent;
+    Ptr<Ipv6StaticRouting> routing;
+    std::map<uint32_t, Link> heard; // by sender node id
+  };
+
+  struct Iface
+  {
+    std::vector<Ipv6Address> address; // by node id
+    std::vector<int32_t> index;       // interface index by node id, -1 if none
+  };
+
+  static void Rx (Olsr6Etx *etx, uint32_t node,
+                  const olsr6::PacketHeader &header, const olsr6::MessageList &messages);
+  double GetDelivery (uint32_t from, uint32_t to) const;
+  void Update (void);
+
+  Time m_window;
+  Time m_interval;
+  double m_minDelivery;
+  AttributeHandle<TimeValue> m_helloInterval;
+
+  std::vector<PerNode> m_nodes; // indexed by node id
+  std::unordered_map<Ipv6Address, uint32_t, Ipv6AddressHash> m_owner;
+  std::vector<Iface> m_ifaces;
+  Ptr<OutputStreamWrapper> m_stream;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (Olsr6Etx);
+
+TypeId
+Olsr6Etx::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::Olsr6Etx")
+    .SetParent<Object> ()
+    .AddConstructor<Olsr6Etx> ()
+    .AddAttribute ("Window", "HELLO history used for delivery ratios.",
+                   TimeValue (Seconds (10)),
+                   MakeTimeAccessor (&Olsr6Etx::m_window),
+                   MakeTimeChecker ())
+    .AddAttribute ("UpdateInterval", "Time between route updates.",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&Olsr6Etx::m_interval),
+                   MakeTimeChecker ())
+    .AddAttribute ("MinDelivery", "Delivery ratio below which a link is unusable.",
+                   DoubleValue (0.1),
+                   MakeDoubleAccessor (&Olsr6Etx::m_minDelivery),
+                   MakeDoubleChecker<double> (0, 1))
+  ;
+  return tid;
+}
+
+Olsr6Etx::Olsr6Etx ()
+  : m_window (Seconds (10)),
+    m_interval (Seconds (1)),
+    m_minDelivery (0.1),
+    m_helloInterval (olsr6::RoutingProtocol::GetTypeId (), "HelloInterval")
+{
+}
+
+void
+Olsr6Etx::Install (NodeContainer nodes)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); i++)
+    {
+      Ptr<olsr6::RoutingProtocol> agent = (*i)->GetObject<olsr6::RoutingProtocol> ();
+      if (agent == 0)
+        {
+          continue;
+        }
+      uint32_t id = (*i)->GetId ();
+      if (id >= m_nodes.size ())
+        {
+          m_nodes.resize (id + 1);
+        }
+      PerNode &n = m_nodes[id];
+      n.node = *i;
+      n.agent = agent;
+
+      // Ipv6ListRouting keeps its protocols by decreasing priority: the
+      // first static routing must come before the OLSR6 agent
+      Ptr<Ipv6> ipv6 = (*i)->GetObject<Ipv6> ();
+      Ptr<Ipv6ListRouting> list = DynamicCast<Ipv6ListRouting> (ipv6->GetRoutingProtocol ());
+      NS_ABORT_MSG_IF (list == 0, "Olsr6Etx needs Ipv6ListRouting on node " << id);
+      for (uint32_t p = 0; p < list->GetNRoutingProtocols (); p++)
+        {
+          int16_t priority;
+          Ptr<Ipv6RoutingProtocol> proto = list->GetRoutingProtocol (p, priority);
+          if (proto == agent)
+            {
+              break;
+            }
+          if (DynamicCast<Ipv6StaticRouting> (proto) != 0)
+            {
+              n.routing = DynamicCast<Ipv6StaticRouting> (proto);
+              break;
+            }
+        }
+      NS_ABORT_MSG_IF (n.routing == 0, "Olsr6Etx needs an Ipv6StaticRouting above OLSR6 on node " << id);
+
+      for (uint32_t j = 0; j < ipv6->GetNInterfaces (); j++)
+        {
+          for (uint32_t k = 0; k < ipv6->GetNAddresses (j); k++)
+            {
+              m_owner[ipv6->GetAddress (j, k).GetAddress ()] = id;
+            }
+        }
+      agent->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&Olsr6Etx::Rx, this, id));
+    }
+}
+
+void
+Olsr6Etx::AddInterfaces (Ipv6InterfaceContainer interfaces)
+{
+  Iface iface;
+  iface.address.resize (m_nodes.size ());
+  iface.index.assign (m_nodes.size (), -1);
+  for (uint32_t i = 0; i < interfaces.GetN (); i++)
+    {
+      std::pair<Ptr<Ipv6>, uint32_t> entry = interfaces.Get (i);
+      uint32_t id = entry.first->GetObject<Node> ()->GetId ();
+      if (id < m_nodes.size ())
+        {
+          iface.address[id] = interfaces.GetAddress (i, 0);
+          iface.index[id] = entry.second;
+        }
+    }
+  m_ifaces.push_back (iface);
+}
+
+void
+Olsr6Etx::Start (Ptr<OutputStreamWrapper> stream)
+{
+  m_stream = stream;
+  *m_stream->GetStream () << "# time\tusable_links\tavg_link_etx\treachable_pairs\tavg_path_etx\tavg_path_hops\troutes"
+                          << std::endl;
+  Simulator::Schedule (m_interval, &Olsr6Etx::Update, this);
+}
+
+void
+Olsr6Etx::Rx (Olsr6Etx *etx, uint32_t node,
+              const olsr6::PacketHeader &header, const olsr6::MessageList &messages)
+{
+  for (olsr6::MessageList::const_iterator m = messages.begin (); m != messages.end (); m++)
+    {
+      if (m->GetMessageType () != olsr6::MessageHeader::HELLO_MESSAGE)
+        {
+          continue;
+        }
+      std::unordered_map<Ipv6Address, uint32_t, Ipv6AddressHash>::const_iterator o =
+        etx->m_owner.find (m->GetOriginatorAddress ());
+      if (o == etx->m_owner.end () || o->second == node)
+        {
+          continue;
+        }
+      std::map<uint32_t, Link>::iterator l = etx->m_nodes[node].heard.find (o->second);
+      if (l == etx->m_nodes[node].heard.end ())
+        {
+          l = etx->m_nodes[node].heard.insert (std::make_pair (o->second, Link ())).first;
+        }
+      else if (l->second.sequence == m->GetMessageSequenceNumber ())
+        {
+          continue; // another copy, sent or heard on another radio
+        }
+      l->second.sequence = m->GetMessageSequenceNumber ();
+      l->second.received++;
+    }
+}
+
+double
+Olsr6Etx::GetDelivery (uint32_t from, uint32_t to) const
+{
+  std::map<uint32_t, Link>::const_iterator l = m_nodes[to].heard.find (from);
+  if (l == m_nodes[to].heard.end () || l->second.history.empty ())
+    {
+      return 0;
+    }
+  uint32_t heard = 0;
+  for (std::deque<uint32_t>::const_iterator h = l->second.history.begin (); h != l->second.history.end (); h++)
+    {
+      heard += *h;
+    }
+  Time hello = m_helloInterval.Get (m_nodes[from].agent).Get ();
+  double expected = l->second.history.size () * m_interval.GetSeconds () / hello.GetSeconds ();
+  return expected > 0 ? std::min (1.0, heard / expected) : 0;
+}
+
+double
+Olsr6Etx::GetEtx (uint32_t a, uint32_t b) const
+{
+  double df = GetDelivery (a, b);
+  double dr = GetDelivery (b, a);
+  if (df < m_minDelivery || dr < m_minDelivery)
+    {
+      return std::numeric_limits<double>::infinity ();
+    }
+  return 1 / (df * dr);
+}
+
+void
+Olsr6Etx::Update (void)
+{
+  uint32_t historyLength = std::max<int64_t> (1, m_window.GetMilliSeconds () / m_interval.GetMilliSeconds ());
+  for (std::vector<PerNode>::iterator n = m_nodes.begin (); n != m_nodes.end (); n++)
+    {
+      for (std::map<uint32_t, Link>::iterator l = n->heard.begin (); l != n->heard.end (); l++)
+        {
+          l->second.history.push_back (l->second.received);
+          l->second.received = 0;
+          if (l->second.history.size () > historyLength)
+            {
+              l->second.history.pop_front ();
+            }
+        }
+    }
+
+  // Symmetric ETX adjacency
+  uint32_t n = m_nodes.size ();
+  std::vector<std::vector<std::pair<uint32_t, double> > > adjacency (n);
+  uint32_t usable = 0;
+  double linkEtx = 0;
+  for (uint32_t a = 0; a < n; a++)
+    {
+      if (m_nodes[a].agent == 0)
+        {
+          continue;
+        }
+      for (std::map<uint32_t, Link>::const_iterator l = m_nodes[a].heard.begin (); l != m_nodes[a].heard.end (); l++)
+        {
+          uint32_t b = l->first;
+          if (b <= a || m_nodes[b].agent == 0)
+            {
+              continue;
+            }
+          double e = GetEtx (a, b);
+          if (e == std::numeric_limits<double>::infinity ())
+            {
+              continue;
+            }
+          adjacency[a].push_back (std::make_pair (b, e));
+          adjacency[b].push_back (std::make_pair (a, e));
+          usable++;
+          linkEtx += e;
+        }
+    }
+
+  uint64_t reachable = 0;
+  uint64_t routes = 0;
+  double pathEtx = 0;
+  uint64_t pathHops = 0;
+  typedef std::pair<double, uint32_t> Entry;
+  for (uint32_t s = 0; s < n; s++)
+    {
+      if (m_nodes[s].routing == 0)
+        {
+          continue;
+        }
+      // Dijkstra from s, remembering the first hop of every path
+      std::vector<double> cost (n, std::numeric_limits<double>::infinity ());
+      std::vector<uint32_t> firstHop (n, s);
+      std::vector<uint32_t> hops (n, 0);
+      std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+      cost[s] = 0;
+      queue.push (Entry (0, s));
+      while (!queue.empty ())
+        {
+          Entry top = queue.top ();
+          queue.pop ();
+          uint32_t u = top.second;
+          if (top.first > cost[u])
+            {
+              continue;
+            }
+          for (std::vector<std::pair<uint32_t, double> >::const_iterator e = adjacency[u].begin ();
+               e != adjacency[u].end (); e++)
+            {
+              double c = cost[u] + e->second;
+              if (c < cost[e->first])
+                {
+                  cost[e->first] = c;
+                  firstHop[e->first] = u == s ? e->first : firstHop[u];
+                  hops[e->first] = hops[u] + 1;
+                  queue.push (Entry (c, e->first));
+                }
+            }
+        }
+
+      // The table is reserved for ETX routes: drop everything, including
+      // the on-link prefixes added when the interfaces came up, so that
+      // destinations without an ETX path fall through to OLSR6.
+      Ptr<Ipv6StaticRouting> routing = m_nodes[s].routing;
+      while (routing->GetNRoutes () > 0)
+        {
+          routing->RemoveRoute (0);
+        }
+      for (uint32_t d = 0; d < n; d++)
+        {
+          if (d == s || cost[d] == std::numeric_limits<double>::infinity ())
+            {
+              continue;
+            }
+          reachable++;
+          pathEtx += cost[d];
+          pathHops += hops[d];
+          uint32_t next = firstHop[d];
+          for (std::vector<Iface>::const_iterator f = m_ifaces.begin (); f != m_ifaces.end (); f++)
+            {
+              if (f->index[s] < 0 || f->index[next] < 0 || f->index[d] < 0)
+                {
+                  continue;
+                }
+              routing->AddHostRouteTo (f->address[d], f->address[next], f->index[s],
+                                       static_cast<uint32_t> (cost[d] * 100));
+              routes++;
+            }
+        }
+    }
+
+  *m_stream->GetStream () << Simulator::Now ().GetSeconds ()
+                          << "\t" << usable
+                          << "\t" << (usable ? linkEtx / usable : 0)
+                          << "\t" << reachable
+                          << "\t" << (reachable ? pathEtx / reachable : 0)
+                          << "\t" << (reachable ? double (pathHops) / reachable : 0)
+                          << "\t" << routes
+                          << std::endl;
+  Simulator::Schedule (m_interval, &Olsr6Etx::Update, this);
+}
+
+} // namespace ns3
+
+#endif /* OLSR6_ETX_H */
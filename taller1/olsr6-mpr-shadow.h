@@ -0,0 +1,824 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Incremental MPR selection over hash-indexed neighbor, 2-hop and topology
+// sets, run as a shadow of the OLSR6 agents.
+//
+// The olsr6 module recomputes its MPR set from scratch, walking linear
+// neighbor and 2-hop tuple containers, on every neighborhood change.  This
+// class rebuilds the same sets from the HELLO and TC messages each agent
+// receives (its "Rx" trace) and maintains an MPR set incrementally.  As in
+// RFC 3626 7.1.1 and 8.2.1, a HELLO sender is a neighbor only while some
+// entry lists one of the node's addresses with link type SYM_LINK or
+// ASYM_LINK (a sender with several radios lists each of its links), and
+// only its entries with neighbor type SYM_NEIGH or MPR_NEIGH are 2-hop
+// nodes.  Neighbors and 2-hop nodes are keyed by main address: the
+// interface addresses a HELLO lists are mapped back through the MID
+// messages received (RFC 3626 5.5), so a node with two radios is a single
+// 2-hop node.  The topology set keeps, per TC originator, the advertised
+// neighbors of its latest ANSN, hashed by address.
+//
+//  - reach[t] is the hash set of neighbors through which 2-hop node t is
+//    reachable, cover[t] the number of selected MPRs among them;
+//  - when a neighbor appears or advertises new 2-hop nodes, only 2-hop
+//    nodes left uncovered trigger a selection;
+//  - when a neighbor disappears or drops 2-hop nodes, only the 2-hop nodes
+//    it covered are repaired, greedily, by the candidate covering most
+//    uncovered nodes (RFC 3626 8.3.1 heuristic restricted to the change);
+//  - after either, the MPRs reaching a 2-hop node whose cover grew are
+//    dropped if every node they cover has another MPR (8.3.1 step 4).
+//
+// Work done (tuple visits) is counted for both the incremental path and
+// what a full recomputation would have visited.  With Verify=true a full
+// greedy recomputation also runs on every change and is compared with the
+// incremental set element by element; the coverage counters are recounted
+// from the selected MPRs and every 2-hop node must be covered.
+//
+// The agents expose no way to set their MPRs, so the sets are not fed back
+// to them.  What the shadow does give back is the number of actual
+// neighborhood changes per node (neighbors and 2-hop nodes gained or
+// lost) and of HELLOs received, which a controller can act on.
+//
+
+#ifndef OLSR6_MPR_SHADOW_H
+#define OLSR6_MPR_SHADOW_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/olsr6-routing-protocol.h"
+#include "ns3/olsr6-header.h"
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ns3 {
+
+class Olsr6MprShadow : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  Olsr6MprShadow ();
+
+  /**
+   * \brief Follow the HELLOs received by the OLSR6 agent of every node.
+   * \param nodes nodes with an olsr6::RoutingProtocol aggregated
+   */
+  void Install (NodeContainer nodes);
+
+  /**
+   * \brief Write set sizes and work counters at the end of every interval.
+   * \param interval sampling period
+   * \param stream output
+   */
+  void PrintEvery (Time interval, Ptr<OutputStreamWrapper> stream);
+
+  /// \return neighbor and 2-hop set changes seen by a node so far
+  uint64_t GetNeighborhoodChanges (uint32_t node) const;
+
+  /// \return HELLOs received by a node so far
+  uint64_t GetHellos (uint32_t node) const;
+
+private:
+  typedef std::unordered_set<Ipv6Address, Ipv6AddressHash> AddressSet;
+
+  // RFC 3626 link types (lower two bits of a link code) and neighbor
+  // types (the two bits above)
+  enum
+  {
+    ASYM_LINK = 1,
+    SYM_LINK = 2,
+    LOST_LINK = 3
+  };
+  enum
+  {
+    SYM_NEIGH = 1,
+    MPR_NEIGH = 2
+  };
+
+  /// Main address of an interface address, from a MID message
+  struct Alias
+  {
+    Ipv6Address main;
+    Time expires;
+  };
+
+  struct Neighbor
+  {
+    Time expires;
+    AddressSet twoHops;
+  };
+
+  /// Topology tuples of one TC originator
+  struct Topology
+  {
+    Time expires;
+    uint16_t ansn;
+    AddressSet destinations;
+  };
+
+  struct NodeState
+  {
+    NodeState () : initialized (false), topologyTuples (0), changes (0), hellos (0) {}
+    bool initialized;
+    AddressSet own;
+    std::unordered_map<Ipv6Address, Alias, Ipv6AddressHash> aliases; // by interface address
+    std::unordered_map<Ipv6Address, Neighbor, Ipv6AddressHash> neighbors;
+    std::unordered_map<Ipv6Address, AddressSet, Ipv6AddressHash> reach;
+    std::unordered_map<Ipv6Address, uint32_t, Ipv6AddressHash> cover;
+    AddressSet mprs;
+    AddressSet grown; // 2-hop nodes whose cover grew since the last pruning
+    std::unordered_map<Ipv6Address, Topology, Ipv6AddressHash> topology; // by originator
+    uint64_t topologyTuples;
+    uint64_t changes;
+    uint64_t hellos;
+  };
+
+  static void Rx (Olsr6MprShadow *shadow, uint32_t node,
+                  const olsr6::PacketHeader &header, const olsr6::MessageList &messages);
+  void HandleHello (uint32_t node, const olsr6::MessageHeader &msg);
+  void HandleTc (uint32_t node, const olsr6::MessageHeader &msg);
+  void HandleMid (uint32_t node, const olsr6::MessageHeader &msg);
+  Ipv6Address MainAddress (const NodeState &n, const Ipv6Address &address) const;
+  void ExpireTopology (NodeState &n);
+  void InitOwnAddresses (uint32_t node, NodeState &n);
+  void ExpireNeighbors (NodeState &n);
+  void RemoveNeighbor (NodeState &n, const Ipv6Address &neighbor);
+  void AddTwoHop (NodeState &n, const Ipv6Address &neighbor, const Ipv6Address &twoHop);
+  void RemoveTwoHop (NodeState &n, const Ipv6Address &neighbor, const Ipv6Address &twoHop);
+  void SelectMpr (NodeState &n, const Ipv6Address &mpr);
+  void UnselectMpr (NodeState &n, const Ipv6Address &mpr);
+  void Repair (NodeState &n, const AddressSet &uncovered);
+  void Prune (NodeState &n);
+  void Verify (NodeState &n);
+  void Print (Time interval, Ptr<OutputStreamWrapper> stream);
+
+  bool m_verify;
+  std::vector<NodeState> m_nodes; // indexed by node id
+  std::vector<Ptr<ns3::Node> > m_ns3Nodes;
+
+  uint64_t m_changes;
+  uint64_t m_incrementalWork;
+  uint64_t m_fullWork;
+  uint64_t m_verifications;
+  uint64_t m_coverageErrors;
+  uint64_t m_coverCountErrors;
+  uint64_t m_setDifferences;
+  int64_t m_sizeDifference;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (Olsr6MprShadow);
+
+TypeId
+Olsr6MprShadow::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::Olsr6MprShadow")
+    .SetParent<Object> ()
+    .AddConstructor<Olsr6MprShadow> ()
+    .AddAttribute ("Verify", "Cross-check every change against a full recomputation.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Olsr6MprShadow::m_verify),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+Olsr6MprShadow::Olsr6MprShadow ()
+  : m_verify (false),
+    m_changes (0),
+    m_incrementalWork (0),
+    m_fullWork (0),
+    m_verifications (0),
+    m_coverageErrors (0),
+    m_coverCountErrors (0),
+    m_setDifferences (0),
+    m_sizeDifference (0)
+{
+}
+
+void
+Olsr6MprShadow::Install (NodeContainer nodes)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); i++)
+    {
+      Ptr<olsr6::RoutingProtocol> agent = (*i)->GetObject<olsr6::RoutingProtocol> ();
+      if (agent == 0)
+        {
+          continue;
+        }
+      uint32_t id = (*i)->GetId ();
+      if (id >= m_nodes.size ())
+        {
+          m_nodes.resize (id + 1);
+          m_ns3Nodes.resize (id + 1);
+        }
+      m_ns3Nodes[id] = *i;
+      agent->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&Olsr6MprShadow::Rx, this, id));
+    }
+}
+
+uint64_t
+Olsr6MprShadow::GetNeighborhoodChanges (uint32_t node) const
+{
+  return node < m_nodes.size () ? m_nodes[node].changes : 0;
+}
+
+uint64_t
+Olsr6MprShadow::GetHellos (uint32_t node) const
+{
+  return node < m_nodes.size () ? m_nodes[node].hellos : 0;
+}
+
+void
+Olsr6MprShadow::Rx (Olsr6MprShadow *shadow, uint32_t node,
+                    const olsr6::PacketHeader &header, const olsr6::MessageList &messages)
+{
+  for (olsr6::MessageList::const_iterator m = messages.begin (); m != messages.end (); m++)
+    {
+      if (m->GetMessageType () == olsr6::MessageHeader::HELLO_MESSAGE)
+        {
+          shadow->HandleHello (node, *m);
+        }
+      else if (m->GetMessageType () == olsr6::MessageHeader::TC_MESSAGE)
+        {
+          shadow->HandleTc (node, *m);
+        }
+      else if (m->GetMessageType () == olsr6::MessageHeader::MID_MESSAGE)
+        {
+          shadow->HandleMid (node, *m);
+        }
+    }
+}
+
+void
+Olsr6MprShadow::InitOwnAddresses (uint32_t node, NodeState &n)
+{
+  Ptr<Ipv6> ipv6 = m_ns3Nodes[node]->GetObject<Ipv6> ();
+  for (uint32_t i = 0; i < ipv6->GetNInterfaces (); i++)
+    {
+      for (uint32_t j = 0; j < ipv6->GetNAddresses (i); j++)
+        {
+          n.own.insert (ipv6->GetAddress (i, j).GetAddress ());
+        }
+    }
+  n.initialized = true;
+}
+
+void
+Olsr6MprShadow::HandleHello (uint32_t node, const olsr6::MessageHeader &msg)
+{
+  NodeState &n = m_nodes[node];
+  if (!n.initialized)
+    {
+      InitOwnAddresses (node, n);
+    }
+  ExpireNeighbors (n);
+
+  Ipv6Address origin = msg.GetOriginatorAddress ();
+  const olsr6::MessageHeader::Hello &hello = msg.GetHello ();
+  // The link is symmetric if the sender hears this node on any of its
+  // radios (RFC 3626 7.1.1)
+  bool symmetric = false;
+  for (std::vector<olsr6::MessageHeader::Hello::LinkMessage>::const_iterator l = hello.linkMessages.begin ();
+       l != hello.linkMessages.end (); l++)
+    {
+      int linkType = l->linkCode & 0x03;
+      for (std::vector<Ipv6Address>::const_iterator a = l->neighborInterfaceAddresses.begin ();
+           a != l->neighborInterfaceAddresses.end (); a++)
+        {
+          if (n.own.count (*a) && (linkType == SYM_LINK || linkType == ASYM_LINK))
+            {
+              symmetric = true;
+            }
+        }
+    }
+  bool isNew = n.neighbors.find (origin) == n.neighbors.end ();
+  n.hellos++;
+  if (!symmetric)
+    {
+      if (!isNew)
+        {
+          m_changes++;
+          n.changes++;
+          RemoveNeighbor (n, origin);
+        }
+      Prune (n);
+      return;
+    }
+  Neighbor &neighbor = n.neighbors[origin];
+  // The sender's validity time follows its HELLO interval, which the
+  // adaptive controller may have stretched
+  neighbor.expires = Simulator::Now () + msg.GetVTime ();
+  if (isNew)
+    {
+      // A 2-hop node that becomes a 1-hop neighbor no longer needs cover
+      if (n.reach.find (origin) != n.reach.end ())
+        {
+          AddressSet via = n.reach[origin];
+          for (AddressSet::const_iterator v = via.begin (); v != via.end (); v++)
+            {
+              RemoveTwoHop (n, *v, origin);
+            }
+        }
+    }
+
+  AddressSet advertised;
+  for (std::vector<olsr6::MessageHeader::Hello::LinkMessage>::const_iterator l = hello.linkMessages.begin ();
+       l != hello.linkMessages.end (); l++)
+    {
+      int neighborType = (l->linkCode >> 2) & 0x03;
+      if (neighborType != SYM_NEIGH && neighborType != MPR_NEIGH)
+        {
+          continue;
+        }
+      for (std::vector<Ipv6Address>::const_iterator a = l->neighborInterfaceAddresses.begin ();
+           a != l->neighborInterfaceAddresses.end (); a++)
+        {
+          Ipv6Address main = MainAddress (n, *a);
+          if (n.own.count (*a) == 0 && n.own.count (main) == 0 && n.neighbors.count (main) == 0)
+            {
+              advertised.insert (main);
+            }
+        }
+    }
+
+  // Diff against the previous advertisement of this neighbor only
+  std::vector<Ipv6Address> gone;
+  for (AddressSet::const_iterator t = neighbor.twoHops.begin (); t != neighbor.twoHops.end (); t++)
+    {
+      m_incrementalWork++;
+      if (advertised.count (*t) == 0)
+        {
+          gone.push_back (*t);
+        }
+    }
+  for (std::vector<Ipv6Address>::const_iterator t = gone.begin (); t != gone.end (); t++)
+    {
+      RemoveTwoHop (n, origin, *t);
+    }
+  uint32_t added = 0;
+  for (AddressSet::const_iterator t = advertised.begin (); t != advertised.end (); t++)
+    {
+      m_incrementalWork++;
+      if (neighbor.twoHops.count (*t) == 0)
+        {
+          AddTwoHop (n, origin, *t);
+          added++;
+        }
+    }
+  Prune (n);
+
+  if (isNew || !gone.empty () || added > 0)
+    {
+      m_changes++;
+      n.changes++;
+    }
+  // A full recomputation visits every (neighbor, 2-hop) tuple
+  for (std::unordered_map<Ipv6Address, Neighbor, Ipv6AddressHash>::const_iterator i = n.neighbors.begin ();
+       i != n.neighbors.end (); i++)
+    {
+      m_fullWork += 1 + i->second.twoHops.size ();
+    }
+  if (m_verify)
+    {
+      Verify (n);
+    }
+}
+
+void
+Olsr6MprShadow::ExpireNeighbors (NodeState &n)
+{
+  std::vector<Ipv6Address> expired;
+  for (std::unordered_map<Ipv6Address, Neighbor, Ipv6AddressHash>::const_iterator i = n.neighbors.begin ();
+       i != n.neighbors.end (); i++)
+    {
+      if (i->second.expires < Simulator::Now ())
+        {
+          expired.push_back (i->first);
+        }
+    }
+  for (std::vector<Ipv6Address>::const_iterator i = expired.begin (); i != expired.end (); i++)
+    {
+      m_changes++;
+      n.changes++;
+      RemoveNeighbor (n, *i);
+    }
+}
+
+void
+Olsr6MprShadow::HandleTc (uint32_t node, const olsr6::MessageHeader &msg)
+{
+  NodeState &n = m_nodes[node];
+  if (!n.initialized)
+    {
+      InitOwnAddresses (node, n);
+    }
+  ExpireTopology (n);
+  Ipv6Address origin = msg.GetOriginatorAddress ();
+  if (n.own.count (origin))
+    {
+      return;
+    }
+  const olsr6::MessageHeader::Tc &tc = msg.GetTc ();
+  std::unordered_map<Ipv6Address, Topology, Ipv6AddressHash>::iterator known = n.topology.find (origin);
+  // RFC 3626 9.5: a TC older than the tuples of its originator is ignored,
+  // a newer one replaces them
+  if (known != n.topology.end () && static_cast<int16_t> (tc.ansn - known->second.ansn) < 0)
+    {
+      return;
+    }
+  Topology &t = n.topology[origin];
+  t.ansn = tc.ansn;
+  t.expires = Simulator::Now () + msg.GetVTime ();
+  n.topologyTuples -= t.destinations.size ();
+  t.destinations.clear ();
+  t.destinations.insert (tc.neighborAddresses.begin (), tc.neighborAddresses.end ());
+  n.topologyTuples += t.destinations.size ();
+}
+
+void
+Olsr6MprShadow::ExpireTopology (NodeState &n)
+{
+  for (std::unordered_map<Ipv6Address, Topology, Ipv6AddressHash>::iterator i = n.topology.begin ();
+       i != n.topology.end (); )
+    {
+      if (i->second.expires < Simulator::Now ())
+        {
+          n.topologyTuples -= i->second.destinations.size ();
+          i = n.topology.erase (i);
+        }
+      else
+        {
+          i++;
+        }
+    }
+}
+
+void
+Olsr6MprShadow::HandleMid (uint32_t node, const olsr6::MessageHeader &msg)
+{
+  NodeState &n = m_nodes[node];
+  if (!n.initialized)
+    {
+      InitOwnAddresses (node, n);
+    }
+  Ipv6Address origin = msg.GetOriginatorAddress ();
+  if (n.own.count (origin))
+    {
+      return;
+    }
+  const olsr6::MessageHeader::Mid &mid = msg.GetMid ();
+  for (std::vector<Ipv6Address>::const_iterator a = mid.interfaceAddresses.begin ();
+       a != mid.interfaceAddresses.end (); a++)
+    {
+      Alias &alias = n.aliases[*a];
+      alias.main = origin;
+      alias.expires = Simulator::Now () + msg.GetVTime ();
+    }
+}
+
+Ipv6Address
+Olsr6MprShadow::MainAddress (const NodeState &n, const Ipv6Address &address) const
+{
+  std::unordered_map<Ipv6Address, Alias, Ipv6AddressHash>::const_iterator i = n.aliases.find (address);
+  if (i == n.aliases.end () || i->second.expires < Simulator::Now ())
+    {
+      return address;
+    }
+  return i->second.main;
+}
+
+void
+Olsr6MprShadow::RemoveNeighbor (NodeState &n, const Ipv6Address &neighbor)
+{
+  AddressSet twoHops = n.neighbors[neighbor].twoHops;
+  for (AddressSet::const_iterator t = twoHops.begin (); t != twoHops.end (); t++)
+    {
+      RemoveTwoHop (n, neighbor, *t);
+    }
+  UnselectMpr (n, neighbor);
+  n.neighbors.erase (neighbor);
+}
+
+void
+Olsr6MprShadow::AddTwoHop (NodeState &n, const Ipv6Address &neighbor, const Ipv6Address &twoHop)
+{
+  m_incrementalWork++;
+  n.neighbors[neighbor].twoHops.insert (twoHop);
+  n.reach[twoHop].insert (neighbor);
+  if (n.mprs.count (neighbor))
+    {
+      n.cover[twoHop]++;
+      n.grown.insert (twoHop);
+    }
+  else if (n.cover[twoHop] == 0)
+    {
+      AddressSet uncovered;
+      uncovered.insert (twoHop);
+      Repair (n, uncovered);
+    }
+}
+
+void
+Olsr6MprShadow::RemoveTwoHop (NodeState &n, const Ipv6Address &neighbor, const Ipv6Address &twoHop)
+{
+  m_incrementalWork++;
+  n.neighbors[neighbor].twoHops.erase (twoHop);
+  AddressSet &via = n.reach[twoHop];
+  via.erase (neighbor);
+  if (via.empty ())
+    {
+      n.reach.erase (twoHop);
+      n.cover.erase (twoHop);
+      return;
+    }
+  if (n.mprs.count (neighbor) && --n.cover[twoHop] == 0)
+    {
+      AddressSet uncovered;
+      uncovered.insert (twoHop);
+      Repair (n, uncovered);
+    }
+}
+
+void
+Olsr6MprShadow::SelectMpr (NodeState &n, const Ipv6Address &mpr)
+{
+  if (!n.mprs.insert (mpr).second)
+    {
+      return;
+    }
+  const AddressSet &covered = n.neighbors[mpr].twoHops;
+  for (AddressSet::const_iterator t = covered.begin (); t != covered.end (); t++)
+    {
+      m_incrementalWork++;
+      n.cover[*t]++;
+      n.grown.insert (*t);
+    }
+}
+
+void
+Olsr6MprShadow::UnselectMpr (NodeState &n, const Ipv6Address &mpr)
+{
+  if (n.mprs.erase (mpr) == 0)
+    {
+      return;
+    }
+  AddressSet uncovered;
+  const AddressSet &covered = n.neighbors[mpr].twoHops;
+  for (AddressSet::const_iterator t = covered.begin (); t != covered.end (); t++)
+    {
+      m_incrementalWork++;
+      if (--n.cover[*t] == 0)
+        {
+          uncovered.insert (*t);
+        }
+    }
+  Repair (n, uncovered);
+}
+
+void
+Olsr6MprShadow::Repair (NodeState &n, const AddressSet &uncovered)
+{
+  AddressSet left = uncovered;
+  while (!left.empty ())
+    {
+      // Candidates are the neighbors reaching some uncovered node; pick the
+      // one covering the most of them.
+      std::unordered_map<Ipv6Address, uint32_t, Ipv6AddressHash> gain;
+      for (AddressSet::const_iterator t = left.begin (); t != left.end (); t++)
+        {
+          const AddressSet &via = n.reach[*t];
+          for (AddressSet::const_iterator v = via.begin (); v != via.end (); v++)
+            {
+              m_incrementalWork++;
+              gain[*v]++;
+            }
+        }
+      if (gain.empty ())
+        {
+          return;
+        }
+      Ipv6Address best = gain.begin ()->first;
+      uint32_t bestGain = 0;
+      for (std::unordered_map<Ipv6Address, uint32_t, Ipv6AddressHash>::const_iterator g = gain.begin ();
+           g != gain.end (); g++)
+        {
+          if (g->second > bestGain)
+            {
+              best = g->first;
+              bestGain = g->second;
+            }
+        }
+      SelectMpr (n, best);
+      const AddressSet &covered = n.neighbors[best].twoHops;
+      for (AddressSet::const_iterator t = covered.begin (); t != covered.end (); t++)
+        {
+          left.erase (*t);
+        }
+    }
+}
+
+void
+Olsr6MprShadow::Prune (NodeState &n)
+{
+  AddressSet candidates;
+  for (AddressSet::const_iterator t = n.grown.begin (); t != n.grown.end (); t++)
+    {
+      std::unordered_map<Ipv6Address, AddressSet, Ipv6AddressHash>::const_iterator via = n.reach.find (*t);
+      if (via == n.reach.end ())
+        {
+          continue;
+        }
+      for (AddressSet::const_iterator v = via->second.begin (); v != via->second.end (); v++)
+        {
+          m_incrementalWork++;
+          if (n.mprs.count (*v))
+            {
+              candidates.insert (*v);
+            }
+        }
+    }
+  n.grown.clear ();
+  for (AddressSet::const_iterator m = candidates.begin (); m != candidates.end (); m++)
+    {
+      bool redundant = true;
+      const AddressSet &covered = n.neighbors[*m].twoHops;
+      for (AddressSet::const_iterator t = covered.begin (); t != covered.end () && redundant; t++)
+        {
+          m_incrementalWork++;
+          redundant = n.cover[*t] > 1;
+        }
+      // Every node it covers keeps an MPR, so nothing needs repair
+      if (redundant)
+        {
+          UnselectMpr (n, *m);
+        }
+    }
+}
+
+void
+Olsr6MprShadow::Verify (NodeState &n)
+{
+  m_verifications++;
+  // Full greedy selection (RFC 3626 8.3.1 without willingness)
+  AddressSet full;
+  AddressSet left;
+  for (std::unordered_map<Ipv6Address, AddressSet, Ipv6AddressHash>::const_iterator t = n.reach.begin ();
+       t != n.reach.end (); t++)
+    {
+      left.insert (t->first);
+      if (t->second.size () == 1)
+        {
+          full.insert (*t->second.begin ());
+        }
+    }
+  for (AddressSet::const_iterator m = full.begin (); m != full.end (); m++)
+    {
+      const AddressSet &covered = n.neighbors[*m].twoHops;
+      for (AddressSet::const_iterator t = covered.begin (); t != covered.end (); t++)
+        {
+          left.erase (*t);
+        }
+    }
+  while (!left.empty ())
+    {
+      Ipv6Address best;
+      uint32_t bestGain = 0;
+      for (std::unordered_map<Ipv6Address, Neighbor, Ipv6AddressHash>::const_iterator i = n.neighbors.begin ();
+           i != n.neighbors.end (); i++)
+        {
+          uint32_t g = 0;
+          for (AddressSet::const_iterator t = i->second.twoHops.begin (); t != i->second.twoHops.end (); t++)
+            {
+              g += left.count (*t);
+            }
+          if (g > bestGain)
+            {
+              best = i->first;
+              bestGain = g;
+            }
+        }
+      if (bestGain == 0)
+        {
+          break;
+        }
+      full.insert (best);
+      for (AddressSet::const_iterator t = n.neighbors[best].twoHops.begin (); t != n.neighbors[best].twoHops.end (); t++)
+        {
+          left.erase (*t);
+        }
+    }
+  // Step 4: drop the MPRs whose 2-hop nodes all have another one
+  std::unordered_map<Ipv6Address, uint32_t, Ipv6AddressHash> fullCover;
+  for (AddressSet::const_iterator m = full.begin (); m != full.end (); m++)
+    {
+      const AddressSet &covered = n.neighbors[*m].twoHops;
+      for (AddressSet::const_iterator t = covered.begin (); t != covered.end (); t++)
+        {
+          fullCover[*t]++;
+        }
+    }
+  for (AddressSet::iterator m = full.begin (); m != full.end (); )
+    {
+      const AddressSet &covered = n.neighbors[*m].twoHops;
+      bool redundant = true;
+      for (AddressSet::const_iterator t = covered.begin (); t != covered.end () && redundant; t++)
+        {
+          redundant = fullCover[*t] > 1;
+        }
+      if (!redundant)
+        {
+          m++;
+          continue;
+        }
+      for (AddressSet::const_iterator t = covered.begin (); t != covered.end (); t++)
+        {
+          fullCover[*t]--;
+        }
+      m = full.erase (m);
+    }
+
+  // The incremental counters must match a recount from the selected MPRs,
+  // and every 2-hop node must be covered
+  for (std::unordered_map<Ipv6Address, AddressSet, Ipv6AddressHash>::const_iterator t = n.reach.begin ();
+       t != n.reach.end (); t++)
+    {
+      uint32_t count = 0;
+      for (AddressSet::const_iterator v = t->second.begin (); v != t->second.end (); v++)
+        {
+          count += n.mprs.count (*v);
+        }
+      if (count != n.cover[t->first])
+        {
+          m_coverCountErrors++;
+        }
+      if (count == 0)
+        {
+          m_coverageErrors++;
+        }
+    }
+  // Both are greedy covers, but they can pick different MPRs
+  for (AddressSet::const_iterator m = n.mprs.begin (); m != n.mprs.end (); m++)
+    {
+      m_setDifferences += full.count (*m) == 0;
+    }
+  for (AddressSet::const_iterator m = full.begin (); m != full.end (); m++)
+    {
+      m_setDifferences += n.mprs.count (*m) == 0;
+    }
+  m_sizeDifference += static_cast<int64_t> (n.mprs.size ()) - static_cast<int64_t> (full.size ());
+}
+
+void
+Olsr6MprShadow::PrintEvery (Time interval, Ptr<OutputStreamWrapper> stream)
+{
+  *stream->GetStream () << "# time\tavg_neighbors\tavg_two_hops\tavg_mprs\tavg_topology\tchanges"
+                        << "\tincremental_work\tfull_work";
+  if (m_verify)
+    {
+      *stream->GetStream () << "\tverifications\tcoverage_errors\tcover_count_errors"
+                            << "\tset_differences\tavg_size_diff";
+    }
+  *stream->GetStream () << std::endl;
+  Simulator::Schedule (interval, &Olsr6MprShadow::Print, this, interval, stream);
+}
+
+void
+Olsr6MprShadow::Print (Time interval, Ptr<OutputStreamWrapper> stream)
+{
+  double neighbors = 0;
+  double twoHops = 0;
+  double mprs = 0;
+  double topology = 0;
+  for (std::vector<NodeState>::const_iterator n = m_nodes.begin (); n != m_nodes.end (); n++)
+    {
+      neighbors += n->neighbors.size ();
+      twoHops += n->reach.size ();
+      mprs += n->mprs.size ();
+      topology += n->topologyTuples;
+    }
+  double count = m_nodes.empty () ? 1 : m_nodes.size ();
+  *stream->GetStream () << Simulator::Now ().GetSeconds ()
+                        << "\t" << neighbors / count
+                        << "\t" << twoHops / count
+                        << "\t" << mprs / count
+                        << "\t" << topology / count
+                        << "\t" << m_changes
+                        << "\t" << m_incrementalWork
+                        << "\t" << m_fullWork;
+  if (m_verify)
+    {
+      *stream->GetStream () << "\t" << m_verifications
+                            << "\t" << m_coverageErrors
+                            << "\t" << m_coverCountErrors
+                            << "\t" << m_setDifferences
+                            << "\t" << (m_verifications ? double (m_sizeDifference) / m_verifications : 0);
+    }
+  *stream->GetStream () << std::endl;
+  Simulator::Schedule (interval, &Olsr6MprShadow::Print, this, interval, stream);
+}
+
+} // namespace ns3
+
+#endif /* OLSR6_MPR_SHADOW_H */
@@ -0,0 +1,685 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Incremental shortest-path route computation, run as a shadow of the
+// OLSR6 agents.
+//
+// The olsr6 module rebuilds the whole routing table of an agent after every
+// OLSR packet it receives, whether or not the packet changed anything.
+// This class rebuilds, from the HELLO and TC messages each agent receives
+// (its "Rx" trace), the graph the RFC 3626 route computation walks:
+//
+//  - node -> symmetric neighbor, for every HELLO sender with an entry that
+//    lists one of the node's addresses as SYM_LINK or ASYM_LINK;
+//  - neighbor -> the symmetric neighbors it lists, its 2-hop nodes;
+//  - TC originator -> the neighbors it advertises (topology tuples);
+//
+// and keeps the hop count of every destination (a shortest-path tree from
+// the node) up to date edge by edge:
+//
+//  - an added edge u -> v only relaxes the destinations whose distance
+//    drops through v;
+//  - a removed edge u -> v that carried the shortest path to v collects
+//    the destinations left without a shortest parent (level by level from
+//    v) and only recomputes those, from their remaining parents.
+//
+// Edges follow the validity time of the message that advertised them and
+// a newer TC of an originator replaces its older tuples, diffed against
+// them.  Work (edge visits) is counted for the incremental updates and for
+// the full breadth-first rebuild the agent does per received packet.  With
+// Verify=true a full rebuild also runs after every change and its
+// distances are compared with the incremental ones destination by
+// destination.
+//
+// Like Olsr6MprShadow it does not replace the agents' computation: the
+// olsr6 sources are not part of this tree.
+//
+
+#ifndef OLSR6_ROUTE_SHADOW_H
+#define OLSR6_ROUTE_SHADOW_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/olsr6-routing-protocol.h"
+#include "ns3/olsr6-header.h"
+
+#include <deque>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ns3 {
+
+class Olsr6RouteShadow : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  Olsr6RouteShadow ();
+
+  /**
+   * \brief Follow the HELLOs and TCs received by the OLSR6 agent of every
+   * node.
+   * \param nodes nodes with an olsr6::RoutingProtocol aggregated
+   */
+  void Install (NodeContainer nodes);
+
+  /**
+   * \brief Write route counts and work counters at the end of every
+   * interval.
+   * \param interval sampling period
+   * \param stream output
+   */
+  void PrintEvery (Time interval, Ptr<OutputStreamWrapper> stream);
+
+private:
+  typedef std::unordered_set<Ipv6Address, Ipv6AddressHash> AddressSet;
+  typedef std::unordered_map<Ipv6Address, uint32_t, Ipv6AddressHash> AddressCount;
+
+  // RFC 3626 link types (lower two bits of a link code) and neighbor
+  // types (the two bits above)
+  enum
+  {
+    ASYM_LINK = 1,
+    SYM_LINK = 2,
+    LOST_LINK = 3
+  };
+  enum
+  {
+    SYM_NEIGH = 1,
+    MPR_NEIGH = 2
+  };
+
+  /// What one neighbor (HELLO) or originator (TC) advertised last.
+  struct Advertisement
+  {
+    Advertisement () : ansn (0) {}
+    Time expires;
+    uint16_t ansn;
+    AddressSet targets;
+  };
+
+  struct NodeState
+  {
+    NodeState () : initialized (false), edges (0) {}
+    bool initialized;
+    AddressSet own;
+    std::unordered_map<Ipv6Address, Advertisement, Ipv6AddressHash> hellos; // by neighbor
+    std::unordered_map<Ipv6Address, Advertisement, Ipv6AddressHash> tcs;    // by originator
+    std::unordered_map<Ipv6Address, AddressCount, Ipv6AddressHash> out;     // u -> v -> advertisements
+    std::unordered_map<Ipv6Address, AddressSet, Ipv6AddressHash> in;        // v -> u
+    AddressCount distance; // hops, the node itself (Self ()) at 0
+    uint64_t edges;
+  };
+
+  /// Key of the node itself in its graph
+  static Ipv6Address Self (void);
+
+  static void Rx (Olsr6RouteShadow *shadow, uint32_t node,
+                  const olsr6::PacketHeader &header, const olsr6::MessageList &messages);
+  void InitOwnAddresses (uint32_t node, NodeState &n);
+  void HandleHello (NodeState &n, const olsr6::MessageHeader &msg);
+  void HandleTc (NodeState &n, const olsr6::MessageHeader &msg);
+  void Expire (NodeState &n);
+  void Update (NodeState &n, const Ipv6Address &from, AddressSet &targets, const AddressSet &advertised);
+  void AddEdge (NodeState &n, const Ipv6Address &u, const Ipv6Address &v);
+  void RemoveEdge (NodeState &n, const Ipv6Address &u, const Ipv6Address &v);
+  void Relax (NodeState &n, const Ipv6Address &u, const Ipv6Address &v);
+  void Repair (NodeState &n, const Ipv6Address &u, const Ipv6Address &v);
+  bool HasParent (NodeState &n, const Ipv6Address &v, const AddressSet &excluded);
+  void Rebuild (const NodeState &n, AddressCount &distance);
+  void Verify (const NodeState &n);
+  void Print (Time interval, Ptr<OutputStreamWrapper> stream);
+
+  bool m_verify;
+  std::vector<NodeState> m_nodes; // indexed by node id
+  std::vector<Ptr<ns3::Node> > m_ns3Nodes;
+
+  uint64_t m_packets;
+  uint64_t m_changes;
+  uint64_t m_incrementalWork;
+  uint64_t m_fullWork;
+  uint64_t m_verifications;
+  uint64_t m_mismatches;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (Olsr6RouteShadow);
+
+TypeId
+Olsr6RouteShadow::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::Olsr6RouteShadow")
+    .SetParent<Object> ()
+    .AddConstructor<Olsr6RouteShadow> ()
+    .AddAttribute ("Verify", "Cross-check every change against a full recomputation.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Olsr6RouteShadow::m_verify),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+Olsr6RouteShadow::Olsr6RouteShadow ()
+  : m_verify (false),
+    m_packets (0),
+    m_changes (0),
+    m_incrementalWork (0),
+    m_fullWork (0),
+    m_verifications (0),
+    m_mismatches (0)
+{
+}
+
+Ipv6Address
+Olsr6RouteShadow::Self (void)
+{
+  return Ipv6Address::GetAny ();
+}
+
+void
+Olsr6RouteShadow::Install (NodeContainer nodes)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); i++)
+    {
+      Ptr<olsr6::RoutingProtocol> agent = (*i)->GetObject<olsr6::RoutingProtocol> ();
+      if (agent == 0)
+        {
+          continue;
+        }
+      uint32_t id = (*i)->GetId ();
+      if (id >= m_nodes.size ())
+        {
+          m_nodes.resize (id + 1);
+          m_ns3Nodes.resize (id + 1);
+        }
+      m_ns3Nodes[id] = *i;
+      agent->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&Olsr6RouteShadow::Rx, this, id));
+    }
+}
+
+void
+Olsr6RouteShadow::Rx (Olsr6RouteShadow *shadow, uint32_t node,
+                      const olsr6::PacketHeader &header, const olsr6::MessageList &messages)
+{
+  NodeState &n = shadow->m_nodes[node];
+  if (!n.initialized)
+    {
+      shadow->InitOwnAddresses (node, n);
+    }
+  uint64_t changes = shadow->m_changes;
+  shadow->Expire (n);
+  for (olsr6::MessageList::const_iterator m = messages.begin (); m != messages.end (); m++)
+    {
+      if (m->GetMessageType () == olsr6::MessageHeader::HELLO_MESSAGE)
+        {
+          shadow->HandleHello (n, *m);
+        }
+      else if (m->GetMessageType () == olsr6::MessageHeader::TC_MESSAGE)
+        {
+          shadow->HandleTc (n, *m);
+        }
+    }
+  // The agent runs a full breadth-first rebuild after every packet
+  shadow->m_packets++;
+  shadow->m_fullWork += n.distance.size () + n.edges;
+  if (shadow->m_verify && shadow->m_changes != changes)
+    {
+      shadow->Verify (n);
+    }
+}
+
+void
+Olsr6RouteShadow::InitOwnAddresses (uint32_t node, NodeState &n)
+{
+  Ptr<Ipv6> ipv6 = m_ns3Nodes[node]->GetObject<Ipv6> ();
+  for (uint32_t i = 0; i < ipv6->GetNInterfaces (); i++)
+    {
+      for (uint32_t j = 0; j < ipv6->GetNAddresses (i); j++)
+        {
+          n.own.insert (ipv6->GetAddress (i, j).GetAddress ());
+        }
+    }
+  n.distance[Self ()] = 0;
+  n.initialized = true;
+}
+
+void
+Olsr6RouteShadow::HandleHello (NodeState &n, const olsr6::MessageHeader &msg)
+{
+  Ipv6Address origin = msg.GetOriginatorAddress ();
+  if (n.own.count (origin))
+    {
+      return;
+    }
+  const olsr6::MessageHeader::Hello &h = msg.GetHello ();
+  // Only a sender that hears this node, on any of its radios, is a
+  // neighbor (RFC 3626 7.1.1)
+  bool symmetric = false;
+  for (std::vector<olsr6::MessageHeader::Hello::LinkMessage>::const_iterator l = h.linkMessages.begin ();
+       l != h.linkMessages.end (); l++)
+    {
+      int linkType = l->linkCode & 0x03;
+      for (std::vector<Ipv6Address>::const_iterator a = l->neighborInterfaceAddresses.begin ();
+           a != l->neighborInterfaceAddresses.end (); a++)
+        {
+          if (n.own.count (*a) && (linkType == SYM_LINK || linkType == ASYM_LINK))
+            {
+              symmetric = true;
+            }
+        }
+    }
+  std::unordered_map<Ipv6Address, Advertisement, Ipv6AddressHash>::iterator known = n.hellos.find (origin);
+  if (!symmetric)
+    {
+      if (known != n.hellos.end ())
+        {
+          Update (n, origin, known->second.targets, AddressSet ());
+          RemoveEdge (n, Self (), origin);
+          n.hellos.erase (known);
+        }
+      return;
+    }
+  if (known == n.hellos.end ())
+    {
+      AddEdge (n, Self (), origin);
+    }
+  Advertisement &hello = n.hellos[origin];
+  hello.expires = Simulator::Now () + msg.GetVTime ();
+
+  AddressSet advertised;
+  for (std::vector<olsr6::MessageHeader::Hello::LinkMessage>::const_iterator l = h.linkMessages.begin ();
+       l != h.linkMessages.end (); l++)
+    {
+      int neighborType = (l->linkCode >> 2) & 0x03;
+      if (neighborType != SYM_NEIGH && neighborType != MPR_NEIGH)
+        {
+          continue;
+        }
+      for (std::vector<Ipv6Address>::const_iterator a = l->neighborInterfaceAddresses.begin ();
+           a != l->neighborInterfaceAddresses.end (); a++)
+        {
+          if (n.own.count (*a) == 0)
+            {
+              advertised.insert (*a);
+            }
+        }
+    }
+  Update (n, origin, hello.targets, advertised);
+}
+
+void
+Olsr6RouteShadow::HandleTc (NodeState &n, const olsr6::MessageHeader &msg)
+{
+  Ipv6Address origin = msg.GetOriginatorAddress ();
+  if (n.own.count (origin))
+    {
+      return;
+    }
+  const olsr6::MessageHeader::Tc &tc = msg.GetTc ();
+  std::unordered_map<Ipv6Address, Advertisement, Ipv6AddressHash>::iterator known = n.tcs.find (origin);
+  // RFC 3626 9.5: ignore a TC older than the tuples it would replace
+  if (known != n.tcs.end () && static_cast<int16_t> (tc.ansn - known->second.ansn) < 0)
+    {
+      return;
+    }
+  Advertisement &topology = n.tcs[origin];
+  topology.ansn = tc.ansn;
+  topology.expires = Simulator::Now () + msg.GetVTime ();
+  AddressSet advertised;
+  for (std::vector<Ipv6Address>::const_iterator a = tc.neighborAddresses.begin ();
+       a != tc.neighborAddresses.end (); a++)
+    {
+      if (n.own.count (*a) == 0)
+        {
+          advertised.insert (*a);
+        }
+    }
+  Update (n, origin, topology.targets, advertised);
+}
+
+void
+Olsr6RouteShadow::Expire (NodeState &n)
+{
+  Time now = Simulator::Now ();
+  std::vector<Ipv6Address> expired;
+  for (std::unordered_map<Ipv6Address, Advertisement, Ipv6AddressHash>::const_iterator i = n.hellos.begin ();
+       i != n.hellos.end (); i++)
+    {
+      if (i->second.expires < now)
+        {
+          expired.push_back (i->first);
+        }
+    }
+  for (std::vector<Ipv6Address>::const_iterator i = expired.begin (); i != expired.end (); i++)
+    {
+      Update (n, *i, n.hellos[*i].targets, AddressSet ());
+      RemoveEdge (n, Self (), *i);
+      n.hellos.erase (*i);
+    }
+  expired.clear ();
+  for (std::unordered_map<Ipv6Address, Advertisement, Ipv6AddressHash>::const_iterator i = n.tcs.begin ();
+       i != n.tcs.end (); i++)
+    {
+      if (i->second.expires < now)
+        {
+          expired.push_back (i->first);
+        }
+    }
+  for (std::vector<Ipv6Address>::const_iterator i = expired.begin (); i != expired.end (); i++)
+    {
+      Update (n, *i, n.tcs[*i].targets, AddressSet ());
+      n.tcs.erase (*i);
+    }
+}
+
+void
+Olsr6RouteShadow::Update (NodeState &n, const Ipv6Address &from, AddressSet &targets, const AddressSet &advertised)
+{
+  // Diff against the previous advertisement of the same sender only
+  std::vector<Ipv6Address> gone;
+  for (AddressSet::const_iterator t = targets.begin (); t != targets.end (); t++)
+    {
+      m_incrementalWork++;
+      if (advertised.count (*t) == 0)
+        {
+          gone.push_back (*t);
+        }
+    }
+  for (std::vector<Ipv6Address>::const_iterator t = gone.begin (); t != gone.end (); t++)
+    {
+      targets.erase (*t);
+      RemoveEdge (n, from, *t);
+    }
+  for (AddressSet::const_iterator t = advertised.begin (); t != advertised.end (); t++)
+    {
+      m_incrementalWork++;
+      if (targets.insert (*t).second)
+        {
+          AddEdge (n, from, *t);
+        }
+    }
+}
+
+void
+Olsr6RouteShadow::AddEdge (NodeState &n, const Ipv6Address &u, const Ipv6Address &v)
+{
+  // A HELLO and a TC can advertise the same edge
+  if (++n.out[u][v] > 1)
+    {
+      return;
+    }
+  n.in[v].insert (u);
+  n.edges++;
+  m_changes++;
+  Relax (n, u, v);
+}
+
+void
+Olsr6RouteShadow::RemoveEdge (NodeState &n, const Ipv6Address &u, const Ipv6Address &v)
+{
+  AddressCount &out = n.out[u];
+  if (--out[v] > 0)
+    {
+      return;
+    }
+  out.erase (v);
+  if (out.empty ())
+    {
+      n.out.erase (u);
+    }
+  AddressSet &in = n.in[v];
+  in.erase (u);
+  if (in.empty ())
+    {
+      n.in.erase (v);
+    }
+  n.edges--;
+  m_changes++;
+  Repair (n, u, v);
+}
+
+void
+Olsr6RouteShadow::Relax (NodeState &n, const Ipv6Address &u, const Ipv6Address &v)
+{
+  AddressCount::const_iterator du = n.distance.find (u);
+  if (du == n.distance.end ())
+    {
+      return;
+    }
+  AddressCount::iterator dv = n.distance.find (v);
+  if (dv != n.distance.end () && dv->second <= du->second + 1)
+    {
+      return;
+    }
+  n.distance[v] = du->second + 1;
+  // Only the destinations that get closer through v are visited
+  std::deque<Ipv6Address> queue (1, v);
+  while (!queue.empty ())
+    {
+      Ipv6Address x = queue.front ();
+      queue.pop_front ();
+      uint32_t next = n.distance[x] + 1;
+      std::unordered_map<Ipv6Address, AddressCount, Ipv6AddressHash>::const_iterator out = n.out.find (x);
+      if (out == n.out.end ())
+        {
+          continue;
+        }
+      for (AddressCount::const_iterator y = out->second.begin (); y != out->second.end (); y++)
+        {
+          m_incrementalWork++;
+          AddressCount::iterator dy = n.distance.find (y->first);
+          if (dy == n.distance.end () || dy->second > next)
+            {
+              n.distance[y->first] = next;
+              queue.push_back (y->first);
+            }
+        }
+    }
+}
+
+bool
+Olsr6RouteShadow::HasParent (NodeState &n, const Ipv6Address &v, const AddressSet &excluded)
+{
+  std::unordered_map<Ipv6Address, AddressSet, Ipv6AddressHash>::const_iterator in = n.in.find (v);
+  if (in == n.in.end ())
+    {
+      return false;
+    }
+  uint32_t dv = n.distance[v];
+  for (AddressSet::const_iterator w = in->second.begin (); w != in->second.end (); w++)
+    {
+      m_incrementalWork++;
+      AddressCount::const_iterator dw = n.distance.find (*w);
+      if (dw != n.distance.end () && dw->second + 1 == dv && excluded.count (*w) == 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+Olsr6RouteShadow::Repair (NodeState &n, const Ipv6Address &u, const Ipv6Address &v)
+{
+  AddressCount::const_iterator du = n.distance.find (u);
+  AddressCount::const_iterator dv = n.distance.find (v);
+  if (du == n.distance.end () || dv == n.distance.end () || du->second + 1 != dv->second)
+    {
+      // The edge was not on a shortest path
+      return;
+    }
+  AddressSet affected;
+  if (HasParent (n, v, affected))
+    {
+      return;
+    }
+  // Destinations left without a shortest parent, by increasing distance:
+  // all of level d are known before any of level d + 1 is checked
+  std::vector<Ipv6Address> order (1, v);
+  affected.insert (v);
+  for (uint32_t k = 0; k < order.size (); k++)
+    {
+      uint32_t next = n.distance[order[k]] + 1;
+      std::unordered_map<Ipv6Address, AddressCount, Ipv6AddressHash>::const_iterator out = n.out.find (order[k]);
+      if (out == n.out.end ())
+        {
+          continue;
+        }
+      for (AddressCount::const_iterator y = out->second.begin (); y != out->second.end (); y++)
+        {
+          m_incrementalWork++;
+          AddressCount::const_iterator dy = n.distance.find (y->first);
+          if (dy != n.distance.end () && dy->second == next && affected.count (y->first) == 0
+              && !HasParent (n, y->first, affected))
+            {
+              affected.insert (y->first);
+              order.push_back (y->first);
+            }
+        }
+    }
+  for (std::vector<Ipv6Address>::const_iterator a = order.begin (); a != order.end (); a++)
+    {
+      n.distance.erase (*a);
+    }
+
+  // Shortest paths among the affected ones, entered from their remaining
+  // parents; those not reached are now unreachable
+  typedef std::pair<uint32_t, Ipv6Address> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap;
+  for (std::vector<Ipv6Address>::const_iterator a = order.begin (); a != order.end (); a++)
+    {
+      std::unordered_map<Ipv6Address, AddressSet, Ipv6AddressHash>::const_iterator in = n.in.find (*a);
+      if (in == n.in.end ())
+        {
+          continue;
+        }
+      for (AddressSet::const_iterator w = in->second.begin (); w != in->second.end (); w++)
+        {
+          m_incrementalWork++;
+          AddressCount::const_iterator dw = n.distance.find (*w);
+          if (dw != n.distance.end ())
+            {
+              heap.push (Entry (dw->second + 1, *a));
+            }
+        }
+    }
+  while (!heap.empty ())
+    {
+      Entry e = heap.top ();
+      heap.pop ();
+      if (n.distance.count (e.second))
+        {
+          continue;
+        }
+      n.distance[e.second] = e.first;
+      std::unordered_map<Ipv6Address, AddressCount, Ipv6AddressHash>::const_iterator out = n.out.find (e.second);
+      if (out == n.out.end ())
+        {
+          continue;
+        }
+      for (AddressCount::const_iterator y = out->second.begin (); y != out->second.end (); y++)
+        {
+          m_incrementalWork++;
+          if (affected.count (y->first) && n.distance.count (y->first) == 0)
+            {
+              heap.push (Entry (e.first + 1, y->first));
+            }
+        }
+    }
+}
+
+void
+Olsr6RouteShadow::Rebuild (const NodeState &n, AddressCount &distance)
+{
+  distance.clear ();
+  distance[Self ()] = 0;
+  std::deque<Ipv6Address> queue (1, Self ());
+  while (!queue.empty ())
+    {
+      Ipv6Address x = queue.front ();
+      queue.pop_front ();
+      uint32_t next = distance[x] + 1;
+      std::unordered_map<Ipv6Address, AddressCount, Ipv6AddressHash>::const_iterator out = n.out.find (x);
+      if (out == n.out.end ())
+        {
+          continue;
+        }
+      for (AddressCount::const_iterator y = out->second.begin (); y != out->second.end (); y++)
+        {
+          if (distance.insert (std::make_pair (y->first, next)).second)
+            {
+              queue.push_back (y->first);
+            }
+        }
+    }
+}
+
+void
+Olsr6RouteShadow::Verify (const NodeState &n)
+{
+  m_verifications++;
+  AddressCount full;
+  Rebuild (n, full);
+  // Every destination of either tree must be in the other at the same distance
+  for (AddressCount::const_iterator d = full.begin (); d != full.end (); d++)
+    {
+      AddressCount::const_iterator i = n.distance.find (d->first);
+      if (i == n.distance.end () || i->second != d->second)
+        {
+          m_mismatches++;
+        }
+    }
+  for (AddressCount::const_iterator i = n.distance.begin (); i != n.distance.end (); i++)
+    {
+      if (full.count (i->first) == 0)
+        {
+          m_mismatches++;
+        }
+    }
+}
+
+void
+Olsr6RouteShadow::PrintEvery (Time interval, Ptr<OutputStreamWrapper> stream)
+{
+  *stream->GetStream () << "# time\tavg_destinations\tavg_edges\tpackets\tchanges"
+                        << "\tincremental_work\tfull_work";
+  if (m_verify)
+    {
+      *stream->GetStream () << "\tverifications\tmismatches";
+    }
+  *stream->GetStream () << std::endl;
+  Simulator::Schedule (interval, &Olsr6RouteShadow::Print, this, interval, stream);
+}
+
+void
+Olsr6RouteShadow::Print (Time interval, Ptr<OutputStreamWrapper> stream)
+{
+  double destinations = 0;
+  double edges = 0;
+  for (std::vector<NodeState>::const_iterator n = m_nodes.begin (); n != m_nodes.end (); n++)
+    {
+      destinations += n->distance.empty () ? 0 : n->distance.size () - 1;
+      edges += n->edges;
+    }
+  double count = m_nodes.empty () ? 1 : m_nodes.size ();
+  *stream->GetStream () << Simulator::Now ().GetSeconds ()
+                        << "\t" << destinations / count
+                        << "\t" << edges / count
+                        << "\t" << m_packets
+                        << "\t" << m_changes
+                        << "\t" << m_incrementalWork
+                        << "\t" << m_fullWork;
+  if (m_verify)
+    {
+      *stream->GetStream () << "\t" << m_verifications
+                            << "\t" << m_mismatches;
+    }
+  *stream->GetStream () << std::endl;
+  Simulator::Schedule (interval, &Olsr6RouteShadow::Print, this, interval, stream);
+}
+
+} // namespace ns3
+
+#endif /* OLSR6_ROUTE_SHADOW_H */
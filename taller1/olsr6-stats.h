@@ -0,0 +1,317 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Counters for the OLSR6 agents installed by Olsr6Helper, and an optional
+// controller that adapts their HELLO/TC intervals to neighborhood churn.
+//
+// olsr6::RoutingProtocol (like the IPv4 olsr::RoutingProtocol it was
+// ported from) rebuilds its whole routing table at the end of every OLSR
+// packet it receives, whether or not the packet changed a link, 2-hop
+// neighbor or topology tuple, and fires RoutingTableChanged after each
+// rebuild.  The rebuild count per node and per interval is therefore the
+// number of control packets received: the route computation the agents
+// pay for, not the topology churn (Olsr6RouteShadow counts the actual
+// changes).
+//
+// The "Tx" trace gives every control packet with the messages packed into
+// it.  The agent already aggregates all messages queued within its jitter
+// window into one packet; the counters report how many messages per packet
+// that achieves, and the airtime the control traffic takes at the
+// configured PHY rate.
+//
+// With adaptive intervals the churn of a node is the number of neighbor and
+// 2-hop set changes Olsr6MprShadow found in its last window, per HELLO it
+// received.  Normalising by the HELLOs keeps the signal independent of the
+// interval itself: a faster HELLO rate does not make the same mobility
+// look like more churn.  Each agent's HelloInterval and TcInterval are
+// halved (down to MinInterval) when its churn is above HighChurn, and grown
+// by half (up to MaxInterval) when it is below LowChurn.  The agent
+// re-reads both attributes every time it rearms its timers, and derives
+// the advertised validity times from them, so neighbors follow the change.
+//
+
+#ifndef OLSR6_STATS_H
+#define OLSR6_STATS_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/olsr6-routing-protocol.h"
+#include "ns3/olsr6-header.h"
+#include "attribute-handle.h"
+#include "olsr6-mpr-shadow.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace ns3 {
+
+class Olsr6Stats : public Object
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::Olsr6Stats")
+      .SetParent<Object> ()
+      .AddConstructor<Olsr6Stats> ()
+      .AddAttribute ("DataRate", "PHY rate of the control broadcasts (the NonUnicastMode rate).",
+                     DataRateValue (DataRate ("1Mbps")),
+                     MakeDataRateAccessor (&Olsr6Stats::m_dataRate),
+                     MakeDataRateChecker ())
+      .AddAttribute ("PreambleDuration", "PLCP preamble and header of every frame, for the NonUnicastMode modulation.",
+                     TimeValue (MicroSeconds (192)),
+                     MakeTimeAccessor (&Olsr6Stats::m_preamble),
+                     MakeTimeChecker ())
+      .AddAttribute ("MinInterval", "Shortest adaptive HELLO/TC interval.",
+                     TimeValue (Seconds (1)),
+                     MakeTimeAccessor (&Olsr6Stats::m_minInterval),
+                     MakeTimeChecker ())
+      .AddAttribute ("MaxInterval", "Longest adaptive HELLO/TC interval.",
+                     TimeValue (Seconds (8)),
+                     MakeTimeAccessor (&Olsr6Stats::m_maxInterval),
+                     MakeTimeChecker ())
+      .AddAttribute ("HighChurn", "Neighborhood changes per HELLO received above which intervals shrink.",
+                     DoubleValue (0.2),
+                     MakeDoubleAccessor (&Olsr6Stats::m_highChurn),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("LowChurn", "Neighborhood changes per HELLO received below which intervals grow.",
+                     DoubleValue (0.02),
+                     MakeDoubleAccessor (&Olsr6Stats::m_lowChurn),
+                     MakeDoubleChecker<double> (0))
+    ;
+    return tid;
+  }
+
+  Olsr6Stats ()
+    : m_dataRate (DataRate ("1Mbps")),
+      m_preamble (MicroSeconds (192)),
+      m_minInterval (Seconds (1)),
+      m_maxInterval (Seconds (8)),
+      m_highChurn (0.2),
+      m_lowChurn (0.02),
+      m_helloInterval (olsr6::RoutingProtocol::GetTypeId (), "HelloInterval"),
+      m_tcInterval (olsr6::RoutingProtocol::GetTypeId (), "TcInterval")
+  {
+  }
+
+  /**
+   * \brief Connect to the OLSR6 agent of every node in the container.
+   * \param nodes nodes with an olsr6::RoutingProtocol aggregated
+   */
+  void Install (NodeContainer nodes)
+  {
+    for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); i++)
+      {
+        Ptr<olsr6::RoutingProtocol> agent = (*i)->GetObject<olsr6::RoutingProtocol> ();
+        if (agent == 0)
+          {
+            continue;
+          }
+        uint32_t id = (*i)->GetId ();
+        if (id >= m_nodes.size ())
+          {
+            m_nodes.resize (id + 1);
+          }
+        m_nodes[id].agent = agent;
+        agent->TraceConnectWithoutContext ("RoutingTableChanged",
+                                           MakeBoundCallback (&Olsr6Stats::RoutingTableChanged, this, id));
+        agent->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&Olsr6Stats::Tx, this, id));
+      }
+  }
+
+  /**
+   * \brief Write totals per interval to a stream until the end of the run.
+   * \param interval sampling period
+   * \param stream output
+   */
+  void PrintEvery (Time interval, Ptr<OutputStreamWrapper> stream)
+  {
+    *stream->GetStream () << "# time\trebuilds\trebuilds_per_node_per_s\tmax_node\tmax_node_rebuilds\tavg_routes"
+                          << "\ttx_packets\ttx_msgs\tmsgs_per_packet\ttx_hello\ttx_tc\ttx_bytes\tairtime_ms"
+                          << "\tavg_hello_s" << std::endl;
+    m_printed = m_totals;
+    for (std::vector<PerNode>::iterator n = m_nodes.begin (); n != m_nodes.end (); n++)
+      {
+        n->printedRebuilds = n->rebuilds;
+      }
+    Simulator::Schedule (interval, &Olsr6Stats::Print, this, interval, stream);
+  }
+
+  /**
+   * \brief Adapt HELLO/TC intervals of every agent to its churn.
+   * \param window time between adaptations
+   * \param shadow follows the neighborhoods of the same nodes
+   */
+  void EnableAdaptiveIntervals (Time window, Ptr<Olsr6MprShadow> shadow)
+  {
+    m_shadow = shadow;
+    for (uint32_t n = 0; n < m_nodes.size (); n++)
+      {
+        m_nodes[n].adaptedChanges = shadow->GetNeighborhoodChanges (n);
+        m_nodes[n].adaptedHellos = shadow->GetHellos (n);
+      }
+    Simulator::Schedule (window, &Olsr6Stats::Adapt, this, window);
+  }
+
+  /// \return number of full routing table rebuilds on a node (packets received)
+  uint64_t GetRebuilds (uint32_t node) const
+  {
+    return node < m_nodes.size () ? m_nodes[node].rebuilds : 0;
+  }
+
+private:
+  struct Totals
+  {
+    Totals () : packets (0), messages (0), hellos (0), tcs (0), bytes (0), airtime (0) {}
+    uint64_t packets;
+    uint64_t messages;
+    uint64_t hellos;
+    uint64_t tcs;
+    uint64_t bytes;
+    double airtime; // seconds
+  };
+
+  struct PerNode
+  {
+    PerNode () : rebuilds (0), printedRebuilds (0), adaptedChanges (0), adaptedHellos (0), routes (0) {}
+    Ptr<olsr6::RoutingProtocol> agent;
+    uint64_t rebuilds;
+    uint64_t printedRebuilds;
+    uint64_t adaptedChanges;
+    uint64_t adaptedHellos;
+    uint32_t routes;
+  };
+
+  static void RoutingTableChanged (Olsr6Stats *stats, uint32_t node, uint32_t size)
+  {
+    stats->m_nodes[node].rebuilds++;
+    stats->m_nodes[node].routes = size;
+  }
+
+  static void Tx (Olsr6Stats *stats, uint32_t node,
+                  const olsr6::PacketHeader &header, const olsr6::MessageList &messages)
+  {
+    Totals &t = stats->m_totals;
+    t.packets++;
+    t.messages += messages.size ();
+    for (olsr6::MessageList::const_iterator m = messages.begin (); m != messages.end (); m++)
+      {
+        if (m->GetMessageType () == olsr6::MessageHeader::HELLO_MESSAGE)
+          {
+            t.hellos++;
+          }
+        else if (m->GetMessageType () == olsr6::MessageHeader::TC_MESSAGE)
+          {
+            t.tcs++;
+          }
+      }
+    // OLSR packet + UDP + IPv6 + LLC/SNAP + 802.11 header and FCS; control
+    // packets are broadcast, so there is no ACK
+    uint32_t frame = header.GetPacketLength () + 8 + 40 + 8 + 28;
+    t.bytes += frame;
+    t.airtime += stats->m_preamble.GetSeconds () + frame * 8.0 / stats->m_dataRate.GetBitRate ();
+  }
+
+  void Print (Time interval, Ptr<OutputStreamWrapper> stream)
+  {
+    uint64_t total = 0;
+    uint64_t max = 0;
+    uint32_t maxNode = 0;
+    uint64_t routes = 0;
+    double hello = 0;
+    for (uint32_t n = 0; n < m_nodes.size (); n++)
+      {
+        uint64_t delta = m_nodes[n].rebuilds - m_nodes[n].printedRebuilds;
+        m_nodes[n].printedRebuilds = m_nodes[n].rebuilds;
+        total += delta;
+        routes += m_nodes[n].routes;
+        if (delta > max)
+          {
+            max = delta;
+            maxNode = n;
+          }
+        if (m_nodes[n].agent != 0)
+          {
+            hello += m_helloInterval.Get (m_nodes[n].agent).Get ().GetSeconds ();
+          }
+      }
+    double nodes = m_nodes.empty () ? 1 : m_nodes.size ();
+    uint64_t packets = m_totals.packets - m_printed.packets;
+    uint64_t messages = m_totals.messages - m_printed.messages;
+    *stream->GetStream () << Simulator::Now ().GetSeconds ()
+                          << "\t" << total
+                          << "\t" << total / nodes / interval.GetSeconds ()
+                          << "\t" << maxNode
+                          << "\t" << max
+                          << "\t" << routes / nodes
+                          << "\t" << packets
+                          << "\t" << messages
+                          << "\t" << (packets ? double (messages) / packets : 0)
+                          << "\t" << m_totals.hellos - m_printed.hellos
+                          << "\t" << m_totals.tcs - m_printed.tcs
+                          << "\t" << m_totals.bytes - m_printed.bytes
+                          << "\t" << (m_totals.airtime - m_printed.airtime) * 1e3
+                          << "\t" << hello / nodes
+                          << std::endl;
+    m_printed = m_totals;
+    Simulator::Schedule (interval, &Olsr6Stats::Print, this, interval, stream);
+  }
+
+  void Adapt (Time window)
+  {
+    for (uint32_t i = 0; i < m_nodes.size (); i++)
+      {
+        PerNode *n = &m_nodes[i];
+        if (n->agent == 0)
+          {
+            continue;
+          }
+        uint64_t changes = m_shadow->GetNeighborhoodChanges (i);
+        uint64_t hellos = m_shadow->GetHellos (i);
+        double received = hellos - n->adaptedHellos;
+        double churn = (changes - n->adaptedChanges) / std::max (1.0, received);
+        n->adaptedChanges = changes;
+        n->adaptedHellos = hellos;
+        if (received == 0)
+          {
+            // No neighbor heard: nothing to adapt to
+            continue;
+          }
+        Time hello = m_helloInterval.Get (n->agent).Get ();
+        if (churn > m_highChurn)
+          {
+            hello = std::max (m_minInterval, hello / 2);
+          }
+        else if (churn < m_lowChurn)
+          {
+            hello = std::min (m_maxInterval, hello + hello / 2);
+          }
+        else
+          {
+            continue;
+          }
+        // Keep the RFC 3626 default ratio TC = 2.5 x HELLO
+        m_helloInterval.Set (n->agent, TimeValue (hello));
+        m_tcInterval.Set (n->agent, TimeValue (hello * 5 / 2));
+      }
+    Simulator::Schedule (window, &Olsr6Stats::Adapt, this, window);
+  }
+
+  DataRate m_dataRate;
+  Time m_preamble;
+  Time m_minInterval;
+  Time m_maxInterval;
+  double m_highChurn;
+  double m_lowChurn;
+  AttributeHandle<TimeValue> m_helloInterval;
+  AttributeHandle<TimeValue> m_tcInterval;
+  Ptr<Olsr6MprShadow> m_shadow;
+
+  std::vector<PerNode> m_nodes; // indexed by node id
+  Totals m_totals;
+  Totals m_printed;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (Olsr6Stats);
+
+} // namespace ns3
+
+#endif /* OLSR6_STATS_H */
@@ -0,0 +1,779 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Replay of the UDP flows of a pcap capture as ns-3 traffic.
+//
+// PcapTrace maps the capture read-only (mmap) and parses it in place: the
+// record, link, IP and UDP headers are read straight from the mapping and
+// a datagram is described by pointers to its addresses, its ports, its
+// UDP payload size and its time since the first record.  Nothing is copied
+// and the payloads are never read, so a capture taken with a short snaplen
+// replays with the original sizes.  Classic pcap files in either byte
+// order, with micro or nanosecond timestamps, are understood, over
+// Ethernet, Linux cooked, raw IP, 802.11 (as written by ns-3's
+// YansWifiPhyHelper) and radiotap link types; IPv4 and IPv6 with
+// extension headers.  A fragmented datagram is replayed from its first
+// fragment, with the size in its UDP header; fragments after the first,
+// 802.11 retries and protected frames are skipped.
+//
+// PcapReplayApplication sends, from its node, the datagrams of one
+// captured source address (or all of them), each to the ns-3 address its
+// captured destination is mapped to, with the original payload size at
+// the original offset from the start of the application.  Each captured
+// flow (destination and ports) gets its own UDP socket.  Datagrams are
+// parsed BatchSize at a time into a small buffer; one event sends all the
+// datagrams due and is rescheduled for the next one, and the trace is only
+// touched again when the buffer runs out.  Given the offsets of its
+// records (SetRecords ()) the application parses only those, otherwise it
+// walks the whole trace and keeps its source's datagrams.
+//
+// PcapReplayHelper reads the trace once: it maps the captured addresses to
+// nodes, in order of first appearance unless Map () says otherwise, and
+// collects the record offsets of every captured source.  It then installs
+// one application per source, on its node, with those offsets.  The turn
+// skips the node of the other end of the datagram, and datagrams whose
+// destination still ends up on the sender's node are counted as unmapped
+// instead of sent, so that no replayed flow stays off the air.
+//
+//   PcapReplayHelper replay ("capture.pcap");
+//   ApplicationContainer apps = replay.Install (nodes, interfaces);
+//
+
+#ifndef PCAP_REPLAY_H
+#define PCAP_REPLAY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class PcapTrace : public SimpleRefCount<PcapTrace>
+{
+public:
+  /// A UDP datagram of the capture; the addresses point into the mapping.
+  struct Datagram
+  {
+    int64_t timeNs;            // since the first record
+    const uint8_t *source;
+    const uint8_t *destination;
+    uint8_t addressLength;     // 4 or 16
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint32_t payload;          // UDP payload bytes
+  };
+
+  /// Offset of the first record
+  static const uint64_t FILE_HEADER = 24;
+
+  /// \param filename classic (not pcapng) capture file
+  PcapTrace (std::string filename)
+    : m_data (0),
+      m_size (0),
+      m_swapped (false),
+      m_nanoseconds (false),
+      m_linkType (0),
+      m_firstNs (0)
+  {
+    int fd = open (filename.c_str (), O_RDONLY);
+    NS_ABORT_MSG_IF (fd < 0, "cannot read " << filename);
+    struct stat st;
+    NS_ABORT_MSG_IF (fstat (fd, &st) != 0 || st.st_size < (off_t) FILE_HEADER, filename << " is not a pcap file");
+    m_size = st.st_size;
+    void *data = mmap (0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    NS_ABORT_MSG_IF (data == MAP_FAILED, "cannot map " << filename);
+    madvise (data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const uint8_t *> (data);
+
+    uint32_t magic;
+    std::memcpy (&magic, m_data, 4);
+    switch (magic)
+      {
+      case 0xa1b2c3d4: break;
+      case 0xd4c3b2a1: m_swapped = true; break;
+      case 0xa1b23c4d: m_nanoseconds = true; break;
+      case 0x4d3cb2a1: m_swapped = true; m_nanoseconds = true; break;
+      default: NS_FATAL_ERROR (filename << " is not a classic pcap file");
+      }
+    m_linkType = Get32 (m_data + 20);
+    if (m_size >= FILE_HEADER + 16)
+      {
+        m_firstNs = GetTimeNs (m_data + FILE_HEADER);
+      }
+  }
+
+  ~PcapTrace ()
+  {
+    munmap (const_cast<uint8_t *> (m_data), m_size);
+  }
+
+  /**
+   * \brief Find the next UDP datagram.
+   * \param offset where to start; moved past the datagram's record
+   * \param d the datagram
+   * \return false at the end of the trace
+   */
+  bool Next (uint64_t &offset, Datagram &d) const
+  {
+    while (offset + 16 <= m_size)
+      {
+        const uint8_t *record = m_data + offset;
+        uint32_t captured = Get32 (record + 8);
+        if (offset + 16 + captured > m_size)
+          {
+            offset = m_size; // truncated last record
+            return false;
+          }
+        offset += 16 + captured;
+        if (ParseLink (record + 16, captured, d))
+          {
+            d.timeNs = GetTimeNs (record) - m_firstNs;
+            return true;
+          }
+      }
+    return false;
+  }
+
+  /// \return an address of the trace as text
+  static std::string Format (const uint8_t *address, uint8_t length)
+  {
+    std::ostringstream os;
+    if (length == 4)
+      {
+        os << Ipv4Address::Deserialize (address);
+      }
+    else
+      {
+        uint8_t bytes[16];
+        std::memcpy (bytes, address, 16);
+        os << Ipv6Address (bytes);
+      }
+    return os.str ();
+  }
+
+  /// \return an address as the raw bytes the trace holds (key of the maps)
+  static std::string Key (const uint8_t *address, uint8_t length)
+  {
+    return std::string (reinterpret_cast<const char *> (address), length);
+  }
+
+  /// \return raw bytes of an IPv4 or IPv6 address in text form
+  static std::string Key (std::string text)
+  {
+    uint8_t bytes[16];
+    if (text.find (':') != std::string::npos)
+      {
+        Ipv6Address (text.c_str ()).Serialize (bytes);
+        return Key (bytes, 16);
+      }
+    Ipv4Address (text.c_str ()).Serialize (bytes);
+    return Key (bytes, 4);
+  }
+
+private:
+  enum LinkType
+  {
+    LINK_ETHERNET = 1,
+    LINK_RAW = 101,
+    LINK_IEEE802_11 = 105,
+    LINK_LINUX_SLL = 113,
+    LINK_RADIOTAP = 127
+  };
+
+  static uint16_t Net16 (const uint8_t *p)
+  {
+    return (p[0] << 8) | p[1];
+  }
+
+  uint32_t Get32 (const uint8_t *p) const
+  {
+    uint32_t v;
+    std::memcpy (&v, p, 4);
+    if (m_swapped)
+      {
+        v = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+      }
+    return v;
+  }
+
+  int64_t GetTimeNs (const uint8_t *record) const
+  {
+    int64_t fraction = Get32 (record + 4);
+    return Get32 (record) * 1000000000LL + (m_nanoseconds ? fraction : fraction * 1000);
+  }
+
+  bool ParseLink (const uint8_t *p, uint32_t len, Datagram &d) const
+  {
+    switch (m_linkType)
+      {
+      case LINK_ETHERNET:
+        {
+          if (len < 14)
+            {
+              return false;
+            }
+          uint32_t header = 14;
+          uint16_t type = Net16 (p + 12);
+          if (type == 0x8100 && len >= 18)
+            {
+              header = 18;
+              type = Net16 (p + 16);
+            }
+          return ParseEtherType (type, p + header, len - header, d);
+        }
+      case LINK_LINUX_SLL:
+        return len >= 16 && ParseEtherType (Net16 (p + 14), p + 16, len - 16, d);
+      case LINK_RAW:
+        return len >= 1 && ParseEtherType ((p[0] >> 4) == 6 ? 0x86dd : 0x0800, p, len, d);
+      case LINK_RADIOTAP:
+        {
+          if (len < 4)
+            {
+              return false;
+            }
+          uint32_t header = p[2] | (p[3] << 8); // little endian
+          return len >= header && Parse80211 (p + header, len - header, d);
+        }
+      case LINK_IEEE802_11:
+        return Parse80211 (p, len, d);
+      default:
+        return false;
+      }
+  }
+
+  static bool Parse80211 (const uint8_t *p, uint32_t len, Datagram &d)
+  {
+    if (len < 24)
+      {
+        return false;
+      }
+    uint8_t type = (p[0] >> 2) & 0x3;
+    uint8_t subtype = p[0] >> 4;
+    uint8_t flags = p[1];
+    // Data frames carrying data, sent once, in the clear
+    if (type != 2 || (subtype & 0x4) || (flags & 0x08) || (flags & 0x40))
+      {
+        return false;
+      }
+    uint32_t header = 24;
+    if ((flags & 0x3) == 0x3)
+      {
+        header += 6; // fourth address
+      }
+    if (subtype & 0x8)
+      {
+        header += 2; // QoS control
+      }
+    // LLC/SNAP
+    if (len < header + 8 || p[header] != 0xaa || p[header + 1] != 0xaa || p[header + 2] != 0x03)
+      {
+        return false;
+      }
+    return ParseEtherType (Net16 (p + header + 6), p + header + 8, len - header - 8, d);
+  }
+
+  static bool ParseEtherType (uint16_t type, const uint8_t *p, uint32_t len, Datagram &d)
+  {
+    if (type == 0x0800)
+      {
+        if (len < 20 || (p[0] >> 4) != 4 || p[9] != 17)
+          {
+            return false;
+          }
+        uint32_t header = (p[0] & 0xf) * 4;
+        if ((Net16 (p + 6) & 0x1fff) != 0)
+          {
+            return false; // not the first fragment
+          }
+        d.source = p + 12;
+        d.destination = p + 16;
+        d.addressLength = 4;
+        return header >= 20 && ParseUdp (p + header, len > header ? len - header : 0, d);
+      }
+    if (type == 0x86dd)
+      {
+        if (len < 40 || (p[0] >> 4) != 6)
+          {
+            return false;
+          }
+        d.source = p + 8;
+        d.destination = p + 24;
+        d.addressLength = 16;
+        uint8_t next = p[6];
+        uint32_t header = 40;
+        // Hop-by-hop, routing, fragment and destination options
+        while ((next == 0 || next == 43 || next == 44 || next == 60) && len >= header + 8)
+          {
+            if (next == 44)
+              {
+                if ((Net16 (p + header + 2) & 0xfff8) != 0)
+                  {
+                    return false; // not the first fragment
+                  }
+                next = p[header];
+                header += 8;
+                continue;
+              }
+            next = p[header];
+            header += (p[header + 1] + 1) * 8;
+          }
+        return next == 17 && len >= header && ParseUdp (p + header, len - header, d);
+      }
+    return false;
+  }
+
+  static bool ParseUdp (const uint8_t *p, uint32_t len, Datagram &d)
+  {
+    if (len < 8 || Net16 (p + 4) < 8)
+      {
+        return false;
+      }
+    d.sourcePort = Net16 (p);
+    d.destinationPort = Net16 (p + 2);
+    d.payload = Net16 (p + 4) - 8;
+    return true;
+  }
+
+  const uint8_t *m_data;
+  uint64_t m_size;
+  bool m_swapped;
+  bool m_nanoseconds;
+  uint32_t m_linkType;
+  int64_t m_firstNs;
+};
+
+class PcapReplayApplication : public Application
+{
+public:
+  static TypeId GetTypeId (void);
+
+  PcapReplayApplication ();
+
+  /// Replay from an already mapped trace instead of opening File.
+  void SetTrace (Ptr<PcapTrace> trace);
+
+  /// Parse only these records of the trace, the datagrams of Source.
+  void SetRecords (const std::vector<uint64_t> &offsets);
+
+  /**
+   * \brief Send what the capture sent to an address to an ns-3 address.
+   * \param captured IPv4 or IPv6 address in the capture, as text
+   * \param destination Ipv4Address or Ipv6Address of the receiving node
+   */
+  void MapDestination (std::string captured, Address destination);
+
+  /// Write the datagrams sent and skipped on one line.
+  void Report (std::ostream &os) const;
+
+private:
+  struct Pending
+  {
+    int64_t timeNs;
+    uint32_t payload;
+    uint32_t flow;
+  };
+
+  struct Flow
+  {
+    Address destination;
+    uint16_t port;
+    Ptr<Socket> socket;
+  };
+
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+  virtual void DoDispose (void);
+
+  /// Parse the next BatchSize datagrams of the source.
+  void Prefetch (void);
+  /// Send the datagrams due and schedule the next one.
+  void Send (void);
+  uint32_t GetFlow (const PcapTrace::Datagram &d, const Address &destination);
+
+  std::string m_file;
+  std::string m_source;
+  uint32_t m_batchSize;
+  uint32_t m_maxPayload;
+
+  Ptr<PcapTrace> m_trace;
+  std::string m_sourceKey;                       // raw bytes, empty for all
+  std::map<std::string, Address> m_destinations; // by raw captured address
+  std::map<std::string, uint32_t> m_flowIndex;   // by raw address and ports
+  std::vector<Flow> m_flows;
+  std::vector<uint64_t> m_records;               // offsets, empty to walk all
+  size_t m_record;
+  uint64_t m_offset;
+  std::vector<Pending> m_batch;
+  size_t m_next;
+  Time m_origin;
+  EventId m_sendEvent;
+
+  uint64_t m_sent;
+  uint64_t m_bytes;
+  uint64_t m_unmapped;
+  uint64_t m_batches;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (PcapReplayApplication);
+
+TypeId
+PcapReplayApplication::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PcapReplayApplication")
+    .SetParent<Application> ()
+    .AddConstructor<PcapReplayApplication> ()
+    .AddAttribute ("File", "Capture to replay, unless SetTrace () was called.",
+                   StringValue (""),
+                   MakeStringAccessor (&PcapReplayApplication::m_file),
+                   MakeStringChecker ())
+    .AddAttribute ("Source", "Captured source address whose datagrams are sent (empty for all).",
+                   StringValue (""),
+                   MakeStringAccessor (&PcapReplayApplication::m_source),
+                   MakeStringChecker ())
+    .AddAttribute ("BatchSize", "Datagrams parsed ahead at a time.",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&PcapReplayApplication::m_batchSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxPayload", "Larger payloads are cut to this size.",
+                   UintegerValue (65000),
+                   MakeUintegerAccessor (&PcapReplayApplication::m_maxPayload),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+  return tid;
+}
+
+PcapReplayApplication::PcapReplayApplication ()
+  : m_batchSize (64),
+    m_maxPayload (65000),
+    m_record (0),
+    m_offset (PcapTrace::FILE_HEADER),
+    m_next (0),
+    m_sent (0),
+    m_bytes (0),
+    m_unmapped (0),
+    m_batches (0)
+{
+}
+
+void
+PcapReplayApplication::SetTrace (Ptr<PcapTrace> trace)
+{
+  m_trace = trace;
+}
+
+void
+PcapReplayApplication::SetRecords (const std::vector<uint64_t> &offsets)
+{
+  m_records = offsets;
+}
+
+void
+PcapReplayApplication::MapDestination (std::string captured, Address destination)
+{
+  m_destinations[PcapTrace::Key (captured)] = destination;
+}
+
+void
+PcapReplayApplication::DoDispose (void)
+{
+  m_flows.clear ();
+  m_trace = 0;
+  Application::DoDispose ();
+}
+
+void
+PcapReplayApplication::StartApplication (void)
+{
+  if (m_trace == 0)
+    {
+      NS_ABORT_MSG_IF (m_file.empty (), "PcapReplayApplication needs a File or a trace");
+      m_trace = Create<PcapTrace> (m_file);
+    }
+  m_sourceKey = m_source.empty () ? "" : PcapTrace::Key (m_source);
+  m_origin = Simulator::Now ();
+  m_record = 0;
+  m_offset = PcapTrace::FILE_HEADER;
+  Prefetch ();
+  if (m_next < m_batch.size ())
+    {
+      m_sendEvent = Simulator::Schedule (std::max (Seconds (0), m_origin + NanoSeconds (m_batch[m_next].timeNs) - Simulator::Now ()),
+                                         &PcapReplayApplication::Send, this);
+    }
+}
+
+void
+PcapReplayApplication::StopApplication (void)
+{
+  Simulator::Cancel (m_sendEvent);
+  for (size_t i = 0; i < m_flows.size (); i++)
+    {
+      if (m_flows[i].socket)
+        {
+          m_flows[i].socket->Close ();
+        }
+    }
+}
+
+void
+PcapReplayApplication::Prefetch (void)
+{
+  m_batch.clear ();
+  m_next = 0;
+  PcapTrace::Datagram d;
+  while (m_batch.size () < m_batchSize)
+    {
+      if (!m_records.empty ())
+        {
+          // Indexed by the helper: only the records of this source
+          if (m_record == m_records.size ())
+            {
+              break;
+            }
+          uint64_t offset = m_records[m_record++];
+          if (!m_trace->Next (offset, d))
+            {
+              break;
+            }
+        }
+      else
+        {
+          if (!m_trace->Next (m_offset, d))
+            {
+              break;
+            }
+          if (!m_sourceKey.empty ()
+              && (d.addressLength != m_sourceKey.size () || std::memcmp (d.source, m_sourceKey.data (), d.addressLength) != 0))
+            {
+              continue;
+            }
+        }
+      std::map<std::string, Address>::const_iterator destination =
+        m_destinations.find (PcapTrace::Key (d.destination, d.addressLength));
+      if (destination == m_destinations.end ())
+        {
+          m_unmapped++;
+          continue;
+        }
+      Pending p;
+      p.timeNs = d.timeNs;
+      p.payload = std::min (d.payload, m_maxPayload);
+      p.flow = GetFlow (d, destination->second);
+      m_batch.push_back (p);
+    }
+  if (!m_batch.empty ())
+    {
+      m_batches++;
+    }
+}
+
+uint32_t
+PcapReplayApplication::GetFlow (const PcapTrace::Datagram &d, const Address &destination)
+{
+  std::string key = PcapTrace::Key (d.destination, d.addressLength);
+  key.append (reinterpret_cast<const char *> (&d.sourcePort), sizeof (d.sourcePort));
+  key.append (reinterpret_cast<const char *> (&d.destinationPort), sizeof (d.destinationPort));
+  std::map<std::string, uint32_t>::iterator i = m_flowIndex.find (key);
+  if (i != m_flowIndex.end ())
+    {
+      return i->second;
+    }
+  Flow flow;
+  flow.destination = destination;
+  flow.port = d.destinationPort;
+  m_flows.push_back (flow);
+  m_flowIndex[key] = m_flows.size () - 1;
+  return m_flows.size () - 1;
+}
+
+void
+PcapReplayApplication::Send (void)
+{
+  while (true)
+    {
+      if (m_next == m_batch.size ())
+        {
+          Prefetch ();
+          if (m_batch.empty ())
+            {
+              return; // end of the trace
+            }
+        }
+      const Pending &p = m_batch[m_next];
+      Time due = m_origin + NanoSeconds (p.timeNs);
+      if (due > Simulator::Now ())
+        {
+          m_sendEvent = Simulator::Schedule (due - Simulator::Now (), &PcapReplayApplication::Send, this);
+          return;
+        }
+      Flow &flow = m_flows[p.flow];
+      if (flow.socket == 0)
+        {
+          flow.socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+          if (Ipv6Address::IsMatchingType (flow.destination))
+            {
+              flow.socket->Bind6 ();
+              flow.socket->Connect (Inet6SocketAddress (Ipv6Address::ConvertFrom (flow.destination), flow.port));
+            }
+          else
+            {
+              flow.socket->Bind ();
+              flow.socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom (flow.destination), flow.port));
+            }
+        }
+      flow.socket->Send (Create<Packet> (p.payload));
+      m_sent++;
+      m_bytes += p.payload;
+      m_next++;
+    }
+}
+
+void
+PcapReplayApplication::Report (std::ostream &os) const
+{
+  os << "PCAP node=" << GetNode ()->GetId ()
+     << " source=" << (m_source.empty () ? "*" : m_source)
+     << " flows=" << m_flows.size ()
+     << " sent=" << m_sent
+     << " bytes=" << m_bytes
+     << " unmapped=" << m_unmapped
+     << " batches=" << m_batches
+     << std::endl;
+}
+
+class PcapReplayHelper
+{
+public:
+  /// \param filename capture to replay; mapped once for all applications
+  PcapReplayHelper (std::string filename)
+    : m_trace (Create<PcapTrace> (filename))
+  {
+  }
+
+  /// Put a captured address on node index node of the Install () container.
+  void Map (std::string captured, uint32_t node)
+  {
+    m_map[PcapTrace::Key (captured)] = node;
+  }
+
+  /**
+   * \brief One PcapReplayApplication per captured source address.
+   *
+   * Addresses not given to Map () go to the nodes in turn, in order of
+   * first appearance in the capture, skipping the node of the other end
+   * of the datagram.  Destinations on the source's own node are left out
+   * of its application.
+   * \param nodes nodes standing for the captured hosts
+   * \param interfaces interface i belongs to node i; its first global
+   *        address receives what was sent to the host
+   */
+  ApplicationContainer Install (NodeContainer nodes, Ipv6InterfaceContainer interfaces)
+  {
+    NS_ABORT_MSG_IF (nodes.GetN () < 2, "PcapReplayHelper needs two nodes or more");
+    std::map<std::string, uint32_t> map (m_map);
+    std::map<std::string, uint32_t> sourceIndex;
+    std::vector<std::string> sources;
+    std::vector<std::vector<uint64_t> > records; // by source index
+    uint32_t next = 0;
+    uint64_t offset = PcapTrace::FILE_HEADER;
+    PcapTrace::Datagram d;
+    while (true)
+      {
+        uint64_t record = offset;
+        if (!m_trace->Next (offset, d))
+          {
+            break;
+          }
+        std::string source = PcapTrace::Key (d.source, d.addressLength);
+        std::string destination = PcapTrace::Key (d.destination, d.addressLength);
+        std::map<std::string, uint32_t>::iterator s = map.find (source);
+        std::map<std::string, uint32_t>::iterator t = map.find (destination);
+        if (s == map.end ())
+          {
+            s = map.insert (std::make_pair (source, Turn (next, t == map.end () ? nodes.GetN () : t->second, nodes.GetN ()))).first;
+          }
+        if (map.find (destination) == map.end ())
+          {
+            map[destination] = Turn (next, s->second, nodes.GetN ());
+          }
+        std::map<std::string, uint32_t>::iterator i = sourceIndex.find (source);
+        if (i == sourceIndex.end ())
+          {
+            i = sourceIndex.insert (std::make_pair (source, sources.size ())).first;
+            sources.push_back (source);
+            records.push_back (std::vector<uint64_t> ());
+          }
+        records[i->second].push_back (record);
+      }
+
+    ApplicationContainer apps;
+    for (size_t s = 0; s < sources.size (); s++)
+      {
+        uint32_t node = map[sources[s]];
+        Ptr<PcapReplayApplication> app = CreateObjectWithAttributes<PcapReplayApplication>
+            ("Source", StringValue (Format (sources[s])));
+        app->SetTrace (m_trace);
+        app->SetRecords (records[s]);
+        for (std::map<std::string, uint32_t>::const_iterator m = map.begin (); m != map.end (); m++)
+          {
+            if (m->second != node)
+              {
+                app->MapDestination (Format (m->first), GetGlobalAddress (interfaces, m->second));
+              }
+          }
+        nodes.Get (node)->AddApplication (app);
+        apps.Add (app);
+      }
+    return apps;
+  }
+
+private:
+  /// \return the next node in turn, other than avoid
+  static uint32_t Turn (uint32_t &next, uint32_t avoid, uint32_t n)
+  {
+    uint32_t node = next++ % n;
+    if (node == avoid)
+      {
+        node = next++ % n;
+      }
+    return node;
+  }
+
+  static std::string Format (const std::string &key)
+  {
+    return PcapTrace::Format (reinterpret_cast<const uint8_t *> (key.data ()), key.size ());
+  }
+
+  static Ipv6Address GetGlobalAddress (Ipv6InterfaceContainer interfaces, uint32_t i)
+  {
+    std::pair<Ptr<Ipv6>, uint32_t> interface = interfaces.Get (i);
+    for (uint32_t a = 0; a < interface.first->GetNAddresses (interface.second); a++)
+      {
+        Ipv6InterfaceAddress address = interface.first->GetAddress (interface.second, a);
+        if (address.GetScope () == Ipv6InterfaceAddress::GLOBAL)
+          {
+            return address.GetAddress ();
+          }
+      }
+    NS_FATAL_ERROR ("interface " << i << " has no global address");
+    return Ipv6Address ();
+  }
+
+  Ptr<PcapTrace> m_trace;
+  std::map<std::string, uint32_t> m_map; // raw captured address -> node index
+};
+
+} // namespace ns3
+
+#endif /* PCAP_REPLAY_H */
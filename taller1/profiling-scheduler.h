@@ -0,0 +1,572 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Opt-in instrumentation of the simulator event loop.
+//
+// ProfilingScheduler wraps a MapScheduler and measures the wall time spent
+// in every event that DefaultSimulatorImpl removes from the queue.  The
+// simulator loop calls RemoveNext () right before invoking an event and
+// IsEmpty () right after it returns, so the time between those two calls is
+// the cost of the event (including whatever it scheduled).  Samples are
+// attributed to the function the event calls and to the node context given
+// to ScheduleWithContext.
+//
+// The callback is identified by the typeid of the EventImpl.  For events
+// built by MakeEvent that is the signature of the bound function, e.g.
+// "void (ns3::MacLow::*)()": methods of one class with the same signature
+// share a line of the report.  Nothing but the type of the event is read,
+// so the report does not depend on the layout of ns-3's event classes or
+// on the compiler ABI.
+//
+// When the simulator is destroyed the scheduler is released and writes:
+//  - a report sorted by total wall time, per callback and per node;
+//  - a collapsed stack file ("node-N;callback <usec>") that can be fed to
+//    flamegraph.pl.
+//
+// Usage, before Simulator::Run ():
+//
+//   ProfilingScheduler::Enable ("taller1.profile", "taller1.folded");
+//
+// Benchmarks only need the number of executed events; EnableCounting ()
+// installs the scheduler with MeasureTime=false, which skips the clock
+// reads and writes no report.
+//
+// With TagAllocations=true every event also sets the allocation tag of
+// alloc-stats.h to its node context and to a subsystem guessed from the
+// callback's class (PHY, MAC, IPv6, OLSR6, mobility, ...), so that memory
+// accounting can charge heap growth to the node and layer that caused it.
+// The tag in force before the event is restored when the event returns.
+//
+
+#ifndef PROFILING_SCHEDULER_H
+#define PROFILING_SCHEDULER_H
+
+#include "ns3/core-module.h"
+#include "ns3/map-scheduler.h"
+#include "alloc-stats.h"
+
+#include <cxxabi.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+
+namespace ns3 {
+
+class ProfilingScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  ProfilingScheduler ();
+  virtual ~ProfilingScheduler ();
+
+  /**
+   * \brief Install a ProfilingScheduler as the simulator scheduler.
+   * \param reportFile sorted text report written at Simulator::Destroy
+   * \param stackFile collapsed stacks for flame graphs
+   */
+  static void Enable (std::string reportFile, std::string stackFile);
+
+  /**
+   * \brief Install a ProfilingScheduler that only counts executed events.
+   */
+  static void EnableCounting (void);
+
+  /// \return events executed under any ProfilingScheduler in this process
+  static uint64_t GetTotalEvents (void);
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+  /// \return number of events measured so far
+  uint64_t GetEventCount (void) const;
+
+private:
+  /// Dynamic type of the event
+  typedef std::type_index CallbackId;
+  struct Key
+  {
+    CallbackId callback;
+    uint32_t context;
+    bool operator < (const Key &o) const
+    {
+      return callback < o.callback || (callback == o.callback && context < o.context);
+    }
+  };
+  struct Sample
+  {
+    Sample () : count (0), usec (0) {}
+    uint64_t count;
+    double usec;
+  };
+
+  static double NowUsec (void);
+  static std::string Demangle (const char *name);
+  static std::string SignatureName (const std::type_index &type);
+  static std::string CallbackName (const CallbackId &callback);
+  static std::string ContextName (uint32_t context);
+  static AllocAccounting::Subsystem Classify (const std::string &name);
+  CallbackId Identify (const EventImpl *impl);
+  void TagEvent (const Event &ev, const CallbackId &callback);
+  void UntagEvent (void) const;
+  void CloseEvent (void) const;
+  void Finish (void);
+  void WriteReports (void) const;
+  static uint64_t &TotalEvents (void);
+
+  Ptr<Scheduler> m_events;
+  bool m_measureTime;
+  bool m_tagAllocations;
+  std::map<CallbackId, AllocAccounting::Subsystem> m_subsystems;
+  std::string m_reportFile;
+  std::string m_stackFile;
+
+  mutable bool m_tagged;
+  AllocAccounting::Subsystem m_savedSubsystem;
+  uint32_t m_savedNode;
+  mutable bool m_open;
+  mutable Key m_current;
+  mutable double m_start;
+  mutable std::map<Key, Sample> m_samples;
+  mutable uint64_t m_eventCount;
+  double m_created;
+  bool m_finished;
+  EventId m_finishEvent;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingScheduler);
+
+TypeId
+ProfilingScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ProfilingScheduler")
+    .SetParent<Scheduler> ()
+    .SetGroupName ("Core")
+    .AddConstructor<ProfilingScheduler> ()
+    .AddAttribute ("ReportFile", "Sorted per-callback/per-node report.",
+                   StringValue ("simulator.profile"),
+                   MakeStringAccessor (&ProfilingScheduler::m_reportFile),
+                   MakeStringChecker ())
+    .AddAttribute ("StackFile", "Collapsed stacks for flamegraph.pl.",
+                   StringValue ("simulator.folded"),
+                   MakeStringAccessor (&ProfilingScheduler::m_stackFile),
+                   MakeStringChecker ())
+    .AddAttribute ("MeasureTime", "Time every event; when false only count them.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&ProfilingScheduler::m_measureTime),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TagAllocations", "Charge heap allocations of each event to "
+                   "its node and subsystem (see alloc-stats.h).",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&ProfilingScheduler::m_tagAllocations),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+ProfilingScheduler::ProfilingScheduler ()
+  : m_events (CreateObject<MapScheduler> ()),
+    m_measureTime (true),
+    m_tagAllocations (false),
+    m_tagged (false),
+    m_savedSubsystem (AllocAccounting::OTHER),
+    m_savedNode (AllocAccounting::NO_NODE),
+    m_open (false),
+    m_current ({CallbackId (typeid (void)), 0}),
+    m_start (0),
+    m_eventCount (0),
+    m_created (NowUsec ()),
+    m_finished (false)
+{
+  // Destroy events run before the remaining queue is drained, so anything
+  // removed after this point is discarded rather than executed.
+  m_finishEvent = Simulator::ScheduleDestroy (&ProfilingScheduler::Finish, this);
+}
+
+ProfilingScheduler::~ProfilingScheduler ()
+{
+  if (!m_finished)
+    {
+      // Replaced by another SetScheduler () before the end of the run
+      Simulator::Cancel (m_finishEvent);
+    }
+  Finish ();
+}
+
+void
+ProfilingScheduler::Finish (void)
+{
+  if (m_finished)
+    {
+      return;
+    }
+  CloseEvent ();
+  UntagEvent ();
+  if (m_measureTime)
+    {
+      WriteReports ();
+    }
+  m_finished = true;
+}
+
+void
+ProfilingScheduler::Enable (std::string reportFile, std::string stackFile)
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::ProfilingScheduler");
+  factory.Set ("ReportFile", StringValue (reportFile));
+  factory.Set ("StackFile", StringValue (stackFile));
+  Simulator::SetScheduler (factory);
+}
+
+void
+ProfilingScheduler::EnableCounting (void)
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::ProfilingScheduler");
+  factory.Set ("MeasureTime", BooleanValue (false));
+  Simulator::SetScheduler (factory);
+}
+
+uint64_t &
+ProfilingScheduler::TotalEvents (void)
+{
+  static uint64_t total = 0;
+  return total;
+}
+
+uint64_t
+ProfilingScheduler::GetTotalEvents (void)
+{
+  return TotalEvents ();
+}
+
+void
+ProfilingScheduler::Insert (const Event &ev)
+{
+  m_events->Insert (ev);
+}
+
+bool
+ProfilingScheduler::IsEmpty (void) const
+{
+  // The simulator loop checks for emptiness right after each event.
+  CloseEvent ();
+  UntagEvent ();
+  return m_events->IsEmpty ();
+}
+
+Scheduler::Event
+ProfilingScheduler::PeekNext (void) const
+{
+  return m_events->PeekNext ();
+}
+
+Scheduler::Event
+ProfilingScheduler::RemoveNext (void)
+{
+  CloseEvent ();
+  UntagEvent ();
+  Event ev = m_events->RemoveNext ();
+  if (m_finished || ev.impl->IsCancelled ())
+    {
+      return ev;
+    }
+  if (!m_measureTime && !m_tagAllocations)
+    {
+      m_eventCount++;
+      TotalEvents ()++;
+      return ev;
+    }
+  CallbackId callback = Identify (ev.impl);
+  if (m_tagAllocations)
+    {
+      TagEvent (ev, callback);
+    }
+  if (!m_measureTime)
+    {
+      m_eventCount++;
+      TotalEvents ()++;
+    }
+  else
+    {
+      m_current.callback = callback;
+      m_current.context = ev.key.m_context;
+      m_open = true;
+      m_start = NowUsec ();
+    }
+  return ev;
+}
+
+void
+ProfilingScheduler::Remove (const Event &ev)
+{
+  m_events->Remove (ev);
+}
+
+uint64_t
+ProfilingScheduler::GetEventCount (void) const
+{
+  return m_eventCount;
+}
+
+double
+ProfilingScheduler::NowUsec (void)
+{
+  // Monotonic: wall clock adjustments must not show up as event time
+  return std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+void
+ProfilingScheduler::CloseEvent (void) const
+{
+  if (!m_open)
+    {
+      return;
+    }
+  Sample &s = m_samples[m_current];
+  s.count++;
+  s.usec += NowUsec () - m_start;
+  m_eventCount++;
+  TotalEvents ()++;
+  m_open = false;
+}
+
+std::string
+ProfilingScheduler::Demangle (const char *name)
+{
+  int status = 0;
+  char *demangled = abi::__cxa_demangle (name, 0, 0, &status);
+  if (status != 0 || demangled == 0)
+    {
+      return name;
+    }
+  std::string result (demangled);
+  std::free (demangled);
+  return result;
+}
+
+std::string
+ProfilingScheduler::SignatureName (const std::type_index &type)
+{
+  // Events built by MakeEvent are local classes of the MakeEvent template,
+  // so the first template argument is the type of the bound function, e.g.
+  // "void (ns3::YansWifiPhy::*)(ns3::Ptr<ns3::Packet>, double, ...)".
+  std::string name = Demangle (type.name ());
+  std::string::size_type begin = name.find ("MakeEvent<");
+  if (begin == std::string::npos)
+    {
+      return name;
+    }
+  begin += 10;
+  int depth = 0;
+  std::string::size_type end = begin;
+  for (; end < name.size (); end++)
+    {
+      char c = name[end];
+      if (c == '<' || c == '(')
+        {
+          depth++;
+        }
+      else if (c == '>' || c == ')')
+        {
+          if (depth == 0)
+            {
+              break;
+            }
+          depth--;
+        }
+      else if (c == ',' && depth == 0)
+        {
+          break;
+        }
+    }
+  return name.substr (begin, end - begin);
+}
+
+ProfilingScheduler::CallbackId
+ProfilingScheduler::Identify (const EventImpl *impl)
+{
+  return CallbackId (typeid (*impl));
+}
+
+std::string
+ProfilingScheduler::CallbackName (const CallbackId &callback)
+{
+  return SignatureName (callback);
+}
+
+void
+ProfilingScheduler::TagEvent (const Event &ev, const CallbackId &callback)
+{
+  std::map<CallbackId, AllocAccounting::Subsystem>::const_iterator i = m_subsystems.find (callback);
+  AllocAccounting::Subsystem subsystem;
+  if (i == m_subsystems.end ())
+    {
+      subsystem = Classify (CallbackName (callback));
+      m_subsystems.insert (std::make_pair (callback, subsystem));
+    }
+  else
+    {
+      subsystem = i->second;
+    }
+  uint32_t context = ev.key.m_context;
+  m_savedSubsystem = AllocAccounting::GetSubsystem ();
+  m_savedNode = AllocAccounting::GetNode ();
+  m_tagged = true;
+  AllocAccounting::SetTag (subsystem, context == Simulator::NO_CONTEXT ? AllocAccounting::NO_NODE : context);
+}
+
+void
+ProfilingScheduler::UntagEvent (void) const
+{
+  if (!m_tagged)
+    {
+      return;
+    }
+  AllocAccounting::SetTag (m_savedSubsystem, m_savedNode);
+  m_tagged = false;
+}
+
+AllocAccounting::Subsystem
+ProfilingScheduler::Classify (const std::string &name)
+{
+  struct Rule
+  {
+    const char *pattern;
+    AllocAccounting::Subsystem subsystem;
+  };
+  static const Rule rules[] = {
+    { "AnimationInterface", AllocAccounting::ANIMATION },
+    { "Pcap", AllocAccounting::TRACING },
+    { "Ascii", AllocAccounting::TRACING },
+    { "olsr6::", AllocAccounting::OLSR6 },
+    { "WifiPhy", AllocAccounting::WIFI_PHY },
+    { "WifiChannel", AllocAccounting::WIFI_PHY },
+    { "InterferenceHelper", AllocAccounting::WIFI_PHY },
+    { "MacLow", AllocAccounting::WIFI_MAC },
+    { "DcfManager", AllocAccounting::WIFI_MAC },
+    { "DcaTxop", AllocAccounting::WIFI_MAC },
+    { "EdcaTxopN", AllocAccounting::WIFI_MAC },
+    { "WifiMac", AllocAccounting::WIFI_MAC },
+    { "BlockAck", AllocAccounting::WIFI_MAC },
+    { "WifiNetDevice", AllocAccounting::WIFI_MAC },
+    { "Ipv6", AllocAccounting::IPV6 },
+    { "Icmpv6", AllocAccounting::IPV6 },
+    { "Ndisc", AllocAccounting::IPV6 },
+    { "Udp", AllocAccounting::IPV6 },
+    { "Mobility", AllocAccounting::MOBILITY },
+    { "Application", AllocAccounting::APPLICATIONS },
+    { "OnOff", AllocAccounting::APPLICATIONS },
+    { "Socket", AllocAccounting::APPLICATIONS },
+  };
+  for (std::size_t i = 0; i < sizeof (rules) / sizeof (rules[0]); i++)
+    {
+      if (name.find (rules[i].pattern) != std::string::npos)
+        {
+          return rules[i].subsystem;
+        }
+    }
+  return AllocAccounting::OTHER;
+}
+
+std::string
+ProfilingScheduler::ContextName (uint32_t context)
+{
+  if (context == Simulator::NO_CONTEXT)
+    {
+      return "global";
+    }
+  std::ostringstream oss;
+  oss << "node-" << context;
+  return oss.str ();
+}
+
+void
+ProfilingScheduler::WriteReports (void) const
+{
+  // Functions reached through several event types are reported once
+  std::map<CallbackId, std::string> names;
+  std::map<std::string, Sample> byCallback;
+  std::map<uint32_t, Sample> byContext;
+  double total = 0;
+  for (std::map<Key, Sample>::const_iterator i = m_samples.begin (); i != m_samples.end (); i++)
+    {
+      std::map<CallbackId, std::string>::iterator name = names.find (i->first.callback);
+      if (name == names.end ())
+        {
+          name = names.insert (std::make_pair (i->first.callback, CallbackName (i->first.callback))).first;
+        }
+      Sample &cb = byCallback[name->second];
+      cb.count += i->second.count;
+      cb.usec += i->second.usec;
+      Sample &ctx = byContext[i->first.context];
+      ctx.count += i->second.count;
+      ctx.usec += i->second.usec;
+      total += i->second.usec;
+    }
+
+  std::vector<std::pair<double, std::string> > callbacks;
+  for (std::map<std::string, Sample>::const_iterator i = byCallback.begin (); i != byCallback.end (); i++)
+    {
+      callbacks.push_back (std::make_pair (i->second.usec, i->first));
+    }
+  std::sort (callbacks.rbegin (), callbacks.rend ());
+  std::vector<std::pair<double, uint32_t> > contexts;
+  for (std::map<uint32_t, Sample>::const_iterator i = byContext.begin (); i != byContext.end (); i++)
+    {
+      contexts.push_back (std::make_pair (i->second.usec, i->first));
+    }
+  std::sort (contexts.rbegin (), contexts.rend ());
+
+  std::ofstream report (m_reportFile.c_str ());
+  report << "# events: " << m_eventCount
+         << "  event time: " << total / 1e6 << " s"
+         << "  wall time: " << (NowUsec () - m_created) / 1e6 << " s" << std::endl;
+  report << std::endl << "# per callback" << std::endl;
+  report << "total_ms\tshare\tcount\tmean_us\tcallback" << std::endl;
+  for (std::vector<std::pair<double, std::string> >::const_iterator i = callbacks.begin (); i != callbacks.end (); i++)
+    {
+      const Sample &s = byCallback[i->second];
+      report << std::fixed << std::setprecision (3)
+             << s.usec / 1e3 << "\t"
+             << std::setprecision (1) << (total > 0 ? 100 * s.usec / total : 0) << "%\t"
+             << s.count << "\t"
+             << std::setprecision (3) << s.usec / s.count << "\t"
+             << i->second << std::endl;
+    }
+  report << std::endl << "# per node context" << std::endl;
+  report << "total_ms\tshare\tcount\tmean_us\tcontext" << std::endl;
+  for (std::vector<std::pair<double, uint32_t> >::const_iterator i = contexts.begin (); i != contexts.end (); i++)
+    {
+      const Sample &s = byContext[i->second];
+      report << std::fixed << std::setprecision (3)
+             << s.usec / 1e3 << "\t"
+             << std::setprecision (1) << (total > 0 ? 100 * s.usec / total : 0) << "%\t"
+             << s.count << "\t"
+             << std::setprecision (3) << s.usec / s.count << "\t"
+             << ContextName (i->second) << std::endl;
+    }
+
+  std::ofstream stacks (m_stackFile.c_str ());
+  for (std::map<Key, Sample>::const_iterator i = m_samples.begin (); i != m_samples.end (); i++)
+    {
+      stacks << ContextName (i->first.context) << ";"
+             << names[i->first.callback] << " "
+             << static_cast<uint64_t> (i->second.usec + 0.5) << std::endl;
+    }
+}
+
+} // namespace ns3
+
+#endif /* PROFILING_SCHEDULER_H */
@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Rate control counters for Wi-Fi devices: retries, final failures and the
+// rate chosen for every unicast data frame, per link.
+//
+// The remote station manager of each device fires MacTxDataFailed when a
+// data frame is not acknowledged (a retry follows) and
+// MacTxFinalDataFailed when it gives up on it; RTS failures are counted
+// the same way.  The PHY's MonitorSnifferTx trace carries the TxVector of
+// every frame sent, so the mode the manager picked is taken from there and
+// binned per (node, receiver MAC) link; data_frames counts first
+// transmissions only.  Broadcasts (OLSR6 control) go out at
+// NonUnicastMode and are left out of the histograms.
+//
+
+#ifndef RATE_STATS_H
+#define RATE_STATS_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace ns3 {
+
+class RateStats
+{
+public:
+  RateStats ()
+    : m_dataFailed (0),
+      m_finalDataFailed (0),
+      m_rtsFailed (0),
+      m_frames (0)
+  {
+  }
+
+  /**
+   * \brief Follow the rate decisions of Wi-Fi devices.
+   * \param devices WifiNetDevices (other devices are skipped)
+   */
+  void Install (NetDeviceContainer devices)
+  {
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+      {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (*i);
+        if (device == 0)
+          {
+            continue;
+          }
+        std::ostringstream context;
+        context << device->GetNode ()->GetId ();
+        Ptr<WifiRemoteStationManager> manager = device->GetRemoteStationManager ();
+        manager->TraceConnectWithoutContext ("MacTxDataFailed", MakeBoundCallback (&RateStats::Count, &m_dataFailed));
+        manager->TraceConnectWithoutContext ("MacTxFinalDataFailed", MakeBoundCallback (&RateStats::Count, &m_finalDataFailed));
+        manager->TraceConnectWithoutContext ("MacTxRtsFailed", MakeBoundCallback (&RateStats::Count, &m_rtsFailed));
+        device->GetPhy ()->TraceConnect ("MonitorSnifferTx", context.str (), MakeCallback (&RateStats::SnifferTx, this));
+      }
+  }
+
+  /// Print the totals on one line.
+  void Report (std::ostream &os, std::string manager) const
+  {
+    os << "RATES manager=" << manager
+       << " data_frames=" << m_frames
+       << " data_retries=" << m_dataFailed
+       << " data_drops=" << m_finalDataFailed
+       << " rts_retries=" << m_rtsFailed
+       << std::endl;
+  }
+
+  /// Write one line per link and mode: frames sent at that mode.
+  void WriteHistograms (std::ostream &os) const
+  {
+    os << "# node\tpeer\tmode\tframes" << std::endl;
+    for (std::map<Link, std::map<std::string, uint64_t> >::const_iterator l = m_histograms.begin ();
+         l != m_histograms.end (); l++)
+      {
+        for (std::map<std::string, uint64_t>::const_iterator m = l->second.begin (); m != l->second.end (); m++)
+          {
+            os << l->first.first << "\t" << l->first.second << "\t" << m->first << "\t" << m->second << std::endl;
+          }
+      }
+  }
+
+private:
+  typedef std::pair<uint32_t, Mac48Address> Link;
+
+  static void Count (uint64_t *counter, Mac48Address peer)
+  {
+    (*counter)++;
+  }
+
+  void SnifferTx (std::string context, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                  uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                  WifiTxVector txVector, struct mpduInfo aMpdu)
+  {
+    WifiMacHeader header;
+    packet->PeekHeader (header);
+    if (!header.IsData () || header.GetAddr1 ().IsGroup ())
+      {
+        return;
+      }
+    // data_frames counts frames, not attempts: retransmissions carry the
+    // Retry bit and are already in data_retries.  The histograms bin every
+    // attempt, since the manager picks a mode for each.
+    if (!header.IsRetry ())
+      {
+        m_frames++;
+      }
+    Link link (atoi (context.c_str ()), header.GetAddr1 ());
+    m_histograms[link][txVector.GetMode ().GetUniqueName ()]++;
+  }
+
+  uint64_t m_dataFailed;
+  uint64_t m_finalDataFailed;
+  uint64_t m_rtsFailed;
+  uint64_t m_frames;
+  std::map<Link, std::map<std::string, uint64_t> > m_histograms;
+};
+
+} // namespace ns3
+
+#endif /* RATE_STATS_H */
@@ -0,0 +1,95 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Headless benchmark summary for the scenario scripts.
+//
+// A scenario run with --bench=1 calls Start () right after parsing the
+// command line, SetupDone () before Simulator::Run () and Report () after
+// Simulator::Destroy ().  Report () prints a single line that
+// bench/run-benchmarks.sh parses and compares against bench/baselines.txt:
+//
+//   BENCH scenario=taller1 nodes=25 setup_s=0.12 run_s=3.40 events=123456
+//         events_per_s=36310 peak_rss_kb=51200 allocs=998877
+//
+// allocs is only counted in builds with ALLOC_STATS defined (see
+// alloc-stats.h) and is 0 otherwise; the peak RSS of such builds includes
+// the accounting header of every block, so baselines are taken without it.
+//
+
+#ifndef SCENARIO_BENCH_H
+#define SCENARIO_BENCH_H
+
+#include "ns3/core-module.h"
+#include "alloc-stats.h"
+#include "profiling-scheduler.h"
+
+#include <sys/resource.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace ns3 {
+
+class ScenarioBench
+{
+public:
+  ScenarioBench (std::string scenario)
+    : m_scenario (scenario),
+      m_enabled (false),
+      m_start (0),
+      m_setupDone (0)
+  {
+  }
+
+  /// Start timing the setup phase and count executed events.
+  void Start (void)
+  {
+    m_enabled = true;
+    m_start = NowSeconds ();
+    ProfilingScheduler::EnableCounting ();
+  }
+
+  /// Mark the end of topology construction.
+  void SetupDone (void)
+  {
+    m_setupDone = NowSeconds ();
+  }
+
+  /// \return seconds on a monotonic clock, for timing phases
+  static double NowSeconds (void)
+  {
+    return std::chrono::duration<double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+  }
+
+  /// Print the BENCH line; does nothing unless Start () was called.
+  void Report (uint32_t nodes) const
+  {
+    if (!m_enabled)
+      {
+        return;
+      }
+    double end = NowSeconds ();
+    double run = end - m_setupDone;
+    uint64_t events = ProfilingScheduler::GetTotalEvents ();
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    std::cout << "BENCH scenario=" << m_scenario
+              << " nodes=" << nodes
+              << " setup_s=" << m_setupDone - m_start
+              << " run_s=" << run
+              << " events=" << events
+              << " events_per_s=" << (run > 0 ? events / run : 0)
+              << " peak_rss_kb=" << usage.ru_maxrss
+              << " allocs=" << AllocStats::Get ().allocations
+              << std::endl;
+  }
+
+private:
+  std::string m_scenario;
+  bool m_enabled;
+  double m_start;
+  double m_setupDone;
+};
+
+} // namespace ns3
+
+#endif /* SCENARIO_BENCH_H */
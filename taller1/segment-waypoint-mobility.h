@@ -0,0 +1,373 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Random waypoint mobility evaluated on demand, with a batch position query.
+//
+// RandomWaypointMobilityModel schedules an event at the start and at the
+// end of every walk, and every GetPosition () goes through its
+// ConstantVelocityHelper.  SegmentWaypointMobilityModel keeps the current
+// segment of the node (start position and time, velocity, arrival time and
+// end of the pause that follows) and a position is
+//
+//   p = p0 + v * (min (now, arrival) - t0)
+//
+// One event per segment, at its start, draws the next walk and fires
+// CourseChange, so listeners such as MobilityTraceRecorder see every
+// segment at the time it begins; a query at that same time that comes
+// first draws it instead and moves the event.
+//
+// The segments of all the models live in one structure-of-arrays table,
+// so GetPositions () fills the positions of every node at the current time
+// in a single loop the compiler can vectorize, instead of one virtual
+// call chain per node.
+//
+// Like RandomWaypoint the model starts with a pause, then walks at Speed to
+// a destination from PositionAllocator and pauses for Pause.  The walk
+// and its pause are drawn together, so when Speed, Pause or the allocator
+// are shared between nodes the interleaving of the draws, and with it the
+// trajectories, differ from RandomWaypoint and can depend on queries made
+// at a start time.  Give every node its own random variables and allocator
+// (one MobilityHelper::SetMobilityModel per node) to make them
+// reproducible.
+//
+
+#ifndef SEGMENT_WAYPOINT_MOBILITY_H
+#define SEGMENT_WAYPOINT_MOBILITY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace ns3 {
+
+class SegmentWaypointMobilityModel;
+
+/// Positions of several nodes at one time, one array per coordinate.
+struct PositionBatch
+{
+  std::vector<uint32_t> node;
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+};
+
+/**
+ * The current segment of every SegmentWaypointMobilityModel, by model
+ * index.  Times are in seconds.
+ */
+struct SegmentTable
+{
+  static SegmentTable &Get (void)
+  {
+    static SegmentTable table;
+    return table;
+  }
+
+  uint32_t Add (SegmentWaypointMobilityModel *model)
+  {
+    double never = std::numeric_limits<double>::infinity ();
+    this->model.push_back (model);
+    node.push_back (0);
+    x0.push_back (0);
+    y0.push_back (0);
+    z0.push_back (0);
+    vx.push_back (0);
+    vy.push_back (0);
+    vz.push_back (0);
+    t0.push_back (0);
+    arrival.push_back (0);
+    end.push_back (never);
+    live++;
+    version++;
+    return model.size () - 1;
+  }
+
+  void Remove (uint32_t i)
+  {
+    model[i] = 0;
+    end[i] = std::numeric_limits<double>::infinity ();
+    if (--live == 0)
+      {
+        uint64_t v = version;
+        *this = SegmentTable ();
+        version = v;
+      }
+    version++;
+  }
+
+  uint32_t GetN (void) const
+  {
+    return model.size ();
+  }
+
+  std::vector<SegmentWaypointMobilityModel *> model; // 0 once disposed
+  std::vector<uint32_t> node;
+  std::vector<double> x0, y0, z0;
+  std::vector<double> vx, vy, vz;
+  std::vector<double> t0;       // segment start
+  std::vector<double> arrival;  // end of the walk, start of the pause
+  std::vector<double> end;      // end of the pause
+  uint32_t live;
+  uint64_t version;             // changes when models come and go or jump
+
+private:
+  SegmentTable () : live (0), version (0) {}
+};
+
+class SegmentWaypointMobilityModel : public MobilityModel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SegmentWaypointMobilityModel ();
+
+  /**
+   * \brief Positions of all the nodes with this model, now.
+   * \param batch filled in model index order
+   */
+  static void GetPositions (PositionBatch &batch);
+
+  /// \return index of the model in the segment table and in the batches
+  uint32_t GetIndex (void) const;
+
+private:
+  virtual void DoInitialize (void);
+  virtual void DoDispose (void);
+  virtual Vector DoGetPosition (void) const;
+  virtual void DoSetPosition (const Vector &position);
+  virtual Vector DoGetVelocity (void) const;
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  /// Draw segments until the one covering now.
+  void Advance (double now) const;
+  /// Stand at a position from now until the end of a freshly drawn pause.
+  void Pause (const Vector &position, double now) const;
+  /// Schedule the start of the segment after the current one.
+  void ScheduleNext (double now) const;
+  /// Event at the start of a segment.
+  void NextSegment (void) const;
+
+  Ptr<RandomVariableStream> m_speed;
+  Ptr<RandomVariableStream> m_pause;
+  Ptr<PositionAllocator> m_position;
+  uint32_t m_index;
+  mutable EventId m_next;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SegmentWaypointMobilityModel);
+
+TypeId
+SegmentWaypointMobilityModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SegmentWaypointMobilityModel")
+    .SetParent<MobilityModel> ()
+    .AddConstructor<SegmentWaypointMobilityModel> ()
+    .AddAttribute ("Speed", "Speed of the walks (m/s).",
+                   StringValue ("ns3::UniformRandomVariable[Min=0.3|Max=0.7]"),
+                   MakePointerAccessor (&SegmentWaypointMobilityModel::m_speed),
+                   MakePointerChecker<RandomVariableStream> ())
+    .AddAttribute ("Pause", "Pause at every destination (s).",
+                   StringValue ("ns3::ConstantRandomVariable[Constant=2.0]"),
+                   MakePointerAccessor (&SegmentWaypointMobilityModel::m_pause),
+                   MakePointerChecker<RandomVariableStream> ())
+    .AddAttribute ("PositionAllocator", "Source of the destinations.",
+                   PointerValue (),
+                   MakePointerAccessor (&SegmentWaypointMobilityModel::m_position),
+                   MakePointerChecker<PositionAllocator> ())
+  ;
+  return tid;
+}
+
+SegmentWaypointMobilityModel::SegmentWaypointMobilityModel ()
+{
+  m_index = SegmentTable::Get ().Add (this);
+}
+
+uint32_t
+SegmentWaypointMobilityModel::GetIndex (void) const
+{
+  return m_index;
+}
+
+void
+SegmentWaypointMobilityModel::DoInitialize (void)
+{
+  NS_ABORT_MSG_IF (m_position == 0, "SegmentWaypointMobilityModel needs a PositionAllocator");
+  Ptr<Node> node = GetObject<Node> ();
+  SegmentTable::Get ().node[m_index] = node ? node->GetId () : 0;
+  Pause (DoGetPosition (), Simulator::Now ().GetSeconds ());
+  MobilityModel::DoInitialize ();
+}
+
+void
+SegmentWaypointMobilityModel::DoDispose (void)
+{
+  m_next.Cancel ();
+  SegmentTable::Get ().Remove (m_index);
+  m_position = 0;
+  MobilityModel::DoDispose ();
+}
+
+void
+SegmentWaypointMobilityModel::Pause (const Vector &position, double now) const
+{
+  SegmentTable &t = SegmentTable::Get ();
+  uint32_t i = m_index;
+  t.x0[i] = position.x;
+  t.y0[i] = position.y;
+  t.z0[i] = position.z;
+  t.vx[i] = t.vy[i] = t.vz[i] = 0;
+  t.t0[i] = t.arrival[i] = now;
+  t.end[i] = now + m_pause->GetValue ();
+  ScheduleNext (now);
+  NotifyCourseChange ();
+}
+
+void
+SegmentWaypointMobilityModel::ScheduleNext (double now) const
+{
+  m_next.Cancel ();
+  m_next = Simulator::Schedule (Seconds (SegmentTable::Get ().end[m_index] - now),
+                                &SegmentWaypointMobilityModel::NextSegment, this);
+}
+
+void
+SegmentWaypointMobilityModel::NextSegment (void) const
+{
+  Advance (Simulator::Now ().GetSeconds ());
+}
+
+void
+SegmentWaypointMobilityModel::Advance (double now) const
+{
+  SegmentTable &t = SegmentTable::Get ();
+  uint32_t i = m_index;
+  bool drawn = false;
+  while (now >= t.end[i])
+    {
+      // The walk of the previous segment ended at its destination
+      double dt = t.arrival[i] - t.t0[i];
+      Vector from (t.x0[i] + t.vx[i] * dt, t.y0[i] + t.vy[i] * dt, t.z0[i] + t.vz[i] * dt);
+      Vector to = m_position->GetNext ();
+      double speed = m_speed->GetValue ();
+      double distance = CalculateDistance (from, to);
+      double start = t.end[i];
+      t.x0[i] = from.x;
+      t.y0[i] = from.y;
+      t.z0[i] = from.z;
+      t.t0[i] = start;
+      if (speed > 0 && distance > 0)
+        {
+          t.vx[i] = speed * (to.x - from.x) / distance;
+          t.vy[i] = speed * (to.y - from.y) / distance;
+          t.vz[i] = speed * (to.z - from.z) / distance;
+          t.arrival[i] = start + distance / speed;
+        }
+      else
+        {
+          t.vx[i] = t.vy[i] = t.vz[i] = 0;
+          t.arrival[i] = start;
+        }
+      t.end[i] = t.arrival[i] + m_pause->GetValue ();
+      drawn = true;
+      NotifyCourseChange ();
+    }
+  if (drawn)
+    {
+      ScheduleNext (now);
+    }
+}
+
+Vector
+SegmentWaypointMobilityModel::DoGetPosition (void) const
+{
+  double now = Simulator::Now ().GetSeconds ();
+  Advance (now);
+  const SegmentTable &t = SegmentTable::Get ();
+  uint32_t i = m_index;
+  double dt = std::max (0.0, std::min (now, t.arrival[i]) - t.t0[i]);
+  return Vector (t.x0[i] + t.vx[i] * dt, t.y0[i] + t.vy[i] * dt, t.z0[i] + t.vz[i] * dt);
+}
+
+void
+SegmentWaypointMobilityModel::DoSetPosition (const Vector &position)
+{
+  if (IsInitialized ())
+    {
+      SegmentTable::Get ().version++;
+      Pause (position, Simulator::Now ().GetSeconds ());
+      return;
+    }
+  // Before the start: stand there until DoInitialize draws the first pause
+  SegmentTable &t = SegmentTable::Get ();
+  t.x0[m_index] = position.x;
+  t.y0[m_index] = position.y;
+  t.z0[m_index] = position.z;
+  t.version++;
+  NotifyCourseChange ();
+}
+
+Vector
+SegmentWaypointMobilityModel::DoGetVelocity (void) const
+{
+  double now = Simulator::Now ().GetSeconds ();
+  Advance (now);
+  const SegmentTable &t = SegmentTable::Get ();
+  uint32_t i = m_index;
+  if (now >= t.arrival[i])
+    {
+      return Vector (0, 0, 0);
+    }
+  return Vector (t.vx[i], t.vy[i], t.vz[i]);
+}
+
+int64_t
+SegmentWaypointMobilityModel::DoAssignStreams (int64_t stream)
+{
+  m_speed->SetStream (stream);
+  m_pause->SetStream (stream + 1);
+  return 2 + m_position->AssignStreams (stream + 2);
+}
+
+void
+SegmentWaypointMobilityModel::GetPositions (PositionBatch &batch)
+{
+  SegmentTable &t = SegmentTable::Get ();
+  double now = Simulator::Now ().GetSeconds ();
+  uint32_t n = t.GetN ();
+  // Segments that ended since the last query: rare, and scalar
+  for (uint32_t i = 0; i < n; i++)
+    {
+      if (now >= t.end[i])
+        {
+          t.model[i]->Advance (now);
+        }
+    }
+  batch.node = t.node;
+  batch.x.resize (n);
+  batch.y.resize (n);
+  batch.z.resize (n);
+  if (n == 0)
+    {
+      return;
+    }
+  const double *x0 = &t.x0[0], *y0 = &t.y0[0], *z0 = &t.z0[0];
+  const double *vx = &t.vx[0], *vy = &t.vy[0], *vz = &t.vz[0];
+  const double *t0 = &t.t0[0], *arrival = &t.arrival[0];
+  double *x = &batch.x[0], *y = &batch.y[0], *z = &batch.z[0];
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double dt = std::max (0.0, std::min (now, arrival[i]) - t0[i]);
+      x[i] = x0[i] + vx[i] * dt;
+      y[i] = y0[i] + vy[i] * dt;
+      z[i] = z0[i] + vz[i] * dt;
+    }
+}
+
+} // namespace ns3
+
+#endif /* SEGMENT_WAYPOINT_MOBILITY_H */
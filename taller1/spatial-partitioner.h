@@ -0,0 +1,328 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Spatial partitioning of a wireless scenario into regions, one per MPI
+// rank of a distributed run (--distributed).
+//
+// Nodes are split into partitions by recursive coordinate bisection of
+// their positions, alternating x and y, so that every partition gets the
+// same number of nodes (within one when the count is not a power of two).
+// Two nodes can only interact if they are within the interference range of
+// each other (the distance at which a transmission still rises above the
+// energy detection threshold).  For every cut pair inside that range the
+// propagation delay bounds how soon an event in one partition can affect
+// the other; the smallest of those delays is the lookahead a conservative
+// synchronisation window can use.
+//
+// Plan () partitions positions given before the nodes exist, so that each
+// node can be created with its rank as system id.  The plan holds for
+// those positions only: with no cut pair in range the lookahead is 0.
+//
+// The interference range is taken from the devices: the channel's loss
+// model, the highest transmission power plus TxGain, RxGain and the lower
+// of the energy detection and CCA mode 1 thresholds of the PHYs.
+//
+
+#ifndef SPATIAL_PARTITIONER_H
+#define SPATIAL_PARTITIONER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/wifi-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+class SpatialPartitioner : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SpatialPartitioner ();
+
+  /**
+   * \brief Distance at which the received power drops below a threshold.
+   * \param loss propagation loss model used by the channel
+   * \param txPowerDbm transmission power
+   * \param rxGainDb receiver gain
+   * \param thresholdDbm energy detection threshold of the receiver
+   * \return interference range in meters
+   */
+  static double ComputeInterferenceRange (Ptr<PropagationLossModel> loss, double txPowerDbm,
+                                          double rxGainDb, double thresholdDbm);
+
+  /**
+   * \brief Interference range of a set of Yans Wi-Fi devices.
+   *
+   * Uses the loss model of their channel and the most favourable power,
+   * gains and threshold among their PHYs.
+   * \param devices WifiNetDevices on a YansWifiChannel
+   * \return interference range in meters
+   */
+  static double ComputeInterferenceRange (NetDeviceContainer devices);
+
+  /// \return partition of a node in the plan
+  uint32_t GetPartition (uint32_t nodeId) const;
+
+  /// \return number of partitions
+  uint32_t GetNPartitions (void) const;
+
+  /// \return lookahead of the plan, 0 when no cut pair is in range
+  Time GetLookahead (void) const;
+
+  /**
+   * \brief Partition positions once, without nodes or mobility.
+   *
+   * Used to give nodes their system id before they exist; GetPartition (i)
+   * is then the partition of positions[i].
+   * \param positions one per future node, in node id order
+   */
+  void Plan (const std::vector<Vector> &positions);
+
+private:
+  struct Item
+  {
+    uint32_t node;
+    Vector position;
+  };
+  struct ByX
+  {
+    bool operator () (const Item &a, const Item &b) const { return a.position.x < b.position.x; }
+  };
+  struct ByY
+  {
+    bool operator () (const Item &a, const Item &b) const { return a.position.y < b.position.y; }
+  };
+
+  void Bisect (std::vector<Item>::iterator begin, std::vector<Item>::iterator end,
+               uint32_t first, uint32_t count, bool alongX);
+  /// Partition items and compute the lookahead; node ids are at most maxId
+  void Partition (std::vector<Item> &items, uint32_t maxId);
+
+  uint32_t m_nPartitions;
+  double m_range;
+  double m_speed;
+  std::vector<uint32_t> m_partition; // indexed by node id
+  Time m_lookahead;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SpatialPartitioner);
+
+TypeId
+SpatialPartitioner::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SpatialPartitioner")
+    .SetParent<Object> ()
+    .AddConstructor<SpatialPartitioner> ()
+    .AddAttribute ("Partitions", "Number of partitions.",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&SpatialPartitioner::m_nPartitions),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("InterferenceRange", "Distance (m) beyond which nodes cannot interact.",
+                   DoubleValue (1000),
+                   MakeDoubleAccessor (&SpatialPartitioner::m_range),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("Speed", "Propagation speed (m/s) of the channel's delay model.",
+                   DoubleValue (299792458.0),
+                   MakeDoubleAccessor (&SpatialPartitioner::m_speed),
+                   MakeDoubleChecker<double> (0))
+  ;
+  return tid;
+}
+
+SpatialPartitioner::SpatialPartitioner ()
+  : m_nPartitions (4),
+    m_range (1000),
+    m_speed (299792458.0)
+{
+}
+
+double
+SpatialPartitioner::ComputeInterferenceRange (Ptr<PropagationLossModel> loss, double txPowerDbm,
+                                              double rxGainDb, double thresholdDbm)
+{
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  a->SetPosition (Vector (0, 0, 0));
+  double low = 0;
+  double high = 1;
+  // Grow until out of range, then bisect; loss is monotonic in distance.
+  for (b->SetPosition (Vector (high, 0, 0));
+       loss->CalcRxPower (txPowerDbm, a, b) + rxGainDb >= thresholdDbm && high < 1e7;
+       b->SetPosition (Vector (high, 0, 0)))
+    {
+      low = high;
+      high *= 2;
+    }
+  for (int i = 0; i < 50; i++)
+    {
+      double mid = (low + high) / 2;
+      b->SetPosition (Vector (mid, 0, 0));
+      if (loss->CalcRxPower (txPowerDbm, a, b) + rxGainDb >= thresholdDbm)
+        {
+          low = mid;
+        }
+      else
+        {
+          high = mid;
+        }
+    }
+  return high;
+}
+
+double
+SpatialPartitioner::ComputeInterferenceRange (NetDeviceContainer devices)
+{
+  Ptr<PropagationLossModel> loss;
+  double txPowerDbm = -std::numeric_limits<double>::infinity ();
+  double rxGainDb = -std::numeric_limits<double>::infinity ();
+  double thresholdDbm = std::numeric_limits<double>::infinity ();
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+    {
+      Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (*i);
+      NS_ABORT_MSG_IF (device == 0, "the interference range needs Wi-Fi devices");
+      Ptr<WifiPhy> phy = device->GetPhy ();
+      DoubleValue start, end, txGain, rxGain, ed, cca;
+      phy->GetAttribute ("TxPowerStart", start);
+      phy->GetAttribute ("TxPowerEnd", end);
+      phy->GetAttribute ("TxGain", txGain);
+      phy->GetAttribute ("RxGain", rxGain);
+      phy->GetAttribute ("EnergyDetectionThreshold", ed);
+      phy->GetAttribute ("CcaMode1Threshold", cca);
+      txPowerDbm = std::max (txPowerDbm, std::max (start.Get (), end.Get ()) + txGain.Get ());
+      rxGainDb = std::max (rxGainDb, rxGain.Get ());
+      thresholdDbm = std::min (thresholdDbm, std::min (ed.Get (), cca.Get ()));
+      if (loss == 0)
+        {
+          PointerValue channelLoss;
+          phy->GetChannel ()->GetAttribute ("PropagationLossModel", channelLoss);
+          loss = channelLoss.Get<PropagationLossModel> ();
+        }
+    }
+  NS_ABORT_MSG_IF (loss == 0, "no device with a propagation loss model");
+  return ComputeInterferenceRange (loss, txPowerDbm, rxGainDb, thresholdDbm);
+}
+
+uint32_t
+SpatialPartitioner::GetPartition (uint32_t nodeId) const
+{
+  return nodeId < m_partition.size () ? m_partition[nodeId] : 0;
+}
+
+uint32_t
+SpatialPartitioner::GetNPartitions (void) const
+{
+  return m_nPartitions;
+}
+
+Time
+SpatialPartitioner::GetLookahead (void) const
+{
+  return m_lookahead;
+}
+
+void
+SpatialPartitioner::Bisect (std::vector<Item>::iterator begin, std::vector<Item>::iterator end,
+                            uint32_t first, uint32_t count, bool alongX)
+{
+  if (count == 1)
+    {
+      for (std::vector<Item>::iterator i = begin; i != end; i++)
+        {
+          m_partition[i->node] = first;
+        }
+      return;
+    }
+  // Uneven counts split the nodes in proportion
+  uint32_t left = count / 2;
+  std::vector<Item>::iterator mid = begin + (end - begin) * left / count;
+  if (alongX)
+    {
+      std::nth_element (begin, mid, end, ByX ());
+    }
+  else
+    {
+      std::nth_element (begin, mid, end, ByY ());
+    }
+  Bisect (begin, mid, first, left, !alongX);
+  Bisect (mid, end, first + left, count - left, !alongX);
+}
+
+void
+SpatialPartitioner::Plan (const std::vector<Vector> &positions)
+{
+  std::vector<Item> items (positions.size ());
+  for (uint32_t i = 0; i < positions.size (); i++)
+    {
+      items[i].node = i;
+      items[i].position = positions[i];
+    }
+  Partition (items, positions.empty () ? 0 : positions.size () - 1);
+}
+
+void
+SpatialPartitioner::Partition (std::vector<Item> &items, uint32_t maxId)
+{
+  m_partition.assign (maxId + 1, 0);
+  Bisect (items.begin (), items.end (), 0, m_nPartitions, true);
+
+  // Bucket nodes on a grid of cell size m_range so that only neighbouring
+  // cells need to be compared.
+  std::map<std::pair<int64_t, int64_t>, std::vector<const Item *> > grid;
+  for (std::vector<Item>::const_iterator i = items.begin (); i != items.end (); i++)
+    {
+      int64_t cx = static_cast<int64_t> (std::floor (i->position.x / m_range));
+      int64_t cy = static_cast<int64_t> (std::floor (i->position.y / m_range));
+      grid[std::make_pair (cx, cy)].push_back (&*i);
+    }
+  uint64_t cutPairs = 0;
+  double minDistance = std::numeric_limits<double>::infinity ();
+  for (std::map<std::pair<int64_t, int64_t>, std::vector<const Item *> >::const_iterator c = grid.begin ();
+       c != grid.end (); c++)
+    {
+      for (int64_t dx = -1; dx <= 1; dx++)
+        {
+          for (int64_t dy = -1; dy <= 1; dy++)
+            {
+              std::map<std::pair<int64_t, int64_t>, std::vector<const Item *> >::const_iterator n =
+                grid.find (std::make_pair (c->first.first + dx, c->first.second + dy));
+              if (n == grid.end ())
+                {
+                  continue;
+                }
+              for (std::vector<const Item *>::const_iterator a = c->second.begin (); a != c->second.end (); a++)
+                {
+                  for (std::vector<const Item *>::const_iterator b = n->second.begin (); b != n->second.end (); b++)
+                    {
+                      if ((*a)->node >= (*b)->node)
+                        {
+                          continue;
+                        }
+                      double d = CalculateDistance ((*a)->position, (*b)->position);
+                      if (d > m_range)
+                        {
+                          continue;
+                        }
+                      if (m_partition[(*a)->node] != m_partition[(*b)->node])
+                        {
+                          cutPairs++;
+                          minDistance = std::min (minDistance, d);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+  m_lookahead = cutPairs ? Seconds (minDistance / m_speed) : Seconds (0);
+}
+
+} // namespace ns3
+
+#endif /* SPATIAL_PARTITIONER_H */
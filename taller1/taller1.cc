@@ -38,8 +38,15 @@
 #include "ns3/mobility-module.h"
 #include "ns3/wifi-module.h"
 #include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
 #include "ns3/netanim-module.h"
 #include "ns3/animation-interface.h"
+#include "scenario-bench.h"
+#include "attribute-handle.h"
+#include "bulk-builder.h"
+#include "multi-channel.h"
+
+#include <sstream>
 
 using namespace ns3;
 
@@ -68,6 +75,12 @@ static void GenerateTraffic (Ptr<Socket> socket, uint32_t pktSize,
     }
 }
 
+/// Channel of the BSS of station k (the backbone is channel 0).
+static uint32_t BssChannel (uint32_t k, uint32_t numChannels)
+{
+  return numChannels > 1 ? 1 + k % (numChannels - 1) : 0;
+}
+
 int main (int argc, char *argv[])
 {
   std::string phyMode ("DsssRate1Mbps");
@@ -76,6 +89,12 @@ int main (int argc, char *argv[])
   uint32_t numPackets = 10;
   double interval = 10.0; // seconds
   bool verbose = false;
+  uint32_t numNodes = 25; // 21 adhoc nodes + 4 stations
+  bool tracing = true;
+  bool bench = false;
+  uint32_t numChannels = 1;
+  double bssLoad = 0; // Mbps per BSS
+  double bssStart = 2.0; // s, after the clients associate
 
   CommandLine cmd;
 
@@ -85,33 +104,47 @@ int main (int argc, char *argv[])
   cmd.AddValue ("numPackets", "number of packets generated", numPackets);
   cmd.AddValue ("interval", "interval (seconds) between packets", interval);
   cmd.AddValue ("verbose", "turn on all WifiNetDevice log components", verbose);
+  cmd.AddValue ("numNodes", "number of nodes", numNodes);
+  cmd.AddValue ("tracing", "turn on pcap tracing and animation output", tracing);
+  cmd.AddValue ("numChannels", "ad hoc backbone on the first channel, station BSSs spread over the others", numChannels);
+  cmd.AddValue ("bssLoad", "UDP load (Mbps) each BSS client offers its AP; > 0 prints the BSS goodput", bssLoad);
+  cmd.AddValue ("bench", "print a BENCH summary line (see bench/run-benchmarks.sh)", bench);
 
   cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (numNodes < 4, "numNodes includes the 4 stations, it must be at least 4");
+
+  ScenarioBench benchmark ("taller1");
+  if (bench)
+    {
+      benchmark.Start ();
+    }
+
   // Convert to time object
   Time interPacketInterval = Seconds (interval);
 
   // disable fragmentation for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::FragmentationThreshold")
+    .SetDefault (UintegerValue (2200));
   // turn off RTS/CTS for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::RtsCtsThreshold")
+    .SetDefault (UintegerValue (2200));
   // Fix non-unicast data rate to be the same as that of unicast
-  Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode",
-                      StringValue (phyMode));
+  AttributeHandle<WifiModeValue> ("ns3::WifiRemoteStationManager::NonUnicastMode")
+    .SetDefault (WifiModeValue (WifiMode (phyMode)));
 
-  NodeContainer n1;
-  n1.Create (21);
+  // The ad hoc population goes through AdhocBulkBuilder, which times
+  // each layer; the calls stay where the scripts installed the layer
+  AdhocBulkBuilder builder;
+  NodeContainer n1 = builder.Create (numNodes - 4);
   Ptr<Node> s1 = CreateObject<Node> ();
-
   Ptr<Node> s2 = CreateObject<Node> ();
-
   Ptr<Node> s3 = CreateObject<Node> ();
-
   Ptr<Node> s4 = CreateObject<Node> ();
   //internet stack ipv6
   InternetStackHelper internet;
   internet.SetIpv4StackInstall (false);//desactiva ipv6
 
-  internet.Install (n1);
+  builder.InstallInternet (internet);
   internet.Install (s1);
   internet.Install (s2);
   internet.Install (s3);
@@ -137,16 +170,19 @@ int main (int argc, char *argv[])
   // The below FixedRssLossModel will cause the rss to be fixed regardless
   // of the distance between the two stations, and the transmit power
   wifiChannel.AddPropagationLoss ("ns3::FixedRssLossModel","Rss",DoubleValue (rss));
-  wifiPhy.SetChannel (wifiChannel.Create ());
+  // Channel 0 carries the ad hoc backbone; with more channels the four
+  // station BSSs leave it and share the rest round robin
+  MultiChannel channels (wifiChannel, numChannels);
+  channels.Attach (wifiPhy, 0);
 
   // Add a mac and disable rate control
   WifiMacHelper wifiMac;
   wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode",StringValue (phyMode),
-                                "ControlMode",StringValue (phyMode));
+                                "DataMode", WifiModeValue (WifiMode (phyMode)),
+                                "ControlMode", WifiModeValue (WifiMode (phyMode)));
   // Set it to adhoc mode
   wifiMac.SetType ("ns3::AdhocWifiMac");
-  NetDeviceContainer devices_n1 = wifi.Install (wifiPhy, wifiMac, n1);
+  NetDeviceContainer devices_n1 = builder.InstallWifi (wifi, wifiPhy, wifiMac);
 
 
   ////////////configuracion de Estacion 1 /////////////////////////////
@@ -166,7 +202,9 @@ int main (int argc, char *argv[])
                "QosSupported", BooleanValue (true),
                "Ssid", SsidValue (ssid),
                "BE_BlockAckThreshold", UintegerValue (0));
-  device_s1 = wifi.Install (wifiPhy, wifiMac, s1);
+  channels.Attach (wifiPhy, BssChannel (0, numChannels));
+  NetDeviceContainer ap_s1 = wifi.Install (wifiPhy, wifiMac, s1);
+  channels.Attach (wifiPhy, 0);
   //AnimationInterface::UpdateNodeColor (s1, 12, 2, 3); 
 
   ////////////configuracion de Estacion 2 /////////////////////////////
@@ -183,9 +221,11 @@ int main (int argc, char *argv[])
 
   wifiMac.SetType ("ns3::ApWifiMac",
                "QosSupported", BooleanValue (false),
-               "Ssid", SsidValue (ssid),
+               "Ssid", SsidValue (ssid1),
                "BE_BlockAckThreshold", UintegerValue (0));
-  device_s2 = wifi.Install (wifiPhy, wifiMac, s2);
+  channels.Attach (wifiPhy, BssChannel (1, numChannels));
+  NetDeviceContainer ap_s2 = wifi.Install (wifiPhy, wifiMac, s2);
+  channels.Attach (wifiPhy, 0);
 
     ////////////configuracion de Estacion 3 /////////////////////////////
   Ssid ssid3 ("My-network3");
@@ -204,7 +244,9 @@ int main (int argc, char *argv[])
                "QosSupported", BooleanValue (true),
                "Ssid", SsidValue (ssid3),
                "BE_BlockAckThreshold", UintegerValue (0));
-  device_s3 = wifi.Install (wifiPhy, wifiMac, s3);
+  channels.Attach (wifiPhy, BssChannel (2, numChannels));
+  NetDeviceContainer ap_s3 = wifi.Install (wifiPhy, wifiMac, s3);
+  channels.Attach (wifiPhy, 0);
   //AnimationInterface::UpdateNodeColor (s1, 12, 2, 3); 
 
   ////////////configuracion de Estacion 4 /////////////////////////////
@@ -221,20 +263,65 @@ int main (int argc, char *argv[])
 
   wifiMac.SetType ("ns3::ApWifiMac",
                "QosSupported", BooleanValue (false),
-               "Ssid", SsidValue (ssid),
+               "Ssid", SsidValue (ssid4),
                "BE_BlockAckThreshold", UintegerValue (0));
-  device_s4 = wifi.Install (wifiPhy, wifiMac, s4);
+  channels.Attach (wifiPhy, BssChannel (3, numChannels));
+  NetDeviceContainer ap_s4 = wifi.Install (wifiPhy, wifiMac, s4);
+  channels.Attach (wifiPhy, 0);
+
+  ////////////clientes de las BSS /////////////////////////////
+  // Every station keeps its ad hoc radio on the backbone and is the AP of
+  // its own BSS; one client per BSS associates with it on the BSS channel
+  Ptr<Node> stations[4] = { s1, s2, s3, s4 };
+  NetDeviceContainer apDevices[4] = { ap_s1, ap_s2, ap_s3, ap_s4 };
+  Ssid bssSsids[4] = { ssid, ssid1, ssid3, ssid4 };
+  bool bssQos[4] = { true, false, true, false };
+  NodeContainer clients;
+  clients.Create (4);
+  internet.Install (clients);
+  NetDeviceContainer clientDevices[4];
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      wifiMac.SetType ("ns3::StaWifiMac",
+                       "QosSupported", BooleanValue (bssQos[k]),
+                       "Ssid", SsidValue (bssSsids[k]),
+                       "ActiveProbing", BooleanValue (false));
+      channels.Attach (wifiPhy, BssChannel (k, numChannels));
+      clientDevices[k] = wifi.Install (wifiPhy, wifiMac, clients.Get (k));
+    }
+  channels.Attach (wifiPhy, 0);
 
 
 
+  if (numChannels > 1)
+    {
+      for (uint32_t k = 0; k < 4; k++)
+        {
+          channels.Tune (apDevices[k], BssChannel (k, numChannels), WIFI_PHY_STANDARD_80211b);
+          channels.Tune (clientDevices[k], BssChannel (k, numChannels), WIFI_PHY_STANDARD_80211b);
+        }
+    }
+
   //Ipv6 addresshelper:
   Ipv6AddressHelper ipv6;
   NS_LOG_INFO ("Assign IP Addresses IPv6.");
-  ipv6.Assign(devices_n1);
+  builder.Assign (ipv6);
   ipv6.Assign(device_s1);
   ipv6.Assign(device_s2);
   ipv6.Assign(device_s3);
   ipv6.Assign(device_s4);
+  // One /64 per BSS, so that the station's on-link routes tell its two
+  // radios apart
+  Ipv6InterfaceContainer apInterfaces[4];
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      std::ostringstream prefix;
+      prefix << "2001:db8:" << k + 1 << "::";
+      Ipv6AddressHelper bss;
+      bss.SetBase (Ipv6Address (prefix.str ().c_str ()), Ipv6Prefix (64));
+      apInterfaces[k] = bss.Assign (apDevices[k]);
+      bss.Assign (clientDevices[k]);
+    }
 
 
   // Note that with FixedRssLossModel, the positions below are not
@@ -252,11 +339,22 @@ int main (int argc, char *argv[])
                                       "PositionAllocator", PointerValue (PositionAlloc));
                                         
   mobility.SetPositionAllocator (PositionAlloc);
-  mobility.Install (n1);
+  builder.InstallMobility (mobility);
   mobility.Install (s1);
   mobility.Install (s2);
   mobility.Install (s3);
   mobility.Install (s4);
+  // Clients sit next to their AP (the loss is fixed anyway)
+  MobilityHelper clientMobility;
+  Ptr<ListPositionAllocator> clientPositions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      Vector position = stations[k]->GetObject<MobilityModel> ()->GetPosition ();
+      clientPositions->Add (Vector (position.x + 1, position.y, position.z));
+    }
+  clientMobility.SetPositionAllocator (clientPositions);
+  clientMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  clientMobility.Install (clients);
 
   // Ipv4AddressHelper ipv4;
   // NS_LOG_INFO ("Assign IP Addresses.");
@@ -274,8 +372,27 @@ int main (int argc, char *argv[])
   source->SetAllowBroadcast (true);
   source->Connect (remote);
 
+  // BSS capacity: every client saturates the uplink to its AP
+  ApplicationContainer bssSinks;
+  if (bssLoad > 0)
+    {
+      for (uint32_t k = 0; k < 4; k++)
+        {
+          PacketSinkHelper sink ("ns3::UdpSocketFactory", Inet6SocketAddress (Ipv6Address::GetAny (), 9));
+          bssSinks.Add (sink.Install (stations[k]));
+          OnOffHelper onOff ("ns3::UdpSocketFactory", Inet6SocketAddress (apInterfaces[k].GetAddress (0, 1), 9));
+          onOff.SetConstantRate (DataRate (uint64_t (bssLoad * 1e6)), packetSize);
+          ApplicationContainer app = onOff.Install (clients.Get (k));
+          app.Start (Seconds (bssStart));
+          app.Stop (Seconds (50.0));
+        }
+    }
+
   // Tracing
-  wifiPhy.EnablePcap ("taller1", devices_n1);
+  if (tracing)
+    {
+      wifiPhy.EnablePcap ("taller1", devices_n1);
+    }
 
   // Output what we are doing
   NS_LOG_UNCOND ("Testing " << numPackets  << " packets sent with receiver rss " << rss );
@@ -286,11 +403,37 @@ int main (int argc, char *argv[])
 
   Simulator::Stop (Seconds (50.0));
   
-  AnimationInterface anim ("taller1.xml");
+  AnimationInterface *anim = 0;
+  if (tracing)
+    {
+      anim = new AnimationInterface ("taller1.xml");
+    }
   
 
+  uint32_t totalNodes = NodeList::GetNNodes ();
+  benchmark.SetupDone ();
   Simulator::Run ();
+  if (bssLoad > 0)
+    {
+      double total = 0;
+      for (uint32_t k = 0; k < 4; k++)
+        {
+          double goodput = DynamicCast<PacketSink> (bssSinks.Get (k))->GetTotalRx () * 8 / (50.0 - bssStart) / 1e6;
+          total += goodput;
+          std::cout << "BSS station=" << k + 1
+                    << " channel=" << BssChannel (k, numChannels)
+                    << " offered_mbps=" << bssLoad
+                    << " goodput_mbps=" << goodput << std::endl;
+        }
+      std::cout << "BSS channels=" << numChannels << " total_goodput_mbps=" << total << std::endl;
+    }
   Simulator::Destroy ();
+  delete anim;
+  benchmark.Report (totalNodes);
+  if (bench)
+    {
+      builder.Report (std::cout);
+    }
 
   return 0;
 }
@@ -13,6 +13,9 @@
 #include "ns3/animation-interface.h"
 #include "ns3/qos-wifi-mac-helper.h"
 #include "ns3/on-off-helper.h"
+#include "scenario-bench.h"
+#include "attribute-handle.h"
+#include "mobility-trace.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -57,7 +60,10 @@ int main (int argc, char *argv[])
   uint32_t sourceNode = 24;
   double interval = 1.0; // seconds
   bool verbose = false;
+  bool bench = false;
   bool tracing = true;
+  std::string recordMobility ("");
+  std::string replayMobility ("");
 
   CommandLine cmd;
 
@@ -71,18 +77,30 @@ int main (int argc, char *argv[])
   cmd.AddValue ("numNodes", "number of nodes", numNodes);
   cmd.AddValue ("sinkNode", "Receiver node number", sinkNode);
   cmd.AddValue ("sourceNode", "Sender node number", sourceNode);
+  cmd.AddValue ("recordMobility", "write the trajectories of the nodes to this binary trace", recordMobility);
+  cmd.AddValue ("replayMobility", "move the nodes along the trajectories of this binary trace", replayMobility);
+  cmd.AddValue ("bench", "print a BENCH summary line (see bench/run-benchmarks.sh)", bench);
 
   cmd.Parse (argc, argv);
+
+  ScenarioBench benchmark ("taller1_olsripv6");
+  if (bench)
+    {
+      benchmark.Start ();
+    }
+
   // Convert to time object
   Time interPacketInterval = Seconds (interval);
 
   // disable fragmentation for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::FragmentationThreshold")
+    .SetDefault (UintegerValue (2200));
   // turn off RTS/CTS for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::RtsCtsThreshold")
+    .SetDefault (UintegerValue (2200));
   // Fix non-unicast data rate to be the same as that of unicast
-  Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode", 
-                      StringValue (phyMode));
+  AttributeHandle<WifiModeValue> ("ns3::WifiRemoteStationManager::NonUnicastMode")
+    .SetDefault (WifiModeValue (WifiMode (phyMode)));
 
   NodeContainer c;
   c.Create (numNodes);
@@ -115,8 +133,8 @@ int main (int argc, char *argv[])
 
   wifi.SetStandard (WIFI_PHY_STANDARD_80211b);
   wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode",StringValue (phyMode),
-                                "ControlMode",StringValue (phyMode));
+                                "DataMode", WifiModeValue (WifiMode (phyMode)),
+                                "ControlMode", WifiModeValue (WifiMode (phyMode)));
 
 
   
@@ -141,7 +159,20 @@ int main (int argc, char *argv[])
                                       "PositionAllocator", PointerValue (PositionAlloc));
                                         
   mobility.SetPositionAllocator (PositionAlloc);
-  mobility.Install (c);
+  if (replayMobility.empty ())
+    {
+      mobility.Install (c);
+    }
+  else
+    {
+      MobilityTraceReplay (replayMobility).Install (c);
+    }
+  MobilityTraceRecorder *mobilityRecorder = 0;
+  if (!recordMobility.empty ())
+    {
+      mobilityRecorder = new MobilityTraceRecorder (recordMobility);
+      mobilityRecorder->Install (c);
+    }
 
   // Activar OLSR6
   Olsr6Helper olsr6;
@@ -224,9 +255,22 @@ int main (int argc, char *argv[])
   //NS_LOG_UNCOND ("Testing from node " << sourceNode << " to " << sinkNode << " with grid distance " << distance);
 
   Simulator::Stop (Seconds (33.0));
-  AnimationInterface anim ("taller1_anim.xml");
+  AnimationInterface *anim = 0;
+  if (tracing)
+    {
+      anim = new AnimationInterface ("taller1_anim.xml");
+    }
+  uint32_t totalNodes = NodeList::GetNNodes ();
+  benchmark.SetupDone ();
   Simulator::Run ();
+  if (mobilityRecorder)
+    {
+      mobilityRecorder->Close ();
+    }
   Simulator::Destroy ();
+  delete anim;
+  delete mobilityRecorder;
+  benchmark.Report (totalNodes);
 
   return 0;
 }
@@ -13,10 +13,36 @@
 #include "ns3/animation-interface.h"
 #include "ns3/qos-wifi-mac-helper.h"
 #include "ns3/on-off-helper.h"
+#include "ns3/packet-sink-helper.h"
+#include "scenario-bench.h"
+#include "attribute-handle.h"
+#include "profiling-scheduler.h"
+#include "spatial-partitioner.h"
+#include "olsr6-stats.h"
+#include "olsr6-mpr-shadow.h"
+#include "olsr6-route-shadow.h"
+#include "olsr6-etx.h"
+#include "flow-report.h"
+#include "rate-stats.h"
+#include "multi-channel.h"
+#include "wifi-aqm.h"
+#include "admission-control.h"
+#include "fluid-background.h"
+#include "segment-waypoint-mobility.h"
+#include "batch-friis-loss.h"
+#include "mobility-trace.h"
+#include "pcap-replay.h"
+#include "ndisc-preloader.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include "wifi-rank-proxy.h"
+#endif
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <algorithm>
 
 using namespace ns3;
 
@@ -30,6 +56,107 @@ void ReceivePacket (Ptr<Socket> socket)
     }
 }
 
+static void ReportMemory (Ptr<OutputStreamWrapper> stream)
+{
+  std::ostringstream label;
+  label << Simulator::Now ().GetSeconds ();
+  AllocAccounting::WriteReport (*stream->GetStream (), label.str ().c_str ());
+}
+
+/**
+ * Channel width, guard interval and antennas of HT/VHT devices.  Set on the
+ * installed PHYs because WifiHelper::Install () applies the standard's own
+ * channel width after the helper attributes.
+ */
+static void ConfigureHtPhy (NetDeviceContainer devices, uint32_t channelWidth, bool shortGuard, uint32_t streams)
+{
+  AttributeHandle<UintegerValue> width (WifiPhy::GetTypeId (), "ChannelWidth");
+  AttributeHandle<BooleanValue> guard (WifiPhy::GetTypeId (), "ShortGuardEnabled");
+  AttributeHandle<UintegerValue> transmitters (WifiPhy::GetTypeId (), "Transmitters");
+  AttributeHandle<UintegerValue> receivers (WifiPhy::GetTypeId (), "Receivers");
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+    {
+      Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice> (*i)->GetPhy ();
+      width.Set (phy, UintegerValue (channelWidth));
+      guard.Set (phy, BooleanValue (shortGuard));
+      transmitters.Set (phy, UintegerValue (streams));
+      receivers.Set (phy, UintegerValue (streams));
+    }
+}
+
+/**
+ * A FluidBackgroundSource with the OnOff defaults of the services, sending
+ * on the given device toward the service's address.
+ */
+static ApplicationContainer InstallFluid (Ptr<NetDevice> device, Ipv6Address destination, std::string rate,
+                                          DataRate phyRate)
+{
+  Ptr<FluidBackgroundSource> fluid = CreateObjectWithAttributes<FluidBackgroundSource>
+      ("DataRate", DataRateValue (DataRate (rate)),
+       "PhyRate", DataRateValue (phyRate));
+  fluid->SetDevice (DynamicCast<WifiNetDevice> (device));
+  fluid->SetDestination (destination);
+  device->GetNode ()->AddApplication (fluid);
+  return ApplicationContainer (fluid);
+}
+
+/**
+ * Name of an output file; in a distributed run every rank writes its own,
+ * like the ascii trace.
+ */
+static std::string OutputName (std::string extension, bool distributed, uint32_t systemId)
+{
+  std::ostringstream name;
+  name << "taller1";
+  if (distributed)
+    {
+      name << "-rank" << systemId;
+    }
+  name << extension;
+  return name.str ();
+}
+
+/**
+ * MAC address of a radio in a distributed run, numbered like
+ * Mac48Address::Allocate () numbers them in a sequential run (all the
+ * non-QoS radios, then all the QoS ones), so that every rank knows the
+ * addresses of the nodes it does not build.
+ */
+static Mac48Address RadioAddress (uint32_t radio, uint32_t node, uint32_t numNodes)
+{
+  uint64_t id = static_cast<uint64_t> (radio) * numNodes + node + 1;
+  uint8_t buffer[6];
+  for (int k = 5; k >= 0; k--)
+    {
+      buffer[k] = id & 0xff;
+      id >>= 8;
+    }
+  Mac48Address address;
+  address.CopyFrom (buffer);
+  return address;
+}
+
+/**
+ * First address of the interface of a node on one of the Wi-Fi networks.
+ * A remote node of a distributed run has no stack on this rank; its
+ * address is derived from its MAC address the way the local ones were.
+ * \param slot position of each node in the interface container, -1 if remote
+ */
+static Ipv6Address NodeAddress (Ipv6InterfaceContainer interfaces, const std::vector<int32_t> &slot,
+                                uint32_t node, Mac48Address mac)
+{
+  if (slot[node] >= 0)
+    {
+      return interfaces.GetAddress (slot[node], 0);
+    }
+  Ipv6Address sample = interfaces.GetAddress (0, 0);
+  if (sample.IsLinkLocal ())
+    {
+      return Ipv6Address::MakeAutoconfiguredLinkLocalAddress (mac);
+    }
+  return Ipv6Address::MakeAutoconfiguredAddress (mac, sample.CombinePrefix (Ipv6Prefix (64)));
+}
+
 static void GenerateTraffic (Ptr<Socket> socket, uint32_t pktSize, 
                              uint32_t pktCount, Time pktInterval )
 { 
@@ -57,7 +184,43 @@ int main (int argc, char *argv[])
   uint32_t sourceNode = 24;
   double interval = 1.0; // seconds
   bool verbose = false;
+  bool bench = false;
   bool tracing = true;
+  bool profile = false;
+  std::string memReport ("");
+  bool distributed = false;
+  bool nullMessages = false;
+  bool olsrStats = false;
+  bool adaptiveOlsr = false;
+  bool mprShadow = false;
+  bool mprVerify = false;
+  bool routeShadow = false;
+  bool routeVerify = false;
+  std::string routing ("olsr");
+  bool flows = false;
+  bool fastIpv6 = false;
+  bool ndpStats = false;
+  std::string standard ("80211b");
+  uint32_t channelWidth = 20; // MHz
+  bool shortGuard = false;
+  uint32_t streams = 1;
+  uint32_t mcs = 7;
+  std::string serviceRate ("11Mbps");
+  bool remoteServices = false;
+  std::string manager ("constant");
+  bool rateStats = false;
+  uint32_t numChannels = 1;
+  std::string aqm ("none");
+  uint32_t macQueueLimit = 4;
+  bool queueStats = false;
+  bool admissionControl = false;
+  bool fluidBackground = false;
+  bool mobile = true;
+  bool lazyMobility = false;
+  bool batchLoss = false;
+  std::string recordMobility ("");
+  std::string replayMobility ("");
+  std::string pcapReplay ("");
 
   CommandLine cmd;
 
@@ -71,21 +234,202 @@ int main (int argc, char *argv[])
   cmd.AddValue ("numNodes", "number of nodes", numNodes);
   cmd.AddValue ("sinkNode", "Receiver node number", sinkNode);
   cmd.AddValue ("sourceNode", "Sender node number", sourceNode);
+  cmd.AddValue ("profile", "report wall time per event callback and node", profile);
+  cmd.AddValue ("memReport", "comma separated times (s) to write per-node memory use to taller1.mem (needs -DALLOC_STATS)", memReport);
+  cmd.AddValue ("distributed", "split the nodes over MPI ranks by position, each rank writes taller1-rank<N>.*; same results as the sequential run (needs --enable-mpi and --mobility=0)", distributed);
+  cmd.AddValue ("nullMessages", "use null-message instead of barrier synchronization", nullMessages);
+  cmd.AddValue ("olsrStats", "log OLSR6 rebuilds and control overhead to taller1.olsr", olsrStats);
+  cmd.AddValue ("adaptiveOlsr", "adapt OLSR6 HELLO/TC intervals to neighbor/2-hop changes per HELLO received", adaptiveOlsr);
+  cmd.AddValue ("mprShadow", "run incremental MPR selection alongside OLSR6, log to taller1.mpr", mprShadow);
+  cmd.AddValue ("mprVerify", "cross-check the incremental MPR sets against full recomputation", mprVerify);
+  cmd.AddValue ("routeShadow", "run incremental shortest-path route computation alongside OLSR6, log to taller1.spt", routeShadow);
+  cmd.AddValue ("routeVerify", "cross-check the incremental routes against full recomputation", routeVerify);
+  cmd.AddValue ("routing", "olsr (hop count) or etx (oracle bound: ETX routes from the link state of all nodes at once, log to taller1.etx)", routing);
+  cmd.AddValue ("flows", "write per-flow goodput and delay to taller1.flows, print offered vs achieved load per service", flows);
+  cmd.AddValue ("fastIpv6", "skip DAD and preload neighbor caches of the helper-assigned addresses", fastIpv6);
+  cmd.AddValue ("ndpStats", "print the neighbor discovery messages sent", ndpStats);
+  cmd.AddValue ("standard", "80211b, 80211n-2.4GHz, 80211n-5GHz or 80211ac", standard);
+  cmd.AddValue ("channelWidth", "HT/VHT channel width (MHz)", channelWidth);
+  cmd.AddValue ("shortGuard", "HT/VHT short guard interval", shortGuard);
+  cmd.AddValue ("streams", "HT/VHT spatial streams (antennas per device)", streams);
+  cmd.AddValue ("mcs", "HT/VHT MCS per stream (phyMode is used for 802.11b)", mcs);
+  cmd.AddValue ("serviceRate", "OnOff data rate of each service", serviceRate);
+  cmd.AddValue ("remoteServices", "send the services to the sink node instead of to their own node", remoteServices);
+  cmd.AddValue ("manager", "rate control: constant, aarf, minstrel or ideal (802.11b only)", manager);
+  cmd.AddValue ("rateStats", "print retries and write per-link rate histograms to taller1.rates", rateStats);
+  cmd.AddValue ("numChannels", "1: both radios share a channel, 2: QoS and non-QoS radios on orthogonal channels", numChannels);
+  cmd.AddValue ("aqm", "queue disc on the Wi-Fi devices: none, codel or fqcodel", aqm);
+  cmd.AddValue ("macQueueLimit", "packets the MAC queues of a device may hold under --aqm", macQueueLimit);
+  cmd.AddValue ("queueStats", "print queue disc and MAC sojourn times", queueStats);
+  cmd.AddValue ("admission", "admit, rate-limit or reject the services by available airtime, all over the QoS radios in their EDCA class (needs --remoteServices, implies --flows)", admissionControl);
+  cmd.AddValue ("fluidBackground", "model the best-effort and background services as fluid airtime load along their route and backlog in their source's MAC queue (needs --remoteServices; see bench/compare-fluid.sh)", fluidBackground);
+  cmd.AddValue ("mobility", "move the nodes by random waypoint; 0 keeps them at their initial positions", mobile);
+  cmd.AddValue ("lazyMobility", "evaluate the random waypoint positions on demand, with one event per segment", lazyMobility);
+  cmd.AddValue ("batchLoss", "compute the Friis loss of a transmission for all nodes at once (with --lazyMobility)", batchLoss);
+  cmd.AddValue ("recordMobility", "write the trajectories of the nodes to this binary trace", recordMobility);
+  cmd.AddValue ("replayMobility", "move the nodes along the trajectories of this binary trace", replayMobility);
+  cmd.AddValue ("pcapReplay", "also replay the UDP flows of this capture, captured hosts on the nodes in turn", pcapReplay);
+  cmd.AddValue ("bench", "print a BENCH summary line (see bench/run-benchmarks.sh)", bench);
 
   cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (admissionControl && !remoteServices,
+                   "--admission needs --remoteServices: services sent to their own node use no airtime");
+  NS_ABORT_MSG_IF (fluidBackground && !remoteServices,
+                   "--fluidBackground needs --remoteServices: services sent to their own node use no airtime");
+  NS_ABORT_MSG_IF (admissionControl && fluidBackground,
+                   "--admission tags the services' packets, --fluidBackground has none");
+  NS_ABORT_MSG_IF (!mobile && !replayMobility.empty (), "--replayMobility moves the nodes, --mobility=0 would not hold");
+  // The batch only covers SegmentWaypointMobilityModel nodes; any other
+  // mobility would silently get the scalar Friis formula
+  NS_ABORT_MSG_IF (batchLoss && (!lazyMobility || !mobile || !replayMobility.empty ()),
+                   "--batchLoss needs --lazyMobility, without --mobility=0 or --replayMobility");
+
+  uint32_t systemId = 0;
+  uint32_t systemCount = 1;
+  if (distributed)
+    {
+#ifdef NS3_MPI
+      GlobalValue::Bind ("SimulatorImplementationType",
+                         StringValue (nullMessages ? "ns3::NullMessageSimulatorImpl"
+                                                   : "ns3::DistributedSimulatorImpl"));
+      MpiInterface::Enable (&argc, &argv);
+      systemId = MpiInterface::GetSystemId ();
+      systemCount = MpiInterface::GetSize ();
+#else
+      NS_FATAL_ERROR ("--distributed requires ns-3 built with --enable-mpi");
+#endif
+      // These need the state of every node in one process
+      NS_ABORT_MSG_IF (routing == "etx", "--routing=etx does not support --distributed");
+      NS_ABORT_MSG_IF (admissionControl, "--admission does not support --distributed");
+      NS_ABORT_MSG_IF (fluidBackground, "--fluidBackground does not support --distributed");
+      NS_ABORT_MSG_IF (!pcapReplay.empty (), "--pcapReplay does not support --distributed");
+      NS_ABORT_MSG_IF (numNodes < systemCount, "--distributed needs at least one node per rank");
+      // Moving nodes of two ranks can come arbitrarily close, and no
+      // positive lookahead keeps their frames on time
+      NS_ABORT_MSG_IF (mobile, "--distributed needs --mobility=0");
+      // Replayed nodes move as well, and the regions would be planned from
+      // the drawn positions instead of the trace's
+      NS_ABORT_MSG_IF (!replayMobility.empty (), "--replayMobility does not support --distributed");
+    }
+
+  ScenarioBench benchmark ("taller1_olsripv6_servicios");
+  if (bench)
+    {
+      benchmark.Start ();
+    }
+
   // Convert to time object
   Time interPacketInterval = Seconds (interval);
 
+  NS_ABORT_MSG_IF (!memReport.empty () && !AllocStats::IsEnabled (),
+                   "--memReport needs a build with ALLOC_STATS defined (see alloc-stats.h)");
+  if (!memReport.empty ())
+    {
+      // Charge run-time allocations to the node and layer of each event
+      Config::SetDefault ("ns3::ProfilingScheduler::TagAllocations", BooleanValue (true));
+    }
+  if (profile)
+    {
+      // Written at Simulator::Destroy (); taller1.folded is flamegraph.pl input
+      ProfilingScheduler::Enable (OutputName (".profile", distributed, systemId),
+                                  OutputName (".folded", distributed, systemId));
+    }
+  else if (!memReport.empty ())
+    {
+      ProfilingScheduler::EnableCounting ();
+    }
+
+  WifiPhyStandard phyStandard = WIFI_PHY_STANDARD_80211b;
+  std::string dataMode (phyMode);
+  std::string controlMode (phyMode);
+  if (standard != "80211b")
+    {
+      std::ostringstream mode;
+      if (standard == "80211n-2.4GHz" || standard == "80211n-5GHz")
+        {
+          NS_ABORT_MSG_IF (channelWidth != 20 && channelWidth != 40, "802.11n channels are 20 or 40 MHz wide");
+          NS_ABORT_MSG_IF (streams < 1 || streams > 4 || mcs > 7, "802.11n has 1 to 4 streams and MCS 0 to 7 per stream");
+          phyStandard = standard == "80211n-5GHz" ? WIFI_PHY_STANDARD_80211n_5GHZ : WIFI_PHY_STANDARD_80211n_2_4GHZ;
+          controlMode = standard == "80211n-5GHz" ? "OfdmRate6Mbps" : "ErpOfdmRate6Mbps";
+          // HT MCS indexes carry the number of streams
+          mode << "HtMcs" << mcs + 8 * (streams - 1);
+        }
+      else if (standard == "80211ac")
+        {
+          NS_ABORT_MSG_IF (channelWidth != 20 && channelWidth != 40 && channelWidth != 80 && channelWidth != 160,
+                           "802.11ac channels are 20, 40, 80 or 160 MHz wide");
+          NS_ABORT_MSG_IF (streams < 1 || streams > 4 || mcs > 9, "802.11ac here has 1 to 4 streams and MCS 0 to 9");
+          phyStandard = WIFI_PHY_STANDARD_80211ac;
+          controlMode = "OfdmRate6Mbps";
+          // The stream count comes from the antennas (see ConfigureHtPhy)
+          mode << "VhtMcs" << mcs;
+        }
+      else
+        {
+          NS_FATAL_ERROR ("unknown --standard " << standard);
+        }
+      dataMode = mode.str ();
+    }
+
+  // Rate of the data frames, for the airtime models
+  DataRate phyRate (WifiMode (dataMode).GetDataRate (channelWidth, shortGuard, standard == "80211ac" ? streams : 1));
+
   // disable fragmentation for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::FragmentationThreshold")
+    .SetDefault (UintegerValue (2200));
   // turn off RTS/CTS for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("2200"));
-  // Fix non-unicast data rate to be the same as that of unicast
-  Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode", 
-                      StringValue (phyMode));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::RtsCtsThreshold")
+    .SetDefault (UintegerValue (2200));
+  // Fix non-unicast data rate to be the same as that of unicast; with
+  // HT/VHT the OLSR6 broadcasts use the legacy control rate instead, so that
+  // the HELLO range does not shrink with the MCS
+  WifiMode broadcastMode (standard == "80211b" ? dataMode : controlMode);
+  AttributeHandle<WifiModeValue> ("ns3::WifiRemoteStationManager::NonUnicastMode")
+    .SetDefault (WifiModeValue (broadcastMode));
+  // Rate and PLCP preamble + header of those broadcasts: long DSSS preamble
+  // for 802.11b, legacy OFDM (20 MHz, 20 us) otherwise
+  DataRate broadcastRate (broadcastMode.GetDataRate (20, false, 1));
+  bool dsss = broadcastMode.GetModulationClass () == WIFI_MOD_CLASS_DSSS
+    || broadcastMode.GetModulationClass () == WIFI_MOD_CLASS_HR_DSSS;
+  Time broadcastPreamble = dsss ? MicroSeconds (192) : MicroSeconds (20);
 
+  //Posiciones iniciales
+  // Drawn before the nodes exist so that each node can be given the MPI
+  // rank (systemId) of its region.  Sequential and distributed runs, and
+  // every rank, draw them identically.
+  ObjectFactory position;
+
+  position.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+  position.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=20|Max=1400]"));
+  position.Set ("Y", StringValue ("ns3::UniformRandomVariable[Min=20|Max=1400]"));
+  Ptr<PositionAllocator> PositionAlloc = position.Create ()->GetObject<PositionAllocator> ();
+  Ptr<ListPositionAllocator> initialPositions = CreateObject<ListPositionAllocator> ();
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < numNodes; i++)
+    {
+      positions.push_back (PositionAlloc->GetNext ());
+      initialPositions->Add (positions.back ());
+    }
+
+  // Regions with the same number of nodes per rank.  Every rank creates all
+  // the nodes and moves them (the rank proxy needs their positions), but
+  // only builds the devices, stack and applications of its own ones.
+  Ptr<SpatialPartitioner> planner;
+  if (distributed)
+    {
+      planner = CreateObjectWithAttributes<SpatialPartitioner> ("Partitions", UintegerValue (systemCount));
+      planner->Plan (positions);
+    }
   NodeContainer c;
-  c.Create (numNodes);
+  NodeContainer local;
+  for (uint32_t i = 0; i < numNodes; i++)
+    {
+      c.Add (CreateObject<Node> (planner ? planner->GetPartition (i) : 0));
+      if (c.Get (i)->GetSystemId () == systemId)
+        {
+          local.Add (c.Get (i));
+        }
+    }
 
   // The below set of helpers will help us to put together the wifi NICs we want
   WifiHelper wifi;
@@ -104,8 +448,11 @@ int main (int argc, char *argv[])
 
   YansWifiChannelHelper wifiChannel;
   wifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
-  wifiChannel.AddPropagationLoss ("ns3::FriisPropagationLossModel");
-  wifiPhy.SetChannel (wifiChannel.Create ());
+  wifiChannel.AddPropagationLoss (batchLoss ? "ns3::BatchFriisPropagationLossModel" : "ns3::FriisPropagationLossModel");
+  // Every node has a QoS and a non-QoS radio; with two channels each set
+  // of radios gets its own, and OLSR6 runs over both interfaces
+  NS_ABORT_MSG_IF (numChannels < 1 || numChannels > 2, "--numChannels is 1 or 2 (one per radio)");
+  MultiChannel channels (wifiChannel, numChannels);
 
   // Wifi mac sin QoS
   NqosWifiMacHelper nqosWifiMac = NqosWifiMacHelper::Default ();
@@ -113,56 +460,268 @@ int main (int argc, char *argv[])
   // Wifi mac con QoS
   QosWifiMacHelper qosWifiMac = QosWifiMacHelper::Default ();
 
-  wifi.SetStandard (WIFI_PHY_STANDARD_80211b);
-  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode",StringValue (phyMode),
-                                "ControlMode",StringValue (phyMode));
+  wifi.SetStandard (phyStandard);
+  if (manager == "constant")
+    {
+      wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                    "DataMode", WifiModeValue (WifiMode (dataMode)),
+                                    "ControlMode", WifiModeValue (WifiMode (controlMode)));
+    }
+  else
+    {
+      // The adaptive managers pick among the 802.11b rates; broadcasts
+      // stay at NonUnicastMode
+      NS_ABORT_MSG_IF (standard != "80211b", "--manager=" << manager << " needs --standard=80211b");
+      if (manager == "aarf")
+        {
+          wifi.SetRemoteStationManager ("ns3::AarfWifiManager");
+        }
+      else if (manager == "minstrel")
+        {
+          wifi.SetRemoteStationManager ("ns3::MinstrelWifiManager");
+        }
+      else if (manager == "ideal")
+        {
+          wifi.SetRemoteStationManager ("ns3::IdealWifiManager");
+        }
+      else
+        {
+          NS_FATAL_ERROR ("unknown --manager " << manager);
+        }
+    }
 
 
   
   // Activar modo adhoc
+  // Installed node by node (same order as a container install) so that
+  // the memory report can charge each device to its node.  slot gives the
+  // position of a node in the device and interface containers, -1 for the
+  // nodes of other ranks.
+  std::vector<int32_t> slot (numNodes, -1);
   nqosWifiMac.SetType ("ns3::AdhocWifiMac");
-  NetDeviceContainer devices_nqos = wifi.Install (wifiPhy, nqosWifiMac, c);
+  NetDeviceContainer devices_nqos;
+  channels.Attach (wifiPhy, 1);
+  for (uint32_t i = 0; i < c.GetN (); i++)
+    {
+      if (c.Get (i)->GetSystemId () != systemId)
+        {
+          continue;
+        }
+      AllocScope scope (AllocAccounting::WIFI_NQOS, i);
+      slot[i] = devices_nqos.GetN ();
+      devices_nqos.Add (wifi.Install (wifiPhy, nqosWifiMac, c.Get (i)));
+      if (distributed)
+        {
+          devices_nqos.Get (slot[i])->SetAddress (RadioAddress (0, i, numNodes));
+        }
+    }
 
   qosWifiMac.SetType ("ns3::AdhocWifiMac");
-  NetDeviceContainer devices_qos = wifi.Install (wifiPhy, qosWifiMac, c);
+  NetDeviceContainer devices_qos;
+  channels.Attach (wifiPhy, 0);
+  for (uint32_t i = 0; i < c.GetN (); i++)
+    {
+      if (c.Get (i)->GetSystemId () != systemId)
+        {
+          continue;
+        }
+      AllocScope scope (AllocAccounting::WIFI_QOS, i);
+      devices_qos.Add (wifi.Install (wifiPhy, qosWifiMac, c.Get (i)));
+      if (distributed)
+        {
+          devices_qos.Get (slot[i])->SetAddress (RadioAddress (1, i, numNodes));
+        }
+    }
+  if (standard != "80211b")
+    {
+      ConfigureHtPhy (devices_nqos, channelWidth, shortGuard, streams);
+      ConfigureHtPhy (devices_qos, channelWidth, shortGuard, streams);
+    }
+  if (numChannels > 1)
+    {
+      channels.Tune (devices_qos, 0, phyStandard);
+      channels.Tune (devices_nqos, 1, phyStandard);
+    }
    
   //Movilidad
   MobilityHelper mobility;
-  ObjectFactory position;
-
-  position.SetTypeId ("ns3::RandomRectanglePositionAllocator");
-  position.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=20|Max=1400]"));
-  position.Set ("Y", StringValue ("ns3::UniformRandomVariable[Min=20|Max=1400]"));
-  Ptr<PositionAllocator> PositionAlloc = position.Create ()->GetObject<PositionAllocator> ();
   mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
                                       "Speed", StringValue ("ns3::ExponentialRandomVariable[Mean=50]"),
                                       "Pause",StringValue ("ns3::ExponentialRandomVariable[Mean=50]"),
                                       "PositionAllocator", PointerValue (PositionAlloc));
+  if (!mobile)
+    {
+      mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+    }
                                         
-  mobility.SetPositionAllocator (PositionAlloc);
-  mobility.Install (c);
+  mobility.SetPositionAllocator (initialPositions);
+  for (uint32_t i = 0; i < c.GetN () && replayMobility.empty (); i++)
+    {
+      AllocScope scope (AllocAccounting::MOBILITY, i);
+      if (lazyMobility && mobile)
+        {
+          // Own random variables and destinations per node, so that the
+          // on-demand draws do not depend on the order of the queries
+          ObjectFactory waypoints;
+          waypoints.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+          waypoints.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=20|Max=1400]"));
+          waypoints.Set ("Y", StringValue ("ns3::UniformRandomVariable[Min=20|Max=1400]"));
+          mobility.SetMobilityModel ("ns3::SegmentWaypointMobilityModel",
+                                     "Speed", StringValue ("ns3::ExponentialRandomVariable[Mean=50]"),
+                                     "Pause", StringValue ("ns3::ExponentialRandomVariable[Mean=50]"),
+                                     "PositionAllocator", PointerValue (waypoints.Create ()->GetObject<PositionAllocator> ()));
+        }
+      mobility.Install (c.Get (i));
+    }
+  if (!replayMobility.empty ())
+    {
+      AllocScope scope (AllocAccounting::MOBILITY);
+      MobilityTraceReplay (replayMobility).Install (c);
+    }
+  else if (distributed)
+    {
+      // The ranks built different devices before, which drew different
+      // automatic streams; fixed ones give every rank the same trajectories
+      mobility.AssignStreams (c, 0);
+    }
+  MobilityTraceRecorder *mobilityRecorder = 0;
+  if (!recordMobility.empty () && systemId == 0)
+    {
+      mobilityRecorder = new MobilityTraceRecorder (recordMobility);
+      mobilityRecorder->Install (c);
+    }
 
   // Activar OLSR6
   Olsr6Helper olsr6;
   Ipv6StaticRoutingHelper staticRouting;
 
+  Ipv6StaticRoutingHelper etxRouting;
+
   Ipv6ListRoutingHelper list;
   list.Add (staticRouting, 0);
   list.Add (olsr6, 10);
+  if (routing == "etx")
+    {
+      // Consulted before OLSR6; Olsr6Etx keeps only its own routes in it
+      list.Add (etxRouting, 20);
+    }
+  else if (routing != "olsr")
+    {
+      NS_FATAL_ERROR ("unknown --routing " << routing);
+    }
+
+  NdiscPreloader ndisc;
+  if (fastIpv6)
+    {
+      NdiscPreloader::DisableDad ();
+      // Addresses added later (e.g. by an Assign () after ndisc.Add ())
+      ndisc.Watch (list);
+    }
 
   //Configuracion de ipv6
   InternetStackHelper internet;
   internet.SetIpv4StackInstall (false); //desactiva ipv4
   internet.SetRoutingHelper (list); // has effect on the next Install ()
-  internet.Install (c);
+  for (uint32_t i = 0; i < local.GetN (); i++)
+    {
+      AllocScope scope (AllocAccounting::IPV6, local.Get (i)->GetId ());
+      internet.Install (local.Get (i));
+    }
+
+  // Before Assign (), which would install the default queue disc
+  WifiAqm queues (aqm, macQueueLimit);
+  queues.Install (devices_qos);
+  queues.Install (devices_nqos);
 
   Ipv6AddressHelper ipv6;
   NS_LOG_INFO ("Assign IP Addresses.");
   //ipv4.SetBase ("10.1.1.0", "255.255.255.0");
   ipv6.SetBase ("2001:0:1::", Ipv6Prefix (64));
-  Ipv6InterfaceContainer ipv6Interface = ipv6.Assign (devices_qos);
-  Ipv6InterfaceContainer ipv6Interface2 = ipv6.Assign (devices_nqos);
+  Ipv6InterfaceContainer ipv6Interface;
+  for (uint32_t i = 0; i < devices_qos.GetN (); i++)
+    {
+      AllocScope scope (AllocAccounting::IPV6, local.Get (i)->GetId ());
+      ipv6Interface.Add (ipv6.Assign (NetDeviceContainer (devices_qos.Get (i))));
+    }
+  if (numChannels > 1)
+    {
+      // One prefix per channel, so that on-link routes pick the right radio
+      ipv6.NewNetwork ();
+    }
+  Ipv6InterfaceContainer ipv6Interface2;
+  for (uint32_t i = 0; i < devices_nqos.GetN (); i++)
+    {
+      AllocScope scope (AllocAccounting::IPV6, local.Get (i)->GetId ());
+      ipv6Interface2.Add (ipv6.Assign (NetDeviceContainer (devices_nqos.Get (i))));
+    }
+
+  if (fastIpv6)
+    {
+      // On a shared channel a QoS interface can pick a non-QoS neighbor as
+      // next hop, so both sets form one segment; otherwise one per channel
+      ndisc.Add ("channel", ipv6Interface);
+      ndisc.Add (numChannels > 1 ? "channel2" : "channel", ipv6Interface2);
+    }
+  if (ndpStats || fastIpv6)
+    {
+      ndisc.CountNdp (devices_qos);
+      ndisc.CountNdp (devices_nqos);
+    }
+  if (queueStats)
+    {
+      queues.Track (devices_qos, "qos");
+      queues.Track (devices_nqos, "nqos");
+    }
+
+  // Fixed streams per node for its radios, IPv6 stack and OLSR6 agent: a
+  // node draws the same numbers whichever other nodes this process builds,
+  // so a distributed run takes the decisions of the sequential one with
+  // the same seed.  They start above the streams of the mobility models.
+  for (uint32_t i = 0; i < c.GetN (); i++)
+    {
+      if (slot[i] < 0)
+        {
+          continue;
+        }
+      int64_t stream = 1000000 + 100 * int64_t (i);
+      stream += wifi.AssignStreams (NetDeviceContainer (devices_nqos.Get (slot[i])), stream);
+      stream += wifi.AssignStreams (NetDeviceContainer (devices_qos.Get (slot[i])), stream);
+      stream += internet.AssignStreams (NodeContainer (c.Get (i)), stream);
+      olsr6.AssignStreams (NodeContainer (c.Get (i)), stream);
+    }
+
+#ifdef NS3_MPI
+  // The medium between the ranks: portal nodes after the scenario ones
+  // (same ids on every rank) and the proxy on this rank's radios
+  Ptr<WifiRankProxy> rankProxy;
+  if (distributed)
+    {
+      NetDeviceContainer radios (devices_qos, devices_nqos);
+      double range = SpatialPartitioner::ComputeInterferenceRange (radios);
+      planner->SetAttribute ("InterferenceRange", DoubleValue (range));
+      planner->Plan (positions);
+      // The propagation delay between the closest nodes of two ranks: the
+      // closest cut pair in range, or the range when none is.  The nodes
+      // stand still, so every frame reaches the other ranks before its
+      // receivers there would hear it and the proxy delivers it on time.
+      Time lookahead = Seconds (range / 299792458.0);
+      if (planner->GetLookahead ().IsStrictlyPositive ())
+        {
+          lookahead = std::min (lookahead, planner->GetLookahead ());
+        }
+      NodeContainer portals;
+      for (uint32_t r = 0; r < systemCount; r++)
+        {
+          portals.Add (CreateObject<Node> (r));
+        }
+      MobilityHelper portalMobility;
+      portalMobility.Install (portals);
+      rankProxy = CreateObject<WifiRankProxy> ();
+      rankProxy->Connect (portals, systemId, lookahead);
+      rankProxy->Add (devices_qos, 0);
+      rankProxy->Add (devices_nqos, numChannels > 1 ? 1 : 0);
+    }
+#endif
 
   //Nodos que ofrecen los servicios
   int s1 = 2;
@@ -170,94 +729,324 @@ int main (int argc, char *argv[])
   int s3 = 4;
   int s4 = 5;
 
+  // The services send to their own node unless --remoteServices is given;
+  // then they cross the network to the sink, one port per service
+  Ipv6Address serviceAddress[4] = { NodeAddress (ipv6Interface, slot, s1, RadioAddress (1, s1, numNodes)),
+                                    NodeAddress (ipv6Interface, slot, s2, RadioAddress (1, s2, numNodes)),
+                                    NodeAddress (ipv6Interface2, slot, s3, RadioAddress (0, s3, numNodes)),
+                                    NodeAddress (ipv6Interface2, slot, s4, RadioAddress (0, s4, numNodes)) };
+  uint16_t servicePort[4] = { 80, 80, 80, 80 };
+  Ipv6Address sinkAddress = NodeAddress (ipv6Interface, slot, sinkNode, RadioAddress (1, sinkNode, numNodes));
+  if (remoteServices)
+    {
+      for (int k = 0; k < 4; k++)
+        {
+          // Voice and video on the QoS devices, the rest on the non-QoS ones;
+          // under admission control all of them use the QoS devices, where
+          // the MAC queues each in its own EDCA class
+          serviceAddress[k] = k < 2 || admissionControl
+            ? sinkAddress
+            : NodeAddress (ipv6Interface2, slot, sinkNode, RadioAddress (0, sinkNode, numNodes));
+          servicePort[k] = 5001 + k;
+          PacketSinkHelper serviceSink ("ns3::UdpSocketFactory",
+                                        Inet6SocketAddress (Ipv6Address::GetAny (), servicePort[k]));
+          if (slot[sinkNode] >= 0)
+            {
+              serviceSink.Install (c.Get (sinkNode)).Start (Seconds (1.0));
+            }
+        }
+    }
+
   //Aplicaciones
 
   /* ------   1. VOICE TRAFFIC     ------ */
   ApplicationContainer apps1;
-  OnOffHelper onOffHelper1 ("ns3::UdpSocketFactory", Inet6SocketAddress (ipv6Interface.GetAddress (s1, 0), 80));//80 es el puerto
-  onOffHelper1.SetAttribute ("DataRate", DataRateValue (DataRate ("11Mbps")));
+  OnOffHelper onOffHelper1 ("ns3::UdpSocketFactory", Inet6SocketAddress (serviceAddress[0], servicePort[0]));
+  onOffHelper1.SetAttribute ("DataRate", DataRateValue (DataRate (serviceRate)));
   //onOffHelper1.SetAttribute ("PacketSize", UintegerValue (packetSize));
   //onOffHelper1.SetAttribute ("OnTime",  RandomVariableValue (ConstantVariable (1)));
   //onOffHelper1.SetAttribute ("OffTime", RandomVariableValue (ConstantVariable (0)));
   //onOffHelper1.SetAttribute ("AccessClass", UintegerValue (6));
-  apps1.Add (onOffHelper1.Install (c.Get(s1)));
+  if (slot[s1] >= 0)
+    {
+      apps1.Add (onOffHelper1.Install (c.Get(s1)));
+    }
   apps1.Start (Seconds (1.1));
   apps1.Stop (Seconds (30.0));
   
    /* ------    2. VIDEO    ------ */
   ApplicationContainer apps2;
-  OnOffHelper onOffHelper2 ("ns3::UdpSocketFactory", Inet6SocketAddress (ipv6Interface.GetAddress (s2, 0), 80));//80 es el puerto
-  onOffHelper2.SetAttribute ("DataRate", DataRateValue (DataRate ("11Mbps")));
+  OnOffHelper onOffHelper2 ("ns3::UdpSocketFactory", Inet6SocketAddress (serviceAddress[1], servicePort[1]));
+  onOffHelper2.SetAttribute ("DataRate", DataRateValue (DataRate (serviceRate)));
   //onOffHelper1.SetAttribute ("PacketSize", UintegerValue (packetSize));
   //onOffHelper1.SetAttribute ("OnTime",  ns3::RandomVariable (ConstantVariable (1)));
   //onOffHelper1.SetAttribute ("OffTime", RandomVariableValue (ConstantVariable (0)));
   //onOffHelper1.SetAttribute ("AccessClass", UintegerValue (6));
-  apps2.Add (onOffHelper2.Install (c.Get(s2)));
+  if (slot[s2] >= 0)
+    {
+      apps2.Add (onOffHelper2.Install (c.Get(s2)));
+    }
   apps2.Start (Seconds (1.1));
   apps2.Stop (Seconds (30.0));
 
   // /* ------    3. BEST EFFORT    ------ */
   ApplicationContainer apps3;
-  OnOffHelper onOffHelper3 ("ns3::UdpSocketFactory", Inet6SocketAddress (ipv6Interface2.GetAddress (s3, 0), 80));
-  onOffHelper3.SetAttribute ("DataRate", DataRateValue (DataRate ("11Mbps")));
+  OnOffHelper onOffHelper3 ("ns3::UdpSocketFactory", Inet6SocketAddress (serviceAddress[2], servicePort[2]));
+  onOffHelper3.SetAttribute ("DataRate", DataRateValue (DataRate (serviceRate)));
   //onOffHelper3.SetAttribute ("PacketSize", UintegerValue (PacketSize));
   //onOffHelper3.SetAttribute ("OnTime",  RandomVariableValue (ConstantVariable (1)));
   //onOffHelper3.SetAttribute ("OffTime", RandomVariableValue (ConstantVariable (0)));
   //onOffHelper3.SetAttribute ("AccessClass", UintegerValue (0));
-  apps3.Add (onOffHelper3.Install (c.Get(s3)));
+  if (slot[s3] >= 0)
+    {
+      apps3.Add (fluidBackground ? InstallFluid (devices_nqos.Get (slot[s3]), serviceAddress[2], serviceRate, phyRate)
+                                 : onOffHelper3.Install (c.Get(s3)));
+    }
   apps3.Start (Seconds (1.1));
   apps3.Stop (Seconds (30.0));
   
   /* ------    4. BACKGROUND TRAFFIC   ------ */
   ApplicationContainer apps4;
-  OnOffHelper onOffHelper4 ("ns3::UdpSocketFactory", Inet6SocketAddress (ipv6Interface2.GetAddress (s4, 0), 80));
-  onOffHelper4.SetAttribute ("DataRate", DataRateValue (DataRate ("11Mbps")));
+  OnOffHelper onOffHelper4 ("ns3::UdpSocketFactory", Inet6SocketAddress (serviceAddress[3], servicePort[3]));
+  onOffHelper4.SetAttribute ("DataRate", DataRateValue (DataRate (serviceRate)));
   //onOffHelper4.SetAttribute ("PacketSize", UintegerValue (PacketSize));
   //onOffHelper4.SetAttribute ("OnTime",  RandomVariableValue (ConstantVariable (1)));
   //onOffHelper4.SetAttribute ("OffTime", RandomVariableValue (ConstantVariable (0)));
   //onOffHelper4.SetAttribute ("AccessClass", UintegerValue (1));
-  apps4.Add (onOffHelper4.Install (c.Get(s4)));
+  if (slot[s4] >= 0)
+    {
+      apps4.Add (fluidBackground ? InstallFluid (devices_nqos.Get (slot[s4]), serviceAddress[3], serviceRate, phyRate)
+                                 : onOffHelper4.Install (c.Get(s4)));
+    }
   apps4.Start (Seconds (1.1));
   apps4.Stop (Seconds (30.0));
 
+  ApplicationContainer replayApps;
+  if (!pcapReplay.empty ())
+    {
+      replayApps = PcapReplayHelper (pcapReplay).Install (c, ipv6Interface);
+      replayApps.Start (Seconds (1.1));
+      replayApps.Stop (Seconds (30.0));
+    }
+
+  Ptr<AdmissionControl> admission;
+  if (admissionControl)
+    {
+      admission = CreateObjectWithAttributes<AdmissionControl> ("PhyRate", DataRateValue (phyRate));
+      // ACKs taken at the control mode, the slowest they can be sent at
+      admission->SetModes (WifiMode (dataMode), WifiMode (controlMode), standard == "80211b" ? 1 : streams);
+      admission->Install (devices_qos);
+      admission->Install (devices_nqos);
+      Ptr<Node> sink = c.Get (sinkNode);
+      admission->AddFlow (apps1.Get (0), AC_VO, c.Get (s1), sink, Seconds (1.1));
+      admission->AddFlow (apps2.Get (0), AC_VI, c.Get (s2), sink, Seconds (1.1));
+      admission->AddFlow (apps3.Get (0), AC_BE, c.Get (s3), sink, Seconds (1.1));
+      admission->AddFlow (apps4.Get (0), AC_BK, c.Get (s4), sink, Seconds (1.1));
+      // The latency per class comes from the flow report
+      flows = true;
+    }
+
   //Crea sockets asociados a los nodos sink y source y los conecta
   TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
-  Ptr<Socket> recvSink = Socket::CreateSocket (c.Get (sinkNode), tid);
-  Inet6SocketAddress local = Inet6SocketAddress (Ipv6Address::GetAny (), 80);
-  recvSink->Bind (local);
-  recvSink->SetRecvCallback (MakeCallback (&ReceivePacket));
+  if (slot[sinkNode] >= 0)
+    {
+      Ptr<Socket> recvSink = Socket::CreateSocket (c.Get (sinkNode), tid);
+      Inet6SocketAddress any = Inet6SocketAddress (Ipv6Address::GetAny (), 80);
+      recvSink->Bind (any);
+      recvSink->SetRecvCallback (MakeCallback (&ReceivePacket));
+    }
 
-  Ptr<Socket> source = Socket::CreateSocket (c.Get (sourceNode), tid);
-  Inet6SocketAddress remote = Inet6SocketAddress (ipv6Interface.GetAddress (sinkNode, 0), 80);
-  source->Connect (remote);
+  Ptr<Socket> source;
+  if (slot[sourceNode] >= 0)
+    {
+      source = Socket::CreateSocket (c.Get (sourceNode), tid);
+      Inet6SocketAddress remote = Inet6SocketAddress (sinkAddress, 80);
+      source->Connect (remote);
+    }
 
   if (tracing == true)
     {
+      AllocScope scope (AllocAccounting::TRACING);
       AsciiTraceHelper ascii;
-      wifiPhy.EnableAsciiAll (ascii.CreateFileStream ("taller1.tr"));
+      // Each rank only has the devices of the nodes it owns, so the union
+      // of the rank traces covers every node
+      Ptr<OutputStreamWrapper> asciiStream = ascii.CreateFileStream (OutputName (".tr", distributed, systemId));
+      wifiPhy.EnableAscii (asciiStream, devices_qos);
+      wifiPhy.EnableAscii (asciiStream, devices_nqos);
       wifiPhy.EnablePcap ("taller1_qos", devices_qos);
       wifiPhy.EnablePcap ("taller1_nqos", devices_nqos);
       // Trace routing tables
-      Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper> ("taller1.routes", std::ios::out);
-      olsr6.PrintRoutingTableAllEvery (Seconds (2), routingStream);
-      Ptr<OutputStreamWrapper> neighborStream = Create<OutputStreamWrapper> ("taller1.neighbors", std::ios::out);
-      olsr6.PrintNeighborCacheAllEvery (Seconds (2), neighborStream);
+      Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper> (OutputName (".routes", distributed, systemId),
+                                                                            std::ios::out);
+      Ptr<OutputStreamWrapper> neighborStream = Create<OutputStreamWrapper> (OutputName (".neighbors", distributed, systemId),
+                                                                             std::ios::out);
+      for (uint32_t i = 0; i < local.GetN (); i++)
+        {
+          olsr6.PrintRoutingTableEvery (Seconds (2), local.Get (i), routingStream);
+          olsr6.PrintNeighborCacheEvery (Seconds (2), local.Get (i), neighborStream);
+        }
 
       // To do-- enable an IP-level trace that shows forwarding events only
     }
 
   // Give OLSR time to converge-- 30 seconds perhaps
-  Simulator::Schedule (Seconds (30.0), &GenerateTraffic, 
-                       source, packetSize, numPackets, interPacketInterval);
+  if (source)
+    {
+      Simulator::Schedule (Seconds (30.0), &GenerateTraffic, 
+                           source, packetSize, numPackets, interPacketInterval);
+    }
 
   // Output what we are doing
   //NS_LOG_UNCOND ("Testing from node " << sourceNode << " to " << sinkNode << " with grid distance " << distance);
 
   Simulator::Stop (Seconds (33.0));
-  AnimationInterface anim ("taller1_anim.xml");
-  anim.SetMaxPktsPerTraceFile(MAX_PKTS_PER_TRACE_FILE);
+  AnimationInterface *anim = 0;
+  if (tracing && systemId == 0)
+    {
+      AllocScope scope (AllocAccounting::ANIMATION);
+      anim = new AnimationInterface ("taller1_anim.xml");
+      anim->SetMaxPktsPerTraceFile (MAX_PKTS_PER_TRACE_FILE);
+    }
+  // The adaptive intervals follow the neighborhood changes of the shadow
+  Ptr<Olsr6MprShadow> olsr6Mpr;
+  if (mprShadow || mprVerify || adaptiveOlsr)
+    {
+      olsr6Mpr = CreateObjectWithAttributes<Olsr6MprShadow> ("Verify", BooleanValue (mprVerify));
+      olsr6Mpr->Install (local);
+    }
+  if (mprShadow || mprVerify)
+    {
+      olsr6Mpr->PrintEvery (Seconds (1), Create<OutputStreamWrapper> (OutputName (".mpr", distributed, systemId),
+                                                                      std::ios::out));
+    }
+
+  Ptr<Olsr6Stats> olsr6Stats;
+  if (olsrStats || adaptiveOlsr)
+    {
+      olsr6Stats = CreateObjectWithAttributes<Olsr6Stats> ("DataRate", DataRateValue (broadcastRate),
+                                                           "PreambleDuration", TimeValue (broadcastPreamble));
+      olsr6Stats->Install (local);
+      olsr6Stats->PrintEvery (Seconds (1), Create<OutputStreamWrapper> (OutputName (".olsr", distributed, systemId),
+                                                                        std::ios::out));
+      if (adaptiveOlsr)
+        {
+          olsr6Stats->EnableAdaptiveIntervals (Seconds (4), olsr6Mpr);
+        }
+    }
+
+  Ptr<Olsr6RouteShadow> olsr6Routes;
+  if (routeShadow || routeVerify)
+    {
+      olsr6Routes = CreateObjectWithAttributes<Olsr6RouteShadow> ("Verify", BooleanValue (routeVerify));
+      olsr6Routes->Install (local);
+      olsr6Routes->PrintEvery (Seconds (1), Create<OutputStreamWrapper> (OutputName (".spt", distributed, systemId),
+                                                                         std::ios::out));
+    }
+
+  Ptr<Olsr6Etx> olsr6Etx;
+  if (routing == "etx")
+    {
+      olsr6Etx = CreateObject<Olsr6Etx> ();
+      olsr6Etx->Install (c);
+      olsr6Etx->AddInterfaces (ipv6Interface);
+      olsr6Etx->AddInterfaces (ipv6Interface2);
+      olsr6Etx->Start (Create<OutputStreamWrapper> ("taller1.etx", std::ios::out));
+    }
+
+  FlowReport flowReport;
+  if (flows)
+    {
+      flowReport.Install (local);
+      static const char *serviceNames[4] = { "voice", "video", "best-effort", "background" };
+      flowReport.SetName (sinkAddress, "sink");
+      for (int k = 0; k < 4; k++)
+        {
+          if (remoteServices)
+            {
+              flowReport.SetName (servicePort[k], serviceNames[k]);
+            }
+          else
+            {
+              flowReport.SetName (serviceAddress[k], serviceNames[k]);
+            }
+        }
+    }
+
+  RateStats rates;
+  if (rateStats)
+    {
+      rates.Install (devices_qos);
+      rates.Install (devices_nqos);
+    }
+
+  if (!memReport.empty ())
+    {
+      Ptr<OutputStreamWrapper> memStream = Create<OutputStreamWrapper> (OutputName (".mem", distributed, systemId),
+                                                                        std::ios::out);
+      ReportMemory (memStream);
+      std::istringstream times (memReport);
+      std::string t;
+      while (std::getline (times, t, ','))
+        {
+          Simulator::Schedule (Seconds (atof (t.c_str ())), &ReportMemory, memStream);
+        }
+    }
+
+  uint32_t totalNodes = c.GetN ();
+  benchmark.SetupDone ();
   Simulator::Run ();
+  if (mobilityRecorder)
+    {
+      mobilityRecorder->Close ();
+    }
+  if (flows)
+    {
+      std::ofstream flowStream (OutputName (".flows", distributed, systemId).c_str ());
+      flowReport.Write (flowStream);
+      flowReport.WriteServices (std::cout);
+      flowReport.WriteDelays (std::cout);
+    }
+  if (queueStats)
+    {
+      queues.Report (std::cout);
+    }
+  if (admission)
+    {
+      admission->Report (std::cout);
+    }
+  for (uint32_t i = 0; i < replayApps.GetN (); i++)
+    {
+      DynamicCast<PcapReplayApplication> (replayApps.Get (i))->Report (std::cout);
+    }
+  if (fluidBackground)
+    {
+      DynamicCast<FluidBackgroundSource> (apps3.Get (0))->Report (std::cout);
+      DynamicCast<FluidBackgroundSource> (apps4.Get (0))->Report (std::cout);
+    }
+  if (rateStats)
+    {
+      rates.Report (std::cout, manager);
+      std::ofstream rateStream (OutputName (".rates", distributed, systemId).c_str ());
+      rates.WriteHistograms (rateStream);
+    }
   Simulator::Destroy ();
+  delete anim;
+  delete mobilityRecorder;
+  if (ndpStats || fastIpv6)
+    {
+      ndisc.Report (std::cout);
+    }
+#ifdef NS3_MPI
+  if (rankProxy)
+    {
+      rankProxy->Report (std::cout);
+    }
+  if (distributed)
+    {
+      MpiInterface::Disable ();
+    }
+#endif
+  benchmark.Report (totalNodes);
 
   return 0;
 }
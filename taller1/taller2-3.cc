@@ -56,6 +56,13 @@
 //
 // ./waf --run "olsr6-hna --assocMethod2=1"
 //
+// The static routing in every node's list is an Ipv6TrieStaticRouting
+// (ipv6-trie-routing.h), which resolves routes through a prefix trie.  With
+// --hnaPrefixes=N the gateway also routes and announces N more /64
+// networks, 2001:0:3::/64 onwards, the table size at which the trie pays:
+//
+// ./waf --run "olsr6-hna --assocMethod1=1 --hnaPrefixes=500"
+//
 #include "ns3/ipv6-static-routing-helper.h"
 
 
@@ -68,6 +75,9 @@
 #include "ns3/internet-module.h"
 #include "ns3/olsr6-routing-protocol.h"
 #include "ns3/olsr6-helper.h"
+#include "scenario-bench.h"
+#include "attribute-handle.h"
+#include "ipv6-trie-routing.h"
 
 #include <iostream>
 #include <fstream>
@@ -143,6 +153,15 @@ public:
 };
 
 
+// 2001:0:(3 + k)::, the k-th extra network of the gateway
+static Ipv6Address ExtraPrefix (uint32_t k)
+{
+  uint8_t bytes[16] = { 0x20, 0x01, 0, 0 };
+  bytes[4] = ((k + 3) >> 8) & 0xff;
+  bytes[5] = (k + 3) & 0xff;
+  return Ipv6Address (bytes);
+}
+
 static void GenerateTraffic (Ptr<Socket> socket, uint32_t pktSize,
                              uint32_t pktCount, Time pktInterval )
 {
@@ -167,8 +186,11 @@ int main (int argc, char *argv[])
   uint32_t numPackets = 1;
   double interval = 1.0; // seconds
   bool verbose = false;
+  bool tracing = true;
+  bool bench = false;
   bool assocMethod1 = false;
   bool assocMethod2 = false;
+  uint32_t hnaPrefixes = 0;
 
   CommandLine cmd;
 
@@ -180,18 +202,31 @@ int main (int argc, char *argv[])
   cmd.AddValue ("verbose", "turn on all WifiNetDevice log components", verbose);
   cmd.AddValue ("assocMethod1", "Use SetRoutingTableAssociation () method", assocMethod1);
   cmd.AddValue ("assocMethod2", "Use AddHostNetworkAssociation () method", assocMethod2);
+  cmd.AddValue ("hnaPrefixes", "extra /64 networks the gateway routes and announces", hnaPrefixes);
+  cmd.AddValue ("tracing", "turn on pcap tracing", tracing);
+  cmd.AddValue ("bench", "print a BENCH summary line (see bench/run-benchmarks.sh)", bench);
 
   cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (hnaPrefixes > 0xfffc, "--hnaPrefixes above 65532 runs out of 2001:0:x::/64 networks");
+
+  ScenarioBench benchmark ("taller2-3");
+  if (bench)
+    {
+      benchmark.Start ();
+    }
+
   // Convert to time object
   Time interPacketInterval = Seconds (interval);
 
   // disable fragmentation for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::FragmentationThreshold")
+    .SetDefault (UintegerValue (2200));
   // turn off RTS/CTS for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::RtsCtsThreshold")
+    .SetDefault (UintegerValue (2200));
   // Fix non-unicast data rate to be the same as that of unicast
-  Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode",
-                      StringValue (phyMode));
+  AttributeHandle<WifiModeValue> ("ns3::WifiRemoteStationManager::NonUnicastMode")
+    .SetDefault (WifiModeValue (WifiMode (phyMode)));
 
   NodeContainer olsr6Nodes;
   olsr6Nodes.Create (3);
@@ -230,8 +265,8 @@ int main (int argc, char *argv[])
   // Add a mac and disable rate control
   WifiMacHelper wifiMac;
   wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode",StringValue (phyMode),
-                                "ControlMode",StringValue (phyMode));
+                                "DataMode", WifiModeValue (WifiMode (phyMode)),
+                                "ControlMode", WifiModeValue (WifiMode (phyMode)));
   // Set it to adhoc mode
   wifiMac.SetType ("ns3::AdhocWifiMac");
   NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, olsr6Nodes);
@@ -286,7 +321,7 @@ int main (int argc, char *argv[])
 
   /////
 
-  Ipv6StaticRoutingHelper staticRouting;
+  Ipv6TrieStaticRoutingHelper staticRouting;
 
   Ipv6ListRoutingHelper list;
   list.Add (staticRouting, 0);
@@ -382,6 +417,10 @@ int main (int argc, char *argv[])
       // and have the node generate HNA messages for all these routes
       // which are associated with non-OLSR interfaces specified above.
       hnaEntries->AddNetworkRouteTo (Ipv6Address ("2001:0:2::"), Ipv6Prefix (64), uint32_t (2), uint32_t (1));
+      for (uint32_t k = 0; k < hnaPrefixes; k++)
+        {
+          hnaEntries->AddNetworkRouteTo (ExtraPrefix (k), Ipv6Prefix (64), uint32_t (2), uint32_t (1));
+        }
       olsrrp_Gw->SetRoutingTableAssociation (hnaEntries);
     }
 
@@ -389,6 +428,20 @@ int main (int argc, char *argv[])
     {
       // Specify the required associations directly.
       olsrrp_Gw->AddHostNetworkAssociation (Ipv6Address ("2001:0:2::"), Ipv6Prefix (64));
+      for (uint32_t k = 0; k < hnaPrefixes; k++)
+        {
+          olsrrp_Gw->AddHostNetworkAssociation (ExtraPrefix (k), Ipv6Prefix (64));
+        }
+    }
+
+  // The gateway forwards the extra networks out of its OLSR6 interface;
+  // these routes sit in its Ipv6TrieStaticRouting, added through it so
+  // that they go straight into its trie
+  Ipv6StaticRoutingHelper gatewayRouting;
+  Ptr<Ipv6TrieStaticRouting> gatewayStatic = DynamicCast<Ipv6TrieStaticRouting> (gatewayRouting.GetStaticRouting (stack));
+  for (uint32_t k = 0; k < hnaPrefixes; k++)
+    {
+      gatewayStatic->AddNetworkRouteTo (ExtraPrefix (k), Ipv6Prefix (64), uint32_t (1));
     }
 
 
@@ -410,7 +463,10 @@ int main (int argc, char *argv[])
 
 
 
-   wifiPhy.EnablePcap ("olsr-hna", devices);
+  if (tracing)
+    {
+      wifiPhy.EnablePcap ("olsr-hna", devices);
+    }
 
   //////////////////////
   //csma.EnablePcap ("olsr-hna", csmaDevices, false);
@@ -422,8 +478,23 @@ int main (int argc, char *argv[])
 
   
   Simulator::Stop (Seconds (20.0));
+  uint32_t totalNodes = NodeList::GetNNodes ();
+  benchmark.SetupDone ();
   Simulator::Run ();
+
+  for (uint32_t i = 0; i < olsr6Nodes.GetN (); i++)
+    {
+      Ptr<Ipv6TrieStaticRouting> trie = DynamicCast<Ipv6TrieStaticRouting> (
+          gatewayRouting.GetStaticRouting (olsr6Nodes.Get (i)->GetObject<Ipv6> ()));
+      std::cout << "TRIE node=" << i
+                << " routes=" << trie->GetNRoutes ()
+                << " trie_lookups=" << trie->GetTrieLookups ()
+                << " fallbacks=" << trie->GetFallbacks ()
+                << " rebuilds=" << trie->GetRebuilds () << std::endl;
+    }
+
   Simulator::Destroy ();
+  benchmark.Report (totalNodes);
 
   return 0;
 }
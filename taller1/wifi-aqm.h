@@ -0,0 +1,360 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// CoDel / FQ-CoDel in front of the Wi-Fi MAC queues, with sojourn-time
+// statistics per queue.
+//
+// A queue disc only holds packets while the device below it says it is
+// busy.  WifiNetDevice never stops its NetDeviceQueue, so the traffic
+// control layer hands every packet straight to the MAC and the standing
+// queue forms in the DCF/EDCA queues (WifiMacQueue: up to 400 packets or
+// 500 ms), out of reach of any AQM.  WifiAqm installs the queue disc and
+// adds the missing backpressure: it stops the device queue once the MAC
+// queues of the device hold MacQueueLimit packets and wakes it when a
+// frame leaves (or is dropped by) the MAC.  The MAC then keeps only a few
+// packets ready for transmission and the queue moves up into CoDel, which
+// drops by sojourn time, or FQ-CoDel, which also gives every flow its own
+// queue so that voice does not wait behind the bulk services.
+//
+// Track () follows the root queue disc and the MAC of the devices and
+// records how long every packet stayed in each: queue disc sojourn from
+// its Enqueue to its Dequeue trace, MAC sojourn from MacTx to the first
+// PhyTxBegin of the frame.  Packets the queue disc drops (its Drop trace)
+// or the MAC gives up on (MacTxDrop) count as drops.  WifiMacQueue drops
+// without a trace, both when it is full at enqueue and when a packet
+// outlives MaxDelay; MacTx fires just before the enqueue, so a packet
+// meeting a full queue is counted as dropped there, and a packet still
+// waiting after twice MaxDelay is counted as expired.
+//
+//   WifiAqm aqm ("fqcodel", 4);
+//   aqm.Install (devices);          // after the internet stack, before Assign
+//   ...Assign...
+//   aqm.Track (devices, "qos");
+//
+
+#ifndef WIFI_AQM_H
+#define WIFI_AQM_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <list>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class WifiAqm
+{
+public:
+  /**
+   * \param aqm "none", "codel" or "fqcodel"
+   * \param macQueueLimit packets the MAC queues of a device may hold when
+   *        a queue disc is installed
+   */
+  WifiAqm (std::string aqm, uint32_t macQueueLimit)
+    : m_aqm (aqm),
+      m_macQueueLimit (macQueueLimit)
+  {
+    NS_ABORT_MSG_IF (aqm != "none" && aqm != "codel" && aqm != "fqcodel", "unknown AQM " << aqm);
+    NS_ABORT_MSG_IF (macQueueLimit == 0, "the MAC must be allowed at least one packet");
+  }
+
+  /**
+   * \brief Install the queue disc and the MAC backpressure.
+   *
+   * Must run after the internet stack and before the addresses are
+   * assigned, which would install the default queue disc.  Does nothing
+   * for "none".
+   */
+  void Install (NetDeviceContainer devices)
+  {
+    if (m_aqm == "none")
+      {
+        return;
+      }
+    TrafficControlHelper tch;
+    if (m_aqm == "codel")
+      {
+        tch.SetRootQueueDisc ("ns3::CoDelQueueDisc");
+      }
+    else
+      {
+        uint16_t handle = tch.SetRootQueueDisc ("ns3::FqCoDelQueueDisc");
+        tch.AddPacketFilter (handle, "ns3::FqCoDelIpv6PacketFilter");
+      }
+    tch.Install (devices);
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+      {
+        Device &d = GetDevice (*i);
+        if (!d.limited)
+          {
+            d.limited = true;
+            Ptr<WifiMac> mac = d.device->GetMac ();
+            mac->TraceConnectWithoutContext ("MacTx", MakeBoundCallback (&WifiAqm::Enqueued, &d));
+            mac->TraceConnectWithoutContext ("MacTxDrop", MakeBoundCallback (&WifiAqm::Left, &d));
+            d.device->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&WifiAqm::Left, &d));
+          }
+      }
+  }
+
+  /**
+   * \brief Record queue disc and MAC sojourn times of the devices.
+   * \param devices Wi-Fi devices with addresses assigned
+   * \param name label of the device set in the report
+   */
+  void Track (NetDeviceContainer devices, std::string name)
+  {
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+      {
+        Device &d = GetDevice (*i);
+        Queue &mac = m_queues[name + "/mac"];
+        MacTrack track;
+        track.device = &d;
+        track.queue = &mac;
+        m_tracks.push_back (track);
+        d.device->GetMac ()->TraceConnectWithoutContext ("MacTx", MakeBoundCallback (&WifiAqm::MacArrive, &m_tracks.back ()));
+        d.device->GetMac ()->TraceConnectWithoutContext ("MacTxDrop", MakeBoundCallback (&WifiAqm::Forget, &mac));
+        d.device->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&WifiAqm::Depart, &mac));
+
+        Ptr<TrafficControlLayer> tc = (*i)->GetNode ()->GetObject<TrafficControlLayer> ();
+        Ptr<QueueDisc> disc = tc ? tc->GetRootQueueDiscOnDevice (*i) : 0;
+        if (disc)
+          {
+            Queue &qdisc = m_queues[name + "/qdisc"];
+            disc->TraceConnectWithoutContext ("Enqueue", MakeBoundCallback (&WifiAqm::ItemArrive, &qdisc));
+            disc->TraceConnectWithoutContext ("Dequeue", MakeBoundCallback (&WifiAqm::ItemDepart, &qdisc));
+            disc->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&WifiAqm::ItemDrop, &qdisc));
+          }
+      }
+  }
+
+  /// Write sojourn-time percentiles per queue.
+  void Report (std::ostream &os) const
+  {
+    os << "# queue\taqm\tpackets\tdrops\tmean_ms\tp50_ms\tp95_ms\tp99_ms\tmax_ms" << std::endl;
+    for (std::map<std::string, Queue>::const_iterator q = m_queues.begin (); q != m_queues.end (); q++)
+      {
+        std::vector<double> samples (q->second.sojourn);
+        std::sort (samples.begin (), samples.end ());
+        double sum = 0;
+        for (size_t i = 0; i < samples.size (); i++)
+          {
+            sum += samples[i];
+          }
+        os << q->first
+           << "\t" << m_aqm
+           << "\t" << samples.size ()
+           << "\t" << q->second.drops
+           << "\t" << (samples.empty () ? 0 : sum / samples.size () * 1e3)
+           << "\t" << Percentile (samples, 0.50) * 1e3
+           << "\t" << Percentile (samples, 0.95) * 1e3
+           << "\t" << Percentile (samples, 0.99) * 1e3
+           << "\t" << (samples.empty () ? 0 : samples.back () * 1e3)
+           << std::endl;
+      }
+  }
+
+private:
+  struct Device
+  {
+    Device () : aqm (0), limited (false) {}
+    WifiAqm *aqm;
+    Ptr<WifiNetDevice> device;
+    std::vector<Ptr<WifiMacQueue> > queues; // DCF and the four EDCA queues
+    bool limited;
+  };
+
+  struct Queue
+  {
+    Queue () : drops (0) {}
+    std::map<uint64_t, Time> arrivals;               // packet uid -> arrival
+    std::deque<std::pair<Time, uint64_t> > order;   // MAC arrivals, oldest first
+    std::vector<double> sojourn;                     // seconds
+    uint64_t drops;
+  };
+
+  /// A device feeding a MAC sojourn queue
+  struct MacTrack
+  {
+    Device *device;
+    Queue *queue;
+  };
+
+  Device &GetDevice (Ptr<NetDevice> netDevice)
+  {
+    for (std::list<Device>::iterator d = m_devices.begin (); d != m_devices.end (); d++)
+      {
+        if (d->device == netDevice)
+          {
+            return *d;
+          }
+      }
+    m_devices.push_back (Device ());
+    Device &d = m_devices.back ();
+    d.aqm = this;
+    d.device = DynamicCast<WifiNetDevice> (netDevice);
+    NS_ABORT_MSG_IF (d.device == 0, "WifiAqm needs Wi-Fi devices");
+    // The EDCA queues only exist on QoS MACs
+    static const char *txops[] = { "DcaTxop", "VO_EdcaTxopN", "VI_EdcaTxopN", "BE_EdcaTxopN", "BK_EdcaTxopN" };
+    BooleanValue qos;
+    d.device->GetMac ()->GetAttribute ("QosSupported", qos);
+    for (int i = 0; i < (qos.Get () ? 5 : 1); i++)
+      {
+        PointerValue txop;
+        d.device->GetMac ()->GetAttribute (txops[i], txop);
+        PointerValue queue;
+        txop.Get<Object> ()->GetAttribute ("Queue", queue);
+        d.queues.push_back (queue.Get<WifiMacQueue> ());
+      }
+    return d;
+  }
+
+  static uint32_t Backlog (Device *d)
+  {
+    uint32_t packets = 0;
+    for (size_t i = 0; i < d->queues.size (); i++)
+      {
+        packets += d->queues[i]->GetSize ();
+      }
+    return packets;
+  }
+
+  static Ptr<NetDeviceQueue> GetTxQueue (Device *d)
+  {
+    Ptr<NetDeviceQueueInterface> ndqi = d->device->GetObject<NetDeviceQueueInterface> ();
+    return ndqi ? ndqi->GetTxQueue (0) : 0;
+  }
+
+  /// MacTx fires before the packet is queued: count it in.
+  static void Enqueued (Device *d, Ptr<const Packet> packet)
+  {
+    Ptr<NetDeviceQueue> txq = GetTxQueue (d);
+    if (txq && Backlog (d) + 1 >= d->aqm->m_macQueueLimit)
+      {
+        txq->Stop ();
+      }
+  }
+
+  static void Left (Device *d, Ptr<const Packet> packet)
+  {
+    Ptr<NetDeviceQueue> txq = GetTxQueue (d);
+    if (txq && txq->IsStopped () && Backlog (d) < d->aqm->m_macQueueLimit)
+      {
+        txq->Wake ();
+      }
+  }
+
+  /// The DCF or EDCA queue AdhocWifiMac::Enqueue () puts a packet in
+  static Ptr<WifiMacQueue> TargetQueue (Device *d, Ptr<const Packet> packet)
+  {
+    if (d->queues.size () == 1)
+      {
+        return d->queues[0];
+      }
+    uint8_t tid = QosUtilsGetTidForPacket (packet);
+    switch (QosUtilsMapTidToAc (tid > 7 ? 0 : tid))
+      {
+      case AC_VO:
+        return d->queues[1];
+      case AC_VI:
+        return d->queues[2];
+      case AC_BK:
+        return d->queues[4];
+      default:
+        return d->queues[3];
+      }
+  }
+
+  static void MacArrive (MacTrack *t, Ptr<const Packet> packet)
+  {
+    Queue *q = t->queue;
+    // Packets dequeued close to MaxDelay may still be transmitted after it
+    Ptr<WifiMacQueue> target = TargetQueue (t->device, packet);
+    Time expiry = Simulator::Now () - target->GetMaxDelay () - target->GetMaxDelay ();
+    while (!q->order.empty () && q->order.front ().first < expiry)
+      {
+        std::map<uint64_t, Time>::iterator a = q->arrivals.find (q->order.front ().second);
+        if (a != q->arrivals.end () && a->second == q->order.front ().first)
+          {
+            q->arrivals.erase (a);
+            q->drops++;
+          }
+        q->order.pop_front ();
+      }
+    // IsEmpty () runs the cleanup of expired packets that Enqueue () runs
+    // before testing for room
+    target->IsEmpty ();
+    if (target->GetSize () >= target->GetMaxSize ())
+      {
+        q->drops++;
+        return;
+      }
+    Arrive (q, packet);
+    q->order.push_back (std::make_pair (Simulator::Now (), packet->GetUid ()));
+  }
+
+  static void Arrive (Queue *q, Ptr<const Packet> packet)
+  {
+    q->arrivals[packet->GetUid ()] = Simulator::Now ();
+  }
+
+  static void Depart (Queue *q, Ptr<const Packet> packet)
+  {
+    std::map<uint64_t, Time>::iterator a = q->arrivals.find (packet->GetUid ());
+    if (a != q->arrivals.end ())
+      {
+        q->sojourn.push_back ((Simulator::Now () - a->second).GetSeconds ());
+        q->arrivals.erase (a);
+      }
+  }
+
+  static void Forget (Queue *q, Ptr<const Packet> packet)
+  {
+    if (q->arrivals.erase (packet->GetUid ()))
+      {
+        q->drops++;
+      }
+  }
+
+  static void ItemArrive (Queue *q, Ptr<const QueueDiscItem> item)
+  {
+    Arrive (q, item->GetPacket ());
+  }
+
+  static void ItemDepart (Queue *q, Ptr<const QueueDiscItem> item)
+  {
+    Depart (q, item->GetPacket ());
+  }
+
+  static void ItemDrop (Queue *q, Ptr<const QueueDiscItem> item)
+  {
+    Forget (q, item->GetPacket ());
+  }
+
+  static double Percentile (const std::vector<double> &sorted, double p)
+  {
+    if (sorted.empty ())
+      {
+        return 0;
+      }
+    size_t rank = static_cast<size_t> (std::ceil (p * sorted.size ()));
+    return sorted[rank > 0 ? rank - 1 : 0];
+  }
+
+  std::string m_aqm;
+  uint32_t m_macQueueLimit;
+  std::list<Device> m_devices;            // stable addresses for the callbacks
+  std::list<MacTrack> m_tracks;
+  std::map<std::string, Queue> m_queues;  // "<set>/qdisc", "<set>/mac"
+};
+
+} // namespace ns3
+
+#endif /* WIFI_AQM_H */
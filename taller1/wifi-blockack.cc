@@ -18,6 +18,17 @@
  * reset when:
  *    - the originator receives a block ack frame.
  *    - the recipient receives a block ack request or a MPDU with ack policy Block Ack. 
+ *
+ * With --aggregation=1 the same sta -> AP topology runs as an aggregation
+ * benchmark instead: 802.11n (5 GHz, HtMcs7), saturating UDP from the sta,
+ * swept over A-MPDU size, A-MSDU size and offered load on the BE queue.
+ * Every combination is a separate simulation and prints one line with
+ * goodput, MAC efficiency (goodput over the PHY rate), MPDUs per data PPDU
+ * (A-MPDU subframes from the sta's MonitorSnifferTx, so A-MSDU shows up in
+ * the efficiency, not here) and mean latency; the 0/0 rows are the
+ * non-aggregated reference.
+ *
+ *   ./waf --run "wifi-blockack --aggregation=1 --ampdu=0,16383,65535 --amsdu=0,7935 --loads=20,60"
  */
 #include "ns3/core-module.h"
 #include "ns3/internet-module.h"
@@ -25,18 +36,208 @@
 #include "ns3/applications-module.h"
 #include "ns3/wifi-module.h"
 #include "ns3/mobility-module.h"
+#include "ns3/flow-monitor-helper.h"
+#include "scenario-bench.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Test-block-ack");
 
+static std::vector<uint32_t> ParseList (std::string list)
+{
+  std::vector<uint32_t> values;
+  std::istringstream items (list);
+  std::string item;
+  while (std::getline (items, item, ','))
+    {
+      values.push_back (atoi (item.c_str ()));
+    }
+  return values;
+}
+
+struct AggregationCounts
+{
+  AggregationCounts () : ppdus (0), mpdus (0) {}
+  uint64_t ppdus;   ///< PPDUs carrying data
+  uint64_t mpdus;   ///< data MPDUs in them
+};
+
+/// MonitorSnifferTx fires once per MPDU, A-MPDU subframes included; only
+/// the last subframe (or a non-aggregated MPDU) closes a PPDU.
+static void CountDataMpdu (AggregationCounts *counts, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                           uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                           WifiTxVector txVector, struct mpduInfo aMpdu)
+{
+  WifiMacHeader header;
+  packet->PeekHeader (header);
+  if (!header.IsData ())
+    {
+      return;
+    }
+  counts->mpdus++;
+  if (aMpdu.type != MPDU_IN_AGGREGATE)
+    {
+      counts->ppdus++;
+    }
+}
+
+/**
+ * One aggregation run: a QoS sta saturating the BE queue towards the AP.
+ */
+static void RunAggregation (uint32_t ampdu, uint32_t amsdu, uint32_t loadMbps,
+                            uint32_t packetSize, double simTime, std::ostream &os)
+{
+  const double phyRateMbps = 65; // HtMcs7, 20 MHz, long guard interval
+
+  Ptr<Node> sta = CreateObject<Node> ();
+  Ptr<Node> ap = CreateObject<Node> ();
+
+  YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
+  YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
+  phy.SetChannel (channel.Create ());
+
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_PHY_STANDARD_80211n_5GHZ);
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                "DataMode", StringValue ("HtMcs7"),
+                                "ControlMode", StringValue ("HtMcs0"));
+
+  Ssid ssid ("My-network");
+  WifiMacHelper mac;
+  mac.SetType ("ns3::StaWifiMac",
+               "QosSupported", BooleanValue (true),
+               "Ssid", SsidValue (ssid),
+               "BE_MaxAmpduSize", UintegerValue (ampdu),
+               "BE_MaxAmsduSize", UintegerValue (amsdu),
+               "BE_BlockAckThreshold", UintegerValue (2),
+               "BE_BlockAckInactivityTimeout", UintegerValue (3));
+  NetDeviceContainer staDevice = wifi.Install (phy, mac, sta);
+
+  mac.SetType ("ns3::ApWifiMac",
+               "QosSupported", BooleanValue (true),
+               "Ssid", SsidValue (ssid),
+               "BE_MaxAmpduSize", UintegerValue (ampdu),
+               "BE_MaxAmsduSize", UintegerValue (amsdu));
+  NetDeviceContainer apDevice = wifi.Install (phy, mac, ap);
+
+  // Fixed positions: rate and loss must not change during the sweep
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (5.0, 0.0, 0.0));
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (sta);
+  mobility.Install (ap);
+
+  InternetStackHelper stack;
+  stack.SetIpv4StackInstall (false);
+  stack.Install (sta);
+  stack.Install (ap);
+  Ipv6AddressHelper address;
+  address.Assign (staDevice);
+  Ipv6InterfaceContainer apIf = address.Assign (apDevice);
+
+  uint16_t port = 9;
+  PacketSinkHelper sink ("ns3::UdpSocketFactory", Inet6SocketAddress (Ipv6Address::GetAny (), port));
+  ApplicationContainer sinkApps = sink.Install (ap);
+  sinkApps.Start (Seconds (0.5));
+
+  OnOffHelper onOff ("ns3::UdpSocketFactory", Address (Inet6SocketAddress (apIf.GetAddress (0, 0), port)));
+  onOff.SetConstantRate (DataRate (loadMbps * 1000000), packetSize);
+  ApplicationContainer staApps = onOff.Install (sta);
+  staApps.Start (Seconds (1.0));
+  staApps.Stop (Seconds (1.0 + simTime));
+
+  AggregationCounts counts;
+  DynamicCast<WifiNetDevice> (staDevice.Get (0))->GetPhy ()
+    ->TraceConnectWithoutContext ("MonitorSnifferTx", MakeBoundCallback (&CountDataMpdu, &counts));
+
+  FlowMonitorHelper flowmon;
+  Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
+
+  Simulator::Stop (Seconds (1.5 + simTime));
+  Simulator::Run ();
+
+  monitor->CheckForLostPackets ();
+  uint64_t rxPackets = 0;
+  double delay = 0;
+  FlowMonitor::FlowStatsContainer stats = monitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); i++)
+    {
+      rxPackets += i->second.rxPackets;
+      delay += i->second.delaySum.GetSeconds ();
+    }
+  double goodput = DynamicCast<PacketSink> (sinkApps.Get (0))->GetTotalRx () * 8 / simTime / 1e6;
+  os << ampdu
+     << "\t" << amsdu
+     << "\t" << loadMbps
+     << "\t" << goodput
+     << "\t" << goodput / phyRateMbps
+     << "\t" << (counts.ppdus ? double (counts.mpdus) / counts.ppdus : 0)
+     << "\t" << (rxPackets ? delay / rxPackets * 1e3 : 0)
+     << std::endl;
+
+  Simulator::Destroy ();
+}
+
 int main (int argc, char * argv[])
 {
+  bool bench = false;
+  bool tracing = true;
+  bool aggregation = false;
+  std::string ampduSizes ("0,8191,16383,32767,65535");
+  std::string amsduSizes ("0,3839,7935");
+  std::string loads ("10,30,60,100");
+  uint32_t packetSize = 1400;
+  double simTime = 5;
+
   CommandLine cmd;
+  cmd.AddValue ("bench", "print a BENCH summary line (see bench/run-benchmarks.sh)", bench);
+  cmd.AddValue ("tracing", "turn on logging and pcap tracing", tracing);
+  cmd.AddValue ("aggregation", "run the A-MPDU/A-MSDU aggregation benchmark", aggregation);
+  cmd.AddValue ("ampdu", "comma separated BE_MaxAmpduSize values (bytes, 0 disables)", ampduSizes);
+  cmd.AddValue ("amsdu", "comma separated BE_MaxAmsduSize values (bytes, 0 disables)", amsduSizes);
+  cmd.AddValue ("loads", "comma separated offered loads (Mbps)", loads);
+  cmd.AddValue ("packetSize", "UDP payload size for the benchmark (bytes)", packetSize);
+  cmd.AddValue ("simTime", "traffic duration of each benchmark run (s)", simTime);
   cmd.Parse (argc, argv);
-  
-  LogComponentEnable ("EdcaTxopN", LOG_LEVEL_DEBUG);
-  LogComponentEnable ("BlockAckManager", LOG_LEVEL_INFO);
+
+  if (aggregation)
+    {
+      std::vector<uint32_t> ampdu = ParseList (ampduSizes);
+      std::vector<uint32_t> amsdu = ParseList (amsduSizes);
+      std::vector<uint32_t> load = ParseList (loads);
+      std::cout << "ampdu\tamsdu\tload_mbps\tgoodput_mbps\tmac_efficiency\tmpdus_per_ppdu\tdelay_ms" << std::endl;
+      for (uint32_t l = 0; l < load.size (); l++)
+        {
+          for (uint32_t a = 0; a < ampdu.size (); a++)
+            {
+              for (uint32_t m = 0; m < amsdu.size (); m++)
+                {
+                  RunAggregation (ampdu[a], amsdu[m], load[l], packetSize, simTime, std::cout);
+                }
+            }
+        }
+      return 0;
+    }
+
+  ScenarioBench benchmark ("wifi-blockack");
+  if (bench)
+    {
+      benchmark.Start ();
+    }
+
+  if (tracing)
+    {
+      LogComponentEnable ("EdcaTxopN", LOG_LEVEL_DEBUG);
+      LogComponentEnable ("BlockAckManager", LOG_LEVEL_INFO);
+    }
  
   Ptr<Node> sta = CreateObject<Node> ();
   Ptr<Node> ap = CreateObject<Node> ();
@@ -119,9 +320,15 @@ int main (int argc, char * argv[])
 
   Simulator::Stop (Seconds (10.0));
 
-  phy.EnablePcap ("test-blockack-2", ap->GetId (), 0);
+  if (tracing)
+    {
+      phy.EnablePcap ("test-blockack-2", ap->GetId (), 0);
+    }
+  uint32_t totalNodes = NodeList::GetNNodes ();
+  benchmark.SetupDone ();
   Simulator::Run ();
   Simulator::Destroy ();
+  benchmark.Report (totalNodes);
 
   return 0;
 }
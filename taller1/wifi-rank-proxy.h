@@ -0,0 +1,454 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// Delivery of Wi-Fi transmissions between the MPI ranks of a distributed
+// run.
+//
+// In a distributed run every rank only builds the devices, stacks and
+// applications of the nodes it owns, so the YansWifiChannel of a rank only
+// reaches local PHYs.  WifiRankProxy carries the rest of the medium.  It
+// follows every transmission of the local PHYs (MonitorSnifferTx gives the
+// frame, its TxVector and preamble, the TX state change that follows it the
+// duration) and sends a copy with those parameters and the sender node to
+// every other rank, over point-to-point remote links between one portal
+// node per rank.  The proxy of the receiving rank hands it to its PHYs on
+// the same channel the way YansWifiChannel does: rx power from the
+// channel's loss model and the mobility of both nodes (every rank keeps the
+// mobility of all the nodes), reception after the propagation delay.
+//
+// The portal links have the lookahead as their delay, which is what the
+// distributed simulator synchronises on, and a rate high enough for the
+// serialization time to round to zero, so a frame reaches the other ranks
+// one lookahead after it started and every receiver gets it at its
+// propagation delay, as through YansWifiChannel.  That needs a lookahead
+// no larger than the propagation delay between any two nodes of different
+// ranks at any time, i.e. nodes that do not move; a frame that arrives
+// after a receiver should have heard it aborts the run rather than
+// silently diverging from the sequential one.
+//
+//   WifiRankProxy proxy;
+//   proxy.Connect (portals, rank, lookahead);
+//   proxy.Add (localDevices, 0);
+//
+
+#ifndef WIFI_RANK_PROXY_H
+#define WIFI_RANK_PROXY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/// Transmission parameters of a frame carried to another rank.
+class WifiRankHeader : public Header
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+
+  uint32_t node;          // sender
+  uint8_t channel;        // channel index, the same on every rank
+  uint16_t channelNumber;
+  double txPowerDbm;      // including TxGain
+  Time start;
+  Time duration;
+  uint8_t preamble;
+  uint8_t mpduType;
+  WifiTxVector txVector;
+
+private:
+  static void WriteDouble (Buffer::Iterator &i, double value);
+  static double ReadDouble (Buffer::Iterator &i);
+};
+
+NS_OBJECT_ENSURE_REGISTERED (WifiRankHeader);
+
+TypeId
+WifiRankHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::WifiRankHeader")
+    .SetParent<Header> ()
+    .AddConstructor<WifiRankHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+WifiRankHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+WifiRankHeader::GetSerializedSize (void) const
+{
+  return 4 + 1 + 2 + 8 + 8 + 8 + 1 + 1
+         + 1 + txVector.GetMode ().GetUniqueName ().size () // mode
+         + 1 + 1 + 1 + 1 + 1 + 4;                           // level, flags, nss, ness, retries, width
+}
+
+void
+WifiRankHeader::WriteDouble (Buffer::Iterator &i, double value)
+{
+  uint64_t bits;
+  std::memcpy (&bits, &value, sizeof (bits));
+  i.WriteHtonU64 (bits);
+}
+
+double
+WifiRankHeader::ReadDouble (Buffer::Iterator &i)
+{
+  uint64_t bits = i.ReadNtohU64 ();
+  double value;
+  std::memcpy (&value, &bits, sizeof (value));
+  return value;
+}
+
+void
+WifiRankHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteHtonU32 (node);
+  i.WriteU8 (channel);
+  i.WriteHtonU16 (channelNumber);
+  WriteDouble (i, txPowerDbm);
+  i.WriteHtonU64 (this->start.GetTimeStep ());
+  i.WriteHtonU64 (duration.GetTimeStep ());
+  i.WriteU8 (preamble);
+  i.WriteU8 (mpduType);
+  std::string mode = txVector.GetMode ().GetUniqueName ();
+  i.WriteU8 (mode.size ());
+  i.Write (reinterpret_cast<const uint8_t *> (mode.data ()), mode.size ());
+  i.WriteU8 (txVector.GetTxPowerLevel ());
+  i.WriteU8 ((txVector.IsShortGuardInterval () ? 1 : 0) | (txVector.IsStbc () ? 2 : 0)
+             | (txVector.IsAggregation () ? 4 : 0));
+  i.WriteU8 (txVector.GetNss ());
+  i.WriteU8 (txVector.GetNess ());
+  i.WriteU8 (txVector.GetRetries ());
+  i.WriteHtonU32 (txVector.GetChannelWidth ());
+}
+
+uint32_t
+WifiRankHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  node = i.ReadNtohU32 ();
+  channel = i.ReadU8 ();
+  channelNumber = i.ReadNtohU16 ();
+  txPowerDbm = ReadDouble (i);
+  this->start = TimeStep (i.ReadNtohU64 ());
+  duration = TimeStep (i.ReadNtohU64 ());
+  preamble = i.ReadU8 ();
+  mpduType = i.ReadU8 ();
+  uint8_t length = i.ReadU8 ();
+  std::string mode (length, ' ');
+  for (uint8_t k = 0; k < length; k++)
+    {
+      mode[k] = i.ReadU8 ();
+    }
+  txVector.SetMode (WifiMode (mode));
+  txVector.SetTxPowerLevel (i.ReadU8 ());
+  uint8_t flags = i.ReadU8 ();
+  txVector.SetShortGuardInterval (flags & 1);
+  txVector.SetStbc (flags & 2);
+  txVector.SetAggregation (flags & 4);
+  txVector.SetNss (i.ReadU8 ());
+  txVector.SetNess (i.ReadU8 ());
+  txVector.SetRetries (i.ReadU8 ());
+  txVector.SetChannelWidth (i.ReadNtohU32 ());
+  return i.GetDistanceFrom (start);
+}
+
+void
+WifiRankHeader::Print (std::ostream &os) const
+{
+  os << "node=" << node << " channel=" << +channel << " power=" << txPowerDbm
+     << "dBm start=" << this->start << " duration=" << duration
+     << " mode=" << txVector.GetMode ().GetUniqueName ();
+}
+
+class WifiRankProxy : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  WifiRankProxy ();
+
+  /**
+   * \brief Link this rank to the others.
+   *
+   * Every rank must call it with the same portals, created in the same
+   * order, so that the links get the same node and device numbers.
+   * \param portals one node per rank, portal i with system id i
+   * \param rank MPI rank of this process
+   * \param lookahead delay of the links, greater than zero
+   */
+  void Connect (NodeContainer portals, uint32_t rank, Time lookahead);
+
+  /**
+   * \brief Carry the transmissions of local devices to the other ranks,
+   * and theirs to the local devices.
+   * \param devices Wi-Fi devices of the local nodes, on a YansWifiChannel
+   * \param channel index of that channel, the same on every rank
+   */
+  void Add (NetDeviceContainer devices, uint32_t channel);
+
+  /// Print the frames sent and received on one line.
+  void Report (std::ostream &os) const;
+
+private:
+  struct Radio
+  {
+    Ptr<WifiNetDevice> device;
+    uint32_t node;
+    uint32_t channel;
+    double txPowerStart;
+    double txPowerEnd;
+    double txGain;
+    uint32_t txPowerLevels;
+    Ptr<PropagationLossModel> loss;
+    Ptr<PropagationDelayModel> delay;
+    // Last frame seen by the sniffer, sent when the TX state starts
+    Ptr<Packet> pending;
+    WifiTxVector txVector;
+    WifiPreamble preamble;
+    enum mpduType type;
+  };
+  struct Arrival
+  {
+    double rxPowerDbm;
+    WifiTxVector txVector;
+    WifiPreamble preamble;
+    enum mpduType type;
+    Time duration;
+  };
+
+  /// Protocol number of the portal frames (the PPP framing only knows IP)
+  static const uint16_t PROTOCOL = 0x86DD;
+
+  void SnifferTx (std::string context, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                  uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                  WifiTxVector txVector, struct mpduInfo aMpdu);
+  void State (std::string context, Time start, Time duration, WifiPhy::State state);
+  void Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                const Address &from, const Address &to, NetDevice::PacketType type);
+  static void Deliver (Ptr<YansWifiPhy> phy, Ptr<Packet> packet, Arrival arrival);
+
+  DataRate m_linkRate;
+  std::vector<Radio> m_radios;
+  std::vector<Ptr<NetDevice> > m_links;
+  uint32_t m_rank;
+  uint64_t m_sent;
+  uint64_t m_received;
+  uint64_t m_deliveries;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (WifiRankProxy);
+
+TypeId
+WifiRankProxy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::WifiRankProxy")
+    .SetParent<Object> ()
+    .AddConstructor<WifiRankProxy> ()
+    .AddAttribute ("LinkRate", "Rate of the portal links; their serialization "
+                   "time delays the frames on top of the lookahead (the default "
+                   "keeps it under a nanosecond).",
+                   DataRateValue (DataRate (UINT64_C (1000000000000000000))),
+                   MakeDataRateAccessor (&WifiRankProxy::m_linkRate),
+                   MakeDataRateChecker ())
+  ;
+  return tid;
+}
+
+WifiRankProxy::WifiRankProxy ()
+  : m_rank (0),
+    m_sent (0),
+    m_received (0),
+    m_deliveries (0)
+{
+}
+
+void
+WifiRankProxy::Connect (NodeContainer portals, uint32_t rank, Time lookahead)
+{
+  NS_ABORT_MSG_IF (!lookahead.IsStrictlyPositive (), "the rank links need a positive lookahead");
+  NS_ABORT_MSG_IF (rank >= portals.GetN (), "no portal for rank " << rank);
+  m_rank = rank;
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute ("DataRate", DataRateValue (m_linkRate));
+  p2p.SetChannelAttribute ("Delay", TimeValue (lookahead));
+  // Every frame of the rank crosses each link; never drop one
+  p2p.SetQueue ("ns3::DropTailQueue", "MaxPackets", UintegerValue (1 << 20));
+  for (uint32_t a = 0; a < portals.GetN (); a++)
+    {
+      for (uint32_t b = a + 1; b < portals.GetN (); b++)
+        {
+          NetDeviceContainer link = p2p.Install (portals.Get (a), portals.Get (b));
+          Ptr<NetDevice> local = a == rank ? link.Get (0) : b == rank ? link.Get (1) : 0;
+          if (local != 0)
+            {
+              local->GetNode ()->RegisterProtocolHandler (MakeCallback (&WifiRankProxy::Receive, this),
+                                                          PROTOCOL, local);
+              m_links.push_back (local);
+            }
+        }
+    }
+}
+
+void
+WifiRankProxy::Add (NetDeviceContainer devices, uint32_t channel)
+{
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); i++)
+    {
+      Radio radio;
+      radio.device = DynamicCast<WifiNetDevice> (*i);
+      NS_ABORT_MSG_IF (radio.device == 0, "WifiRankProxy needs Wi-Fi devices");
+      Ptr<WifiPhy> phy = radio.device->GetPhy ();
+      radio.node = radio.device->GetNode ()->GetId ();
+      radio.channel = channel;
+      DoubleValue start, end, gain;
+      UintegerValue levels;
+      phy->GetAttribute ("TxPowerStart", start);
+      phy->GetAttribute ("TxPowerEnd", end);
+      phy->GetAttribute ("TxGain", gain);
+      phy->GetAttribute ("TxPowerLevels", levels);
+      radio.txPowerStart = start.Get ();
+      radio.txPowerEnd = end.Get ();
+      radio.txGain = gain.Get ();
+      radio.txPowerLevels = levels.Get ();
+      PointerValue loss, delay;
+      phy->GetChannel ()->GetAttribute ("PropagationLossModel", loss);
+      phy->GetChannel ()->GetAttribute ("PropagationDelayModel", delay);
+      radio.loss = loss.Get<PropagationLossModel> ();
+      radio.delay = delay.Get<PropagationDelayModel> ();
+      radio.preamble = WIFI_PREAMBLE_LONG;
+      radio.type = NORMAL_MPDU;
+
+      std::ostringstream context;
+      context << m_radios.size ();
+      phy->TraceConnect ("MonitorSnifferTx", context.str (), MakeCallback (&WifiRankProxy::SnifferTx, this));
+      PointerValue state;
+      phy->GetAttribute ("State", state);
+      state.Get<WifiPhyStateHelper> ()->TraceConnect ("State", context.str (), MakeCallback (&WifiRankProxy::State, this));
+      m_radios.push_back (radio);
+    }
+}
+
+void
+WifiRankProxy::SnifferTx (std::string context, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                          uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                          WifiTxVector txVector, struct mpduInfo aMpdu)
+{
+  Radio &radio = m_radios[atoi (context.c_str ())];
+  radio.pending = packet->Copy ();
+  radio.txVector = txVector;
+  radio.preamble = preamble;
+  radio.type = aMpdu.type;
+}
+
+void
+WifiRankProxy::State (std::string context, Time start, Time duration, WifiPhy::State state)
+{
+  Radio &radio = m_radios[atoi (context.c_str ())];
+  if (state != WifiPhy::TX || radio.pending == 0)
+    {
+      return;
+    }
+  // Same power as YansWifiPhy::SendPacket () gives the channel
+  uint32_t level = radio.txVector.GetTxPowerLevel ();
+  double txPowerDbm = radio.txPowerStart;
+  if (radio.txPowerLevels > 1)
+    {
+      txPowerDbm += level * (radio.txPowerEnd - radio.txPowerStart) / (radio.txPowerLevels - 1);
+    }
+  WifiRankHeader header;
+  header.node = radio.node;
+  header.channel = radio.channel;
+  header.channelNumber = radio.device->GetPhy ()->GetChannelNumber ();
+  header.txPowerDbm = txPowerDbm + radio.txGain;
+  header.start = start;
+  header.duration = duration;
+  header.preamble = radio.preamble;
+  header.mpduType = radio.type;
+  header.txVector = radio.txVector;
+  for (std::vector<Ptr<NetDevice> >::const_iterator i = m_links.begin (); i != m_links.end (); i++)
+    {
+      Ptr<Packet> copy = radio.pending->Copy ();
+      copy->AddHeader (header);
+      (*i)->Send (copy, (*i)->GetBroadcast (), PROTOCOL);
+    }
+  radio.pending = 0;
+  m_sent++;
+}
+
+void
+WifiRankProxy::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                        const Address &from, const Address &to, NetDevice::PacketType type)
+{
+  Ptr<Packet> frame = packet->Copy ();
+  WifiRankHeader header;
+  frame->RemoveHeader (header);
+  m_received++;
+  Ptr<MobilityModel> sender = NodeList::GetNode (header.node)->GetObject<MobilityModel> ();
+  Arrival arrival;
+  arrival.txVector = header.txVector;
+  arrival.preamble = static_cast<WifiPreamble> (header.preamble);
+  arrival.type = static_cast<enum mpduType> (header.mpduType);
+  arrival.duration = header.duration;
+  for (std::vector<Radio>::const_iterator r = m_radios.begin (); r != m_radios.end (); r++)
+    {
+      Ptr<YansWifiPhy> phy = DynamicCast<YansWifiPhy> (r->device->GetPhy ());
+      if (r->channel != header.channel || phy->GetChannelNumber () != header.channelNumber)
+        {
+          continue;
+        }
+      Ptr<MobilityModel> receiver = r->device->GetNode ()->GetObject<MobilityModel> ();
+      arrival.rxPowerDbm = r->loss->CalcRxPower (header.txPowerDbm, sender, receiver);
+      Time at = header.start + r->delay->GetDelay (sender, receiver);
+      NS_ABORT_MSG_IF (at < Simulator::Now (), "frame of node " << header.node << " reached rank " << m_rank
+                       << " after node " << r->node << " should have heard it: the lookahead exceeds their propagation delay");
+      Simulator::ScheduleWithContext (r->node, at - Simulator::Now (), &WifiRankProxy::Deliver,
+                                      phy, frame->Copy (), arrival);
+      m_deliveries++;
+    }
+}
+
+void
+WifiRankProxy::Deliver (Ptr<YansWifiPhy> phy, Ptr<Packet> packet, Arrival arrival)
+{
+  phy->StartReceivePreambleAndHeader (packet, arrival.rxPowerDbm, arrival.txVector,
+                                      arrival.preamble, arrival.type, arrival.duration);
+}
+
+void
+WifiRankProxy::Report (std::ostream &os) const
+{
+  os << "RANKPROXY rank=" << m_rank
+     << " radios=" << m_radios.size ()
+     << " links=" << m_links.size ()
+     << " frames_sent=" << m_sent
+     << " frames_received=" << m_received
+     << " deliveries=" << m_deliveries
+     << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* WIFI_RANK_PROXY_H */
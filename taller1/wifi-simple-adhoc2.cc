@@ -55,6 +55,8 @@
 #include "ns3/wifi-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/netanim-module.h"
+#include "scenario-bench.h"
+#include "attribute-handle.h"
 
 using namespace ns3;
 
@@ -91,6 +93,9 @@ int main (int argc, char *argv[])
   uint32_t numPackets = 10;
   double interval = 10.0; // seconds
   bool verbose = false;
+  uint32_t numNodes = 24;
+  bool tracing = true;
+  bool bench = false;
 
   CommandLine cmd;
 
@@ -100,21 +105,33 @@ int main (int argc, char *argv[])
   cmd.AddValue ("numPackets", "number of packets generated", numPackets);
   cmd.AddValue ("interval", "interval (seconds) between packets", interval);
   cmd.AddValue ("verbose", "turn on all WifiNetDevice log components", verbose);
+  cmd.AddValue ("numNodes", "number of nodes", numNodes);
+  cmd.AddValue ("tracing", "turn on pcap tracing and animation output", tracing);
+  cmd.AddValue ("bench", "print a BENCH summary line (see bench/run-benchmarks.sh)", bench);
 
   cmd.Parse (argc, argv);
+
+  ScenarioBench benchmark ("wifi-simple-adhoc2");
+  if (bench)
+    {
+      benchmark.Start ();
+    }
+
   // Convert to time object
   Time interPacketInterval = Seconds (interval);
 
   // disable fragmentation for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::FragmentationThreshold")
+    .SetDefault (UintegerValue (2200));
   // turn off RTS/CTS for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::RtsCtsThreshold")
+    .SetDefault (UintegerValue (2200));
   // Fix non-unicast data rate to be the same as that of unicast
-  Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode",
-                      StringValue (phyMode));
+  AttributeHandle<WifiModeValue> ("ns3::WifiRemoteStationManager::NonUnicastMode")
+    .SetDefault (WifiModeValue (WifiMode (phyMode)));
 
   NodeContainer c;
-  c.Create (24);
+  c.Create (numNodes);
 
   // The below set of helpers will help us to put together the wifi NICs we want
   WifiHelper wifi;
@@ -141,8 +158,8 @@ int main (int argc, char *argv[])
   // Add a mac and disable rate control
   WifiMacHelper wifiMac;
   wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode",StringValue (phyMode),
-                                "ControlMode",StringValue (phyMode));
+                                "DataMode", WifiModeValue (WifiMode (phyMode)),
+                                "ControlMode", WifiModeValue (WifiMode (phyMode)));
   // Set it to adhoc mode
   wifiMac.SetType ("ns3::AdhocWifiMac");
   NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, c);
@@ -222,11 +239,19 @@ Ssid ssid ("My-network");
 
   Simulator::Stop (Seconds (50.0));
   
-  AnimationInterface anim ("wifisample.xml");
+  AnimationInterface *anim = 0;
+  if (tracing)
+    {
+      anim = new AnimationInterface ("wifisample.xml");
+    }
   
 
+  uint32_t totalNodes = NodeList::GetNNodes ();
+  benchmark.SetupDone ();
   Simulator::Run ();
   Simulator::Destroy ();
+  delete anim;
+  benchmark.Report (totalNodes);
 
   return 0;
 }
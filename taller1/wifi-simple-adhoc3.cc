@@ -37,6 +37,9 @@
 #include "ns3/internet-module.h"
 #include "ns3/netanim-module.h"
 #include "ns3/animation-interface.h"
+#include "scenario-bench.h"
+#include "attribute-handle.h"
+#include "bulk-builder.h"
 
 using namespace ns3;
 
@@ -73,6 +76,9 @@ int main (int argc, char *argv[])
   uint32_t numPackets = 10;
   double interval = 10.0; // seconds
   bool verbose = false;
+  uint32_t numNodes = 23; // 21 adhoc nodes + 2 stations
+  bool tracing = true;
+  bool bench = false;
 
   CommandLine cmd;
 
@@ -82,30 +88,43 @@ int main (int argc, char *argv[])
   cmd.AddValue ("numPackets", "number of packets generated", numPackets);
   cmd.AddValue ("interval", "interval (seconds) between packets", interval);
   cmd.AddValue ("verbose", "turn on all WifiNetDevice log components", verbose);
+  cmd.AddValue ("numNodes", "number of nodes", numNodes);
+  cmd.AddValue ("tracing", "turn on pcap tracing and animation output", tracing);
+  cmd.AddValue ("bench", "print a BENCH summary line (see bench/run-benchmarks.sh)", bench);
 
   cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (numNodes < 2, "numNodes includes the 2 stations, it must be at least 2");
+
+  ScenarioBench benchmark ("wifi-simple-adhoc3");
+  if (bench)
+    {
+      benchmark.Start ();
+    }
+
   // Convert to time object
   Time interPacketInterval = Seconds (interval);
 
   // disable fragmentation for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::FragmentationThreshold")
+    .SetDefault (UintegerValue (2200));
   // turn off RTS/CTS for frames below 2200 bytes
-  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("2200"));
+  AttributeHandle<UintegerValue> ("ns3::WifiRemoteStationManager::RtsCtsThreshold")
+    .SetDefault (UintegerValue (2200));
   // Fix non-unicast data rate to be the same as that of unicast
-  Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode",
-                      StringValue (phyMode));
+  AttributeHandle<WifiModeValue> ("ns3::WifiRemoteStationManager::NonUnicastMode")
+    .SetDefault (WifiModeValue (WifiMode (phyMode)));
 
-  NodeContainer n1;
-  n1.Create (21);
+  // The ad hoc population goes through AdhocBulkBuilder, which times
+  // each layer; the calls stay where the scripts installed the layer
+  AdhocBulkBuilder builder;
+  NodeContainer n1 = builder.Create (numNodes - 2);
   Ptr<Node> s1 = CreateObject<Node> ();
-
   Ptr<Node> s2 = CreateObject<Node> ();
-
   //internet stack ipv6
   InternetStackHelper internet;
   internet.SetIpv4StackInstall (false);//desactiva ipv6
 
-  internet.Install (n1);
+  builder.InstallInternet (internet);
   internet.Install (s1);
   internet.Install (s2);
 
@@ -135,11 +154,11 @@ int main (int argc, char *argv[])
   // Add a mac and disable rate control
   WifiMacHelper wifiMac;
   wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode",StringValue (phyMode),
-                                "ControlMode",StringValue (phyMode));
+                                "DataMode", WifiModeValue (WifiMode (phyMode)),
+                                "ControlMode", WifiModeValue (WifiMode (phyMode)));
   // Set it to adhoc mode
   wifiMac.SetType ("ns3::AdhocWifiMac");
-  NetDeviceContainer devices_n1 = wifi.Install (wifiPhy, wifiMac, n1);
+  NetDeviceContainer devices_n1 = builder.InstallWifi (wifi, wifiPhy, wifiMac);
 
 
   ////////////configuracion de Estacion 1 /////////////////////////////
@@ -178,7 +197,7 @@ int main (int argc, char *argv[])
   //Ipv6 addresshelper:
   Ipv6AddressHelper ipv6;
   NS_LOG_INFO ("Assign IP Addresses IPv6.");
-  ipv6.Assign(devices_n1);
+  builder.Assign (ipv6);
   ipv6.Assign(device_s1);
   ipv6.Assign(device_s2);
 
@@ -199,7 +218,7 @@ int main (int argc, char *argv[])
                                       "PositionAllocator", PointerValue (PositionAlloc));
                                         
   mobility.SetPositionAllocator (PositionAlloc);
-  mobility.Install (n1);
+  builder.InstallMobility (mobility);
   mobility.Install (s1);
   mobility.Install (s2);
 
@@ -236,11 +255,23 @@ int main (int argc, char *argv[])
 
   Simulator::Stop (Seconds (50.0));
   
-  AnimationInterface anim ("wifisample1.xml");
+  AnimationInterface *anim = 0;
+  if (tracing)
+    {
+      anim = new AnimationInterface ("wifisample1.xml");
+    }
   
 
+  uint32_t totalNodes = NodeList::GetNNodes ();
+  benchmark.SetupDone ();
   Simulator::Run ();
   Simulator::Destroy ();
+  delete anim;
+  benchmark.Report (totalNodes);
+  if (bench)
+    {
+      builder.Report (std::cout);
+    }
 
   return 0;
 }